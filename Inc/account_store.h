@@ -0,0 +1,33 @@
+#ifndef ACCOUNT_STORE_H
+#define ACCOUNT_STORE_H
+
+#include "main.h"
+#include "bank.h"
+#include "ledger_digest.h"
+
+/* The account table persisted to the external FRAM/EEPROM. Record i lives at */
+/* i * sizeof(AccountRecord); updates go to a RAM image and the dirty pages */
+/* are written back one page per transfer from the main loop. The ledger */
+/* digest is kept over the same record CRCs. */
+
+typedef struct
+{
+    uint32_t restored;       // accounts restored or adopted at boot
+    uint32_t updates;        // account changes queued
+    uint32_t page_writes;    // page transfers completed
+    uint32_t bytes_written;
+    uint32_t write_errors;
+    uint32_t dirty_pages;    // waiting to be written now
+    uint32_t max_latency_ms; // longest time from a change to its page being durable
+} AccountStoreStats;
+
+void AccountStore_Init(void);
+uint16_t AccountStore_Load(ConsoleBank &bank);
+uint16_t AccountStore_Adopt(const ConsoleBank &bank);
+void AccountStore_Update(const BankAccount &account);
+void AccountStore_Service(void);
+bool AccountStore_Flush(uint32_t timeout);
+void AccountStore_GetStats(AccountStoreStats *stats);
+const LedgerDigest &AccountStore_GetDigest(void);
+
+#endif // ACCOUNT_STORE_H
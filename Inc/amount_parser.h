@@ -0,0 +1,61 @@
+#ifndef AMOUNT_PARSER_H
+#define AMOUNT_PARSER_H
+
+#include "bank_account.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Console amounts: an optional '+', 1 to AMOUNT_INT_DIGITS integer digits, */
+/* optionally '.' and 1 or 2 decimals, then optionally '#' and a request id */
+/* of 1 to 8 hex digits. The value must be between 0.01 and INT32_MAX cents. */
+#define AMOUNT_INT_DIGITS               8
+#define AMOUNT_DECIMALS                 2
+
+typedef enum
+{
+    AMOUNT_OK = 0,
+    AMOUNT_EMPTY,
+    AMOUNT_NEGATIVE,
+    AMOUNT_BAD_FORMAT,
+    AMOUNT_TOO_MANY_DIGITS,
+    AMOUNT_TOO_MANY_DECIMALS,
+    AMOUNT_OUT_OF_RANGE,
+    AMOUNT_BAD_REQUEST_ID,
+} AmountError;
+
+/* Incremental parser, fed one character at a time straight from the UART */
+/* receive ring, so the line is never copied into a buffer. */
+class AmountParser
+{
+private:
+    enum State : uint8_t
+    {
+        START,
+        INTEGER,
+        POINT,
+        FRACTION,
+        REQUEST_ID,
+    };
+    State state;
+    AmountError error; // first error seen, later input is ignored
+    uint8_t int_digits;
+    uint8_t decimals;
+    uint8_t id_digits;
+    uint32_t whole;
+    uint32_t fraction;
+    uint32_t id;
+
+    void fail(AmountError e);
+
+public:
+    AmountParser();
+    void reset();
+    void feed(uint8_t c);
+    AmountError finish(amount_t *amount, uint32_t *request_id);
+};
+
+AmountError parse_amount(const uint8_t *text, size_t len, amount_t *amount, uint32_t *request_id);
+const char *amount_error_text(AmountError error);
+void format_amount(char *buf, size_t size, int64_t minor);
+
+#endif // AMOUNT_PARSER_H
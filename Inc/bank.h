@@ -0,0 +1,265 @@
+#ifndef BANK_H
+#define BANK_H
+
+#include "bank_account.h"
+#include <array>
+#include <bitset>
+#include <memory>
+#include <string.h>
+
+/* A Bank owns a fixed-capacity account table and the create / lookup / login */
+/* rules. Where the accounts live (Storage) and how names are found (Index) */
+/* are template parameters, so the MCU console and large host banks share */
+/* this code without virtual calls. Account ids are table slots. */
+
+/* Storage: the table inside the Bank object, for static allocation on the MCU */
+template <size_t Capacity>
+class StaticStorage
+{
+private:
+    std::array<BankAccount, Capacity> accounts;
+
+public:
+    static constexpr bool uses_heap = false;
+    BankAccount *data() { return accounts.data(); }
+    const BankAccount *data() const { return accounts.data(); }
+};
+
+/* Storage: the table in one heap block, for banks too large for the stack */
+template <size_t Capacity>
+class HeapStorage
+{
+private:
+    std::unique_ptr<BankAccount[]> accounts;
+
+public:
+    static constexpr bool uses_heap = true;
+    HeapStorage() : accounts(new BankAccount[Capacity]) {}
+    BankAccount *data() { return accounts.get(); }
+    const BankAccount *data() const { return accounts.get(); }
+};
+
+/* Indexes look names up by their NameArena::hash(), so an account's */
+/* precomputed hash settles most comparisons without touching the text. */
+
+/* Index: compare names against every account in use. No memory, O(n); */
+/* the right choice for a few dozen accounts. */
+template <size_t Capacity>
+class LinearIndex
+{
+public:
+    static const int32_t NOT_FOUND = -1;
+    static constexpr bool uses_heap = false;
+
+    void insert(NameHash hash, uint32_t slot)
+    {
+        (void)hash;
+        (void)slot;
+    }
+
+    int32_t find(const BankAccount *accounts, uint32_t count, const uint8_t *name, uint32_t length,
+                 NameHash hash) const
+    {
+        for (uint32_t i = 0; i < count; i++)
+            if (accounts[i].has_name(name, length, hash))
+                return (int32_t)i;
+        return NOT_FOUND;
+    }
+};
+
+/* Index: open-addressing hash table of slots, at most half full. O(1) */
+/* lookups for any capacity at 8 bytes per account. */
+template <size_t Capacity>
+class HashIndex
+{
+private:
+    static constexpr size_t table_size()
+    {
+        size_t size = 1;
+        while (size < 2 * Capacity)
+            size <<= 1;
+        return size;
+    }
+    std::unique_ptr<uint32_t[]> table; // slot + 1, 0 when empty
+
+public:
+    static const int32_t NOT_FOUND = -1;
+    static constexpr bool uses_heap = true;
+
+    HashIndex() : table(new uint32_t[table_size()]()) {}
+
+    void insert(NameHash hash, uint32_t slot)
+    {
+        size_t i = hash & (table_size() - 1);
+        while (table[i] != 0)
+            i = (i + 1) & (table_size() - 1);
+        table[i] = slot + 1;
+    }
+
+    int32_t find(const BankAccount *accounts, uint32_t count, const uint8_t *name, uint32_t length,
+                 NameHash hash) const
+    {
+        (void)count;
+        for (size_t i = hash & (table_size() - 1); table[i] != 0; i = (i + 1) & (table_size() - 1))
+        {
+            uint32_t slot = table[i] - 1;
+            if (accounts[slot].has_name(name, length, hash))
+                return (int32_t)slot;
+        }
+        return NOT_FOUND;
+    }
+};
+
+/* Names are passed in buffers of NameLen bytes, 0-terminated if shorter, */
+/* and live in Names(); an empty name is never an account's. Slots below */
+/* the highest one in use can be free (records that failed to restore); */
+/* only slots marked open hold accounts. Not safe for concurrent create(). */
+template <size_t Capacity, size_t NameLen, template <size_t> class Storage, template <size_t> class Index>
+class Bank
+{
+    static_assert(NameLen > 0 && NameLen <= NAME_LEN_MAX, "names longer than NAME_LEN_MAX do not fit the arena");
+    static_assert(Capacity <= INT32_MAX, "slots are returned as int32_t");
+
+private:
+    Storage<Capacity> storage;
+    Index<Capacity> index;
+    std::bitset<Capacity> open; // slots holding an account
+    uint32_t count;             // highest open slot + 1
+
+public:
+    enum class CreateStatus
+    {
+        Created,
+        NameTaken,
+        BadName, // empty
+        Full,
+        NoNameSpace // Names() is full
+    };
+
+    Bank() : count(0) {}
+    Bank(const Bank &) = delete;
+    Bank &operator=(const Bank &) = delete;
+
+    ~Bank()
+    {
+        for (uint32_t i = 0; i < count; i++)
+            storage.data()[i].release_name();
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+    static constexpr size_t name_size() { return NameLen; }
+    /* false if the whole bank is inside the object, see warm_boot.h */
+    static constexpr bool uses_heap() { return Storage<Capacity>::uses_heap || Index<Capacity>::uses_heap; }
+    uint32_t size() const { return (uint32_t)open.count(); }
+    uint32_t slots() const { return count; }
+    bool in_use(uint32_t id) const { return id < Capacity && open[id]; }
+    bool full() const { return count >= Capacity; }
+    BankAccount &operator[](uint32_t id) { return storage.data()[id]; }
+    const BankAccount &operator[](uint32_t id) const { return storage.data()[id]; }
+    BankAccount *begin() { return storage.data(); }
+    BankAccount *end() { return storage.data() + count; }
+    const BankAccount *begin() const { return storage.data(); }
+    const BankAccount *end() const { return storage.data() + count; }
+
+    /**
+     * @brief  Look up an account by name.
+     * @retval the account, or nullptr if there is none or the name is empty
+     */
+    BankAccount *find(const uint8_t *name)
+    {
+        return find(name, strnlen((const char *)name, NameLen));
+    }
+
+    BankAccount *find(const uint8_t *name, uint32_t length)
+    {
+        if (length == 0)
+            return nullptr;
+        int32_t slot = index.find(storage.data(), count, name, length, NameArena::hash(name, length));
+        return slot < 0 || !open[slot] ? nullptr : &storage.data()[slot];
+    }
+
+    /**
+     * @brief  Look up an account by name and check its password.
+     * @retval the account, or nullptr if the name or password is wrong
+     */
+    BankAccount *authenticate(const uint8_t *name, const uint8_t *password)
+    {
+        BankAccount *account = find(name);
+        return account != nullptr && account->verify_password(password) ? account : nullptr;
+    }
+
+    /**
+     * @brief  Open a new account with a zero balance.
+     * @param  id: set to the new account's id when the status is Created
+     */
+    CreateStatus create(const uint8_t *name, const uint8_t *password, uint32_t *id)
+    {
+        uint32_t length = strnlen((const char *)name, NameLen);
+        if (length == 0)
+            return CreateStatus::BadName;
+        if (find(name, length) != nullptr)
+            return CreateStatus::NameTaken;
+        if (full())
+            return CreateStatus::Full;
+        NameHandle handle = Names().add(name, length);
+        if (handle == NAME_EMPTY)
+            return CreateStatus::NoNameSpace;
+        uint32_t slot = count;
+        storage.data()[slot] = BankAccount(slot, handle, password);
+        index.insert(NameArena::hash(name, length), slot);
+        open.set(slot);
+        count++;
+        *id = slot;
+        return CreateStatus::Created;
+    }
+
+    /**
+     * @brief  Put back an account saved with BankAccount::to_record().
+     * @retval false if the record does not fit this bank, its slot is taken
+     *         or its name is empty or taken
+     */
+    bool restore(const AccountRecord &record)
+    {
+        uint32_t slot = record.account_id;
+        uint32_t length = strnlen((const char *)record.name, NAME_LEN_MAX);
+        if (slot >= Capacity || open[slot] || length == 0 || find(record.name, length) != nullptr)
+            return false;
+        storage.data()[slot].from_record(record);
+        if (storage.data()[slot].get_account_name_length() != length)
+        {
+            storage.data()[slot] = BankAccount(); // Names() is full: leave the slot free
+            return false;
+        }
+        index.insert(NameArena::hash(record.name, length), slot);
+        open.set(slot);
+        if (slot >= count)
+            count = slot + 1;
+        return true;
+    }
+
+    int64_t total_balance() const
+    {
+        return BankAccount::total_balance(storage.data(), count);
+    }
+
+    /**
+     * @brief  Compact Names(), which must hold the names of this bank only.
+     *         Lookups stay valid, as the hashes do not change.
+     */
+    void compact_names()
+    {
+        Names().compact([this](auto remap) {
+            for (uint32_t i = 0; i < count; i++)
+                storage.data()[i].remap_name(remap);
+        });
+    }
+};
+
+/* The console firmware's bank: a handful of accounts in static memory */
+typedef Bank<MAX_ACCOUNTS, NAME_LEN_MAX, StaticStorage, LinearIndex> ConsoleBank;
+/* Its names: NAME_LEN_AVERAGE characters per account, any one name up to */
+/* NAME_LEN_MAX. A name that does not fit is refused (NoNameSpace); a backup */
+/* has the same arena, so it holds whatever names its primary does. */
+#define CONSOLE_NAME_ARENA_SIZE         (MAX_ACCOUNTS * (NAME_LEN_AVERAGE + NAME_ENTRY_OVERHEAD))
+
+#endif // BANK_H
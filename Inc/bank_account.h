@@ -2,28 +2,137 @@
 #define BANK_ACCOUNT_H
 
 #include "main.h"
+#include "name_arena.h"
+#include "seqlock.h"
+#include <atomic>
+
+/* Money in minor units (cents). 32 bits so that balance updates are a single */
+/* LDREX/STREX pair on Cortex-M4, which has no 64-bit exclusive access. */
+typedef int32_t amount_t;
+#define AMOUNT_SCALE                    100
+
+/* Accounts map onto sequence lock stripes by id, so writers to different */
+/* accounts rarely share a counter. One stripe is enough on the MCU. */
+#ifdef HOST_BUILD
+#define SEQLOCK_STRIPES                 64
+#else
+#define SEQLOCK_STRIPES                 1
+#endif
+
+/* Hot accounts take deposits into per-thread slices that are merged on */
+/* read, see BankAccount::make_hot(). The MCU has a single thread. */
+#ifdef HOST_BUILD
+#define HOT_SLICES                      16
+#else
+#define HOT_SLICES                      1
+#endif
+#define HOT_SLICE_MAX                   (1 << 20) /* credit held in a slice before it is folded in */
+/* Ceiling of a hot account's folded balance, leaving room for full slices */
+/* plus one refill each by deposits that raced a fold */
+#define HOT_BALANCE_MAX                 (INT32_MAX - 2 * HOT_SLICES * HOT_SLICE_MAX)
+
+/* Deposit slices of a hot account, one cache line each on the host */
+struct HotSlices
+{
+    struct alignas(SEQLOCK_ALIGN) Slice
+    {
+        std::atomic<amount_t> credit;
+    };
+    Slice slice[HOT_SLICES];
+};
+
+/* Fixed layout of one account in external storage, see account_store.h, */
+/* and in replication frames. A name of NAME_LEN_MAX has no terminator. */
+struct AccountRecord
+{
+    uint16_t magic;
+    uint16_t account_id;
+    uint8_t name[NAME_LEN_MAX];
+    uint8_t password[PASSWORDSIZE];
+    amount_t balance;
+    uint32_t crc; // CRC-32 of everything above
+};
+#define ACCOUNT_RECORD_MAGIC            0xBA4CU
 
 class BankAccount
 {
 private:
-    static uint16_t total_accounts; // Class variable to track the total number of accounts
-    uint16_t account_id;
-    uint8_t account_name[NAMESIZE];
+    static std::atomic<uint32_t> total_accounts; // Class variable to track the total number of accounts
+    uint32_t account_id;
+    NameHandle account_name;               // in Names()
     uint8_t account_password[PASSWORDSIZE];
-    double account_balance;
+    std::atomic<amount_t> account_balance; // of a hot account: without the slices
+    HotSlices *hot;                        // nullptr unless make_hot()
+    static SeqLock ledger_seq[SEQLOCK_STRIPES]; // Lets readers take consistent snapshots of several accounts
+
+    SeqLock &seq() const;
+    static void reserve_id(uint32_t id);
+    bool deposit_slice(amount_t amount);
+    void fold(HotSlices::Slice &slice);
+    void fold_all();
+    void clear_slices();
+
+    static_assert(std::atomic<amount_t>::is_always_lock_free, "balance updates must not take a lock");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "id allocation must not take a lock");
 
 public:
     BankAccount();
     BankAccount(const uint8_t *name, const uint8_t *password);
-    uint16_t get_account_id() const;
+    BankAccount(uint32_t id, const uint8_t *name, const uint8_t *password);
+    BankAccount(uint32_t id, NameHandle name, const uint8_t *password);
+    BankAccount(const BankAccount &other);
+    BankAccount &operator=(const BankAccount &other);
+    uint32_t get_account_id() const;
     bool verify_account_name(uint8_t *name) const;
+    bool has_name(const uint8_t *name, uint32_t length, NameHash hash) const;
     const uint8_t *get_account_name() const;
-    double get_account_balance() const;
-    void deposit(double amount);
-    bool withdraw(double amount);
+    uint32_t get_account_name_length() const;
+    void release_name();
+    template <typename Remap>
+    void remap_name(Remap remap);
+    amount_t get_account_balance() const;
+    bool deposit(amount_t amount);
+    bool withdraw(amount_t amount);
     void set_password(const uint8_t *password);
     bool verify_password(const uint8_t *password) const;
-    static uint16_t get_total_accounts();
+    static uint32_t get_total_accounts();
+    void to_record(AccountRecord *record) const;
+    void from_record(const AccountRecord &record);
+    void make_hot(HotSlices *slices);
+    bool is_hot() const;
+    static bool transfer(BankAccount &from, BankAccount &to, amount_t amount);
+    static int64_t total_balance(const BankAccount *accounts, size_t count);
+    template <typename Fn>
+    static void read_consistent(Fn read);
 };
 
-#endif // BANK_ACCOUNT_H
\ No newline at end of file
+/**
+ * @brief  Replace the name handle with remap(handle), see NameArena::compact().
+ */
+template <typename Remap>
+void BankAccount::remap_name(Remap remap)
+{
+    account_name = remap(account_name);
+}
+
+/**
+ * @brief  Run read() until it completes without overlapping any balance update,
+ *         so everything it reads belongs to one point in time. Writers never wait.
+ */
+template <typename Fn>
+void BankAccount::read_consistent(Fn read)
+{
+    uint32_t start[SEQLOCK_STRIPES];
+    bool retry = false;
+    do
+    {
+        for (uint32_t i = 0; i < SEQLOCK_STRIPES; i++)
+            start[i] = ledger_seq[i].read_begin();
+        read();
+        retry = false;
+        for (uint32_t i = 0; i < SEQLOCK_STRIPES && !retry; i++)
+            retry = ledger_seq[i].read_retry(start[i]);
+    } while (retry);
+}
+
+#endif // BANK_ACCOUNT_H
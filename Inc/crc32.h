@@ -0,0 +1,18 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32 as computed by the STM32F4 CRC unit: polynomial 0x04C11DB7, initial */
+/* value 0xFFFFFFFF, no reflection, no final XOR, fed one little-endian 32-bit */
+/* word at a time. A trailing partial word is zero-padded. */
+#define CRC32_INITIAL                   0xFFFFFFFFU
+/* Buffers at least this long are fed to the CRC unit by DMA on target */
+#define CRC32_DMA_THRESHOLD             256U
+
+void CRC32_Init(void);
+uint32_t crc32_compute(const void *data, size_t len);
+uint32_t crc32_sw(const void *data, size_t len);
+
+#endif // CRC32_H
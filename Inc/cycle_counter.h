@@ -0,0 +1,10 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <stdint.h>
+
+/* Free-running CPU cycle counter: DWT->CYCCNT on target, the TSC on the host */
+void CycleCounter_Init(void);
+uint32_t CycleCounter_Read(void);
+
+#endif // CYCLE_COUNTER_H
@@ -0,0 +1,57 @@
+#ifndef DEDUPE_CACHE_H
+#define DEDUPE_CACHE_H
+
+#include "main.h"
+#include "bank_account.h"
+
+/* Operations that accept a client request id */
+#define DEDUPE_CREATE                   1U
+#define DEDUPE_DEPOSIT                  2U
+#define DEDUPE_WITHDRAW                 3U
+/* Account id used for requests that are not tied to an account yet */
+#define DEDUPE_NO_ACCOUNT               0xFFFFU
+
+/* Outcome of an applied request, returned again when its id is replayed */
+typedef struct
+{
+    bool ok;
+    uint16_t account_id; // for DEDUPE_CREATE, the account that was created
+    amount_t amount;
+} DedupeResult;
+
+/* Fixed-size LRU map from (operation, account, request id) to the result. */
+/* Hash buckets give O(1) lookup, an index-linked list gives O(1) recency */
+/* updates and eviction; no dynamic allocation. */
+class DedupeCache
+{
+private:
+    static const uint16_t NONE = 0xFFFF;
+    struct Entry
+    {
+        uint32_t request_id;
+        uint16_t account_id;
+        uint8_t op;
+        uint16_t prev, next; // LRU list, head is most recently used
+        uint16_t chain;      // next entry in the same bucket
+        DedupeResult result;
+    };
+    Entry entries[DEDUPE_CACHE_SIZE];
+    uint16_t buckets[DEDUPE_CACHE_BUCKETS];
+    uint16_t lru_head, lru_tail;
+    uint16_t used;
+
+    static uint32_t bucket_of(uint8_t op, uint16_t account_id, uint32_t request_id);
+    void unlink(uint16_t idx);
+    void push_front(uint16_t idx);
+    void remove_from_bucket(uint16_t idx);
+
+public:
+    DedupeCache();
+    void clear();
+    const DedupeResult *find(uint8_t op, uint16_t account_id, uint32_t request_id);
+    void insert(uint8_t op, uint16_t account_id, uint32_t request_id, const DedupeResult &result);
+};
+
+uint32_t split_request_id(uint8_t *buf, uint32_t buf_size);
+
+#endif // DEDUPE_CACHE_H
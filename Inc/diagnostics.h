@@ -0,0 +1,9 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "main.h"
+#include "bank.h"
+
+bool run_diagnostics(const ConsoleBank &bank);
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,21 @@
+#ifndef EXT_MEM_H
+#define EXT_MEM_H
+
+#include <stdint.h>
+
+/* External I2C FRAM/EEPROM. Writes are started in the background (DMA on */
+/* target) and must not cross an EXT_MEM_PAGE_SIZE boundary; ExtMem_Poll() */
+/* reports when the device can take the next one. */
+typedef enum
+{
+    EXT_MEM_IDLE = 0,
+    EXT_MEM_BUSY,  // transfer or internal write cycle in progress
+    EXT_MEM_ERROR, // the last write failed; reported once, then idle
+} ExtMemState;
+
+void ExtMem_Init(void);
+bool ExtMem_Read(uint32_t addr, uint8_t *buf, uint32_t len);
+bool ExtMem_WriteStart(uint32_t addr, const uint8_t *buf, uint32_t len);
+ExtMemState ExtMem_Poll(void);
+
+#endif // EXT_MEM_H
@@ -0,0 +1,40 @@
+#ifndef LEDGER_DIGEST_H
+#define LEDGER_DIGEST_H
+
+#include "main.h"
+#include "bank_account.h"
+
+/* Merkle-style digest of the account table. Leaf i is the CRC-32 of account */
+/* i's record (the same CRC the account store keeps); every inner node is the */
+/* CRC-32 of its two children. Changing one account rehashes its path to the */
+/* root, log2(leaves) 8-byte CRCs. Two digests with equal roots describe the */
+/* same table; when they differ, find_mismatch() walks down to the first */
+/* account that differs in O(log N). */
+constexpr uint32_t ledger_digest_leaves(uint32_t accounts)
+{
+    uint32_t leaves = 1;
+    while (leaves < accounts)
+        leaves <<= 1;
+    return leaves;
+}
+
+class LedgerDigest
+{
+public:
+    static constexpr uint32_t LEAVES = ledger_digest_leaves(MAX_ACCOUNTS);
+    static const uint32_t NO_MISMATCH = 0xFFFFFFFFU;
+
+    LedgerDigest();
+    void clear();
+    void update(uint32_t index, uint32_t leaf);
+    void update(const BankAccount &account);
+    uint32_t root() const { return nodes[1]; }
+    uint32_t leaf(uint32_t index) const { return nodes[LEAVES + index]; }
+    uint32_t find_mismatch(const LedgerDigest &other) const;
+    static uint32_t leaf_hash(const BankAccount &account);
+
+private:
+    uint32_t nodes[2 * LEAVES]; // heap order: root at 1, children of n at 2n and 2n+1
+};
+
+#endif // LEDGER_DIGEST_H
@@ -25,43 +25,115 @@
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
-/* User can use this section to tailor USARTx/UARTx instance used and associated 
-   resources */
-/* Definition for USARTx clock resources */
-#define USARTx                           USART1
-#define USARTx_CLK_ENABLE()              __HAL_RCC_USART1_CLK_ENABLE();
-#define USARTx_RX_GPIO_CLK_ENABLE()      __HAL_RCC_GPIOA_CLK_ENABLE()
-#define USARTx_TX_GPIO_CLK_ENABLE()      __HAL_RCC_GPIOA_CLK_ENABLE() 
+/* Clock tree set up by SystemClock_Config(): 100 MHz from the 25 MHz HSE */
+#define SYSCLK_HZ                        100000000U
+#define APB1_CLOCK_HZ                    (SYSCLK_HZ / 2)
+#define APB2_CLOCK_HZ                    SYSCLK_HZ
 
-#define USARTx_FORCE_RESET()             __HAL_RCC_USART1_FORCE_RESET()
-#define USARTx_RELEASE_RESET()           __HAL_RCC_USART1_RELEASE_RESET()
-
-/* Definition for USARTx Pins */
+/* Console UART, driven through its registers by Uart<> (see uart.h): */
+/* USART1 on PA9 TX / PA10 RX */
+#define USARTx_BASE                      USART1_BASE
+#define USARTx_BAUD                      9600U
+#define USARTx_GPIO_BASE                 GPIOA_BASE
 #define USARTx_TX_PIN                    GPIO_PIN_9
-#define USARTx_TX_GPIO_PORT              GPIOA  
-#define USARTx_TX_AF                     GPIO_AF7_USART1
 #define USARTx_RX_PIN                    GPIO_PIN_10
-#define USARTx_RX_GPIO_PORT              GPIOA 
-#define USARTx_RX_AF                     GPIO_AF7_USART1
-
-/* Definition for USARTx's NVIC */
-#define USARTx_IRQn                      USART1_IRQn
+#define USARTx_AF                        GPIO_AF7_USART1
 #define USARTx_IRQHandler                USART1_IRQHandler
 
+/* Definition for the I2C FRAM/EEPROM holding the account table (24LC256, */
+/* FM24V02 or compatible: 16-bit memory addresses) */
+#define EXT_MEM_I2C                      I2C1
+#define EXT_MEM_I2C_CLK_ENABLE()         __HAL_RCC_I2C1_CLK_ENABLE()
+#define EXT_MEM_GPIO_CLK_ENABLE()        __HAL_RCC_GPIOB_CLK_ENABLE()
+#define EXT_MEM_SCL_PIN                  GPIO_PIN_8
+#define EXT_MEM_SDA_PIN                  GPIO_PIN_9
+#define EXT_MEM_GPIO_PORT                GPIOB
+#define EXT_MEM_AF                       GPIO_AF4_I2C1
+#define EXT_MEM_EV_IRQn                  I2C1_EV_IRQn
+#define EXT_MEM_EV_IRQHandler            I2C1_EV_IRQHandler
+#define EXT_MEM_ER_IRQn                  I2C1_ER_IRQn
+#define EXT_MEM_ER_IRQHandler            I2C1_ER_IRQHandler
+#define EXT_MEM_DMA_CLK_ENABLE()         __HAL_RCC_DMA1_CLK_ENABLE()
+#define EXT_MEM_DMA_TX_STREAM            DMA1_Stream7
+#define EXT_MEM_DMA_TX_CHANNEL           DMA_CHANNEL_1
+#define EXT_MEM_DMA_TX_IRQn              DMA1_Stream7_IRQn
+#define EXT_MEM_DMA_TX_IRQHandler        DMA1_Stream7_IRQHandler
+#define EXT_MEM_DEV_ADDR                 0xA0U
+#define EXT_MEM_I2C_SPEED                400000U
+#define EXT_MEM_SIZE                     32768U
+#define EXT_MEM_PAGE_SIZE                64U
+#define EXT_MEM_WRITE_CYCLE_MS           5U    /* EEPROM page write time, 0 for FRAM */
+
+/* Definition for the replication link to the backup board (USART2, PA2 TX / */
+/* PA3 RX, crossed over to the other board) and the role strap: PB12 tied to */
+/* ground at reset makes the board the backup */
+#define REPL_USART                       USART2
+#define REPL_USART_CLK_ENABLE()          __HAL_RCC_USART2_CLK_ENABLE()
+#define REPL_USART_FORCE_RESET()         __HAL_RCC_USART2_FORCE_RESET()
+#define REPL_USART_RELEASE_RESET()       __HAL_RCC_USART2_RELEASE_RESET()
+#define REPL_GPIO_CLK_ENABLE()           __HAL_RCC_GPIOA_CLK_ENABLE()
+#define REPL_TX_PIN                      GPIO_PIN_2
+#define REPL_RX_PIN                      GPIO_PIN_3
+#define REPL_GPIO_PORT                   GPIOA
+#define REPL_AF                          GPIO_AF7_USART2
+#define REPL_IRQn                        USART2_IRQn
+#define REPL_IRQHandler                  USART2_IRQHandler
+#define REPL_BAUD                        460800U
+#define REPL_ROLE_GPIO_CLK_ENABLE()      __HAL_RCC_GPIOB_CLK_ENABLE()
+#define REPL_ROLE_PIN                    GPIO_PIN_12
+#define REPL_ROLE_GPIO_PORT              GPIOB
+
+/* Sampling timer of the PC profiler (see profiler.h): TIM2 on APB1, whose */
+/* timers run at twice the bus clock. The highest interrupt priority, so it */
+/* alone can interrupt the other handlers */
+#define PROFILER_TIM                     TIM2
+#define PROFILER_TIM_CLK_ENABLE()        __HAL_RCC_TIM2_CLK_ENABLE()
+#define PROFILER_TIM_CLOCK_HZ            (2 * APB1_CLOCK_HZ)
+#define PROFILER_IRQn                    TIM2_IRQn
+#define PROFILER_IRQHandler              TIM2_IRQHandler
+
 /* Size of Transmission buffer */
 #define TXSTARTMESSAGESIZE                   (COUNTOF(aTxStartMessage) - 1)
 #define TXENDMESSAGESIZE                     (COUNTOF(aTxEndMessage) - 1)
 
 /* Size of Reception buffer */
-#define NAMESIZE                        10
+#define NAMESIZE                        10    /* fixed name field of the host ledger's tables */
+#define NAME_LEN_MAX                    40    /* longest account name; an AccountRecord fills one ext page */
+#define NAME_LEN_AVERAGE                16    /* console name arena budget per account */
 #define PASSWORDSIZE                    10
-#define AMOUNTSIZE                      10
 #define OPTIONSIZE                      3
 #define MAX_ACCOUNTS                    10
+#define UART_RX_RING_SIZE               64
+#define REQUEST_ID_SIZE                 9     /* "#" and up to 8 hex digits */
+#define DEDUPE_CACHE_SIZE               32
+#define DEDUPE_CACHE_BUCKETS            64
+#define TRACE_ENABLED                   1
+#define TRACE_ITM_PORT                  1     /* ITM stimulus port for the SWO trace */
+#define PROFILER_ENABLED                1
+#define PROFILER_HZ                     997U  /* prime, so it does not beat with the 1 kHz tick */
 #define ENTRY_WAIT                      0xFFFFFFFFU
 #define TRANSACTION_WAIT                20000U
+#define SESSION_TIMEOUT                 300000U  /* session ends this long after its last command, ms */
+#define SESSION_RESUME_WAIT             120000U  /* a timed-out session can be resumed this long, ms */
+#define SESSION_TOKENS_MAX              4
+#define SESSION_TOKEN_DIGITS            8     /* hex digits after R at the welcome prompt */
+/* Welcome menu B password, kept only as its SHA-256 in hex; provision a */
+/* board with cmake -DBATCH_PASSWORD_SHA256=<sha256sum of the password> */
+#ifndef BATCH_PASSWORD_SHA256
+#define BATCH_PASSWORD_SHA256           "60f91a742458ae606572f40dd7df0a128e554acb023f6989fe5148872648fc56" /* "payroll" */
+#endif
+#define BATCH_ATTEMPTS_MAX              3     /* wrong batch passwords in a row before the lockout */
+#define BATCH_LOCKOUT_MS                60000U
+#define BATCH_FAILURES_MAX              16    /* failed records listed by number */
 /* Exported macro ------------------------------------------------------------*/
 #define COUNTOF(__BUFFER__)   (sizeof(__BUFFER__) / sizeof(*(__BUFFER__)))
+/* Variables in this section are not zeroed by the startup code */
+#define NOINIT                __attribute__((section(".noinit")))
 /* Exported functions ------------------------------------------------------- */
+#ifdef __cplusplus
+void Error_Handler(void);
+void UART_SendString(const char *msg);
+bool get_user_input(const char *prompt, uint8_t *buf, uint32_t buf_size, uint32_t delay);
+#endif
 
 #endif /* __MAIN_H */
@@ -0,0 +1,102 @@
+#ifndef NAME_ARENA_H
+#define NAME_ARENA_H
+
+#include "main.h"
+#include <atomic>
+
+/* Account names, each stored once in an append-only byte arena shared by */
+/* every account: a length byte, the precomputed hash, the text and a */
+/* terminating 0. An account keeps only a NameHandle (offset + 1; 0 */
+/* is the empty name, which takes no space), and comparisons check the */
+/* hash and the length before any bytes. */
+/* Releasing a name only marks it dead; compact() slides the live names */
+/* together and rewrites the handles of their holders. */
+/* add() is safe from several threads; release() and compact() are not. */
+
+#ifdef HOST_BUILD
+typedef uint32_t NameHandle;
+#define NAME_ARENA_DEFAULT_SIZE         (64U << 20) /* arena of banks that bring none */
+#else
+typedef uint16_t NameHandle; // arenas up to 64 KB
+#endif
+/* Stored hash; the same width as a handle, since compact() keeps the */
+/* forwarding handle in its place */
+typedef NameHandle NameHash;
+
+#define NAME_EMPTY                      0
+#define NAME_ENTRY_OVERHEAD             (1 + sizeof(NameHash) + 1) /* length, hash, terminator */
+
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t used;            // bytes, live and dead
+    uint32_t names;           // live
+    uint32_t dead_names;      // released since the last compaction
+    uint32_t dead_bytes;      // held by released names: the fragmentation
+    uint32_t compactions;
+    uint32_t reclaimed_bytes; // by all compactions
+    uint32_t failed_adds;     // no room even after compacting
+} NameArenaStats;
+
+class NameArena;
+/* Compacts arena with every holder of a handle, see set_compactor() */
+typedef void (*NameCompactor)(NameArena &arena);
+
+class NameArena
+{
+private:
+    static const uint8_t ENTRY_DEAD = 0x80; // in the length byte
+    static const uint8_t ENTRY_LENGTH = 0x7F;
+
+    uint8_t *bytes;
+    uint32_t capacity;
+    std::atomic<uint32_t> used;
+    std::atomic<uint32_t> names;
+    uint32_t dead_names;
+    uint32_t dead_bytes;
+    uint32_t compactions;
+    uint32_t reclaimed_bytes;
+    std::atomic<uint32_t> failed_adds;
+    NameCompactor compactor;
+
+    static uint32_t entry_size(uint32_t length) { return NAME_ENTRY_OVERHEAD + (length & ENTRY_LENGTH); }
+    const uint8_t *entry(NameHandle name) const { return bytes + name - 1; }
+    NameHash stored_hash(NameHandle name) const;
+    void forward_all();
+    NameHandle forward(NameHandle name) const;
+    void slide();
+
+public:
+    NameArena();
+    NameArena(uint8_t *buffer, uint32_t size);
+    bool bind(uint8_t *buffer, uint32_t size, uint32_t in_use);
+    void set_compactor(NameCompactor fn);
+    NameHandle add(const uint8_t *name, uint32_t length);
+    void release(NameHandle name);
+    bool equals(NameHandle name, const uint8_t *text, uint32_t length, NameHash hash) const;
+    const uint8_t *text(NameHandle name) const;
+    uint32_t length(NameHandle name) const;
+    uint32_t get_used() const { return used.load(std::memory_order_acquire); }
+    void get_stats(NameArenaStats *stats) const;
+    template <typename ForEachHolder>
+    void compact(ForEachHolder for_each_holder);
+    static NameHash hash(const uint8_t *name, uint32_t length);
+};
+
+/**
+ * @brief  Move the live names together. for_each_holder(remap) must call
+ *         remap(handle) for the handle of every live name's holder and store
+ *         the handle it returns; handles of released names come back empty.
+ */
+template <typename ForEachHolder>
+void NameArena::compact(ForEachHolder for_each_holder)
+{
+    forward_all();
+    for_each_holder([this](NameHandle name) { return forward(name); });
+    slide();
+}
+
+/* The arena every BankAccount name lives in */
+NameArena &Names(void);
+
+#endif // NAME_ARENA_H
@@ -0,0 +1,48 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "main.h"
+
+/* Statistical PC-sampling profiler. A timer interrupt PROFILER_HZ times a */
+/* second takes the PC it interrupted and counts it in a histogram of */
+/* equal address ranges over the code: bucket i holds the samples in */
+/* [base + (i << shift), base + ((i + 1) << shift)). The shift is the */
+/* smallest that covers the whole code with PROFILER_BUCKETS buckets. */
+/* A bucket about to overflow halves every bucket, so the proportions */
+/* stay right however long it runs. */
+/* Diagnostics H dumps the histogram as text and starts a new one; */
+/* tools/profile2sym.py maps the buckets to function names with the ELF. */
+/* Time asleep in __WFI() is counted where the main loop waits for input. */
+
+#ifdef HOST_BUILD
+#define PROFILER_BUCKETS                16384U
+#else
+#define PROFILER_BUCKETS                2048U
+#endif
+
+typedef struct
+{
+    uintptr_t base;     // address of bucket 0
+    uint32_t shift;     // buckets are 1 << shift bytes wide
+    uint32_t buckets;   // buckets covering the code
+    uintptr_t anchor;   // run-time address of Profiler_Init(), to relocate a PIE host build
+    uint32_t hz;        // sampling rate
+    uint32_t samples;   // since the last Profiler_Clear(), before halving
+    uint32_t outside;   // PCs outside the code range (RAM, boot ROM, shared libraries)
+    uint32_t halvings;  // times the histogram was halved
+} ProfilerInfo;
+
+extern uint16_t profiler_counts[PROFILER_BUCKETS];
+
+void Profiler_Init(void);
+/* From the sampling interrupt: count one interrupted PC */
+void Profiler_Sample(uintptr_t pc);
+void Profiler_Pause(bool paused);
+void Profiler_Clear(void);
+void Profiler_GetInfo(ProfilerInfo *info);
+
+/* Provided by profiler_tim.cpp on target and profiler_host.cpp on the host */
+void Profiler_CodeRange(uintptr_t *start, uintptr_t *end);
+void Profiler_StartTimer(uint32_t hz);
+
+#endif // PROFILER_H
@@ -0,0 +1,72 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "main.h"
+#include "bank.h"
+
+/* Primary-backup replication of the account table over REPL_USART. The */
+/* primary logs every change as a sequenced record and streams the account's */
+/* full record to the backup, which applies records strictly in sequence */
+/* order and acknowledges them cumulatively. Unacknowledged records are */
+/* resent after REPL_RETRY_MS (go-back-N). A backup that is too far behind, */
+/* or new, gets a snapshot of every account instead, and so does the backup */
+/* of a primary that just started or was promoted, whose sequence need not */
+/* follow on from what the backup saw. Shipping whole records makes */
+/* applying idempotent, so resends are harmless. */
+
+/* Records the primary keeps until the backup acknowledges them */
+#define REPL_LOG_SIZE                   32U
+#define REPL_RETRY_MS                   50U
+/* A backup that hears nothing for this long asks the primary to resync */
+#define REPL_HELLO_MS                   500U
+
+typedef enum
+{
+    REPL_ROLE_NONE,    // no link (host without BANK_REPL_FDS)
+    REPL_ROLE_PRIMARY,
+    REPL_ROLE_BACKUP
+} ReplRole;
+
+/* Record operations */
+#define REPL_OP_CREATE                  1U
+#define REPL_OP_DEPOSIT                 2U
+#define REPL_OP_WITHDRAW                3U
+#define REPL_OP_TRANSFER                4U /* standing order, one record per account */
+#define REPL_OP_SNAPSHOT                5U /* resync of one account */
+#define REPL_OP_SYNC                    6U /* start of a snapshot: restart sequence here */
+
+typedef struct
+{
+    /* Primary */
+    uint32_t next_seq;       // sequence number of the next record
+    uint32_t acked_seq;      // everything before this is on the backup
+    uint32_t frames_sent;
+    uint32_t retransmits;
+    uint32_t resyncs;
+    uint32_t lag_ms;         // age of the oldest unacknowledged record
+    uint32_t max_lag_ms;
+    uint32_t acked_records;  // since start_tick, for throughput
+    uint32_t start_tick;
+    /* Backup */
+    uint32_t applied;
+    uint32_t duplicates;
+    uint32_t gaps;
+    uint32_t last_rx_tick;
+    /* Both */
+    uint32_t bad_frames;     // CRC or framing errors
+} ReplicationStats;
+
+extern UART_HandleTypeDef ReplHandle;
+
+void Replication_Init(ConsoleBank &bank);
+ReplRole Replication_Role(void);
+void Replication_Log(uint8_t op, const BankAccount &account);
+void Replication_Service(void);
+bool Replication_Promote(void);
+void Replication_GetStats(ReplicationStats *stats);
+/* From the HAL UART callbacks when huart is &ReplHandle */
+void Replication_RxCpltCallback(void);
+void Replication_TxCpltCallback(void);
+void Replication_ErrorCallback(void);
+
+#endif // REPLICATION_H
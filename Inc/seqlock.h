@@ -0,0 +1,33 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "main.h"
+#include <atomic>
+
+#ifdef HOST_BUILD
+#define SEQLOCK_ALIGN                   64 // one cache line per sequence lock
+#else
+#define SEQLOCK_ALIGN                   4
+#endif
+
+/* Sequence lock that allows several concurrent writers: writers bump 'begun' */
+/* before and 'ended' after their update and never wait. A reader samples */
+/* 'ended', reads, and retries if 'begun' has moved past that sample, which */
+/* means a write was in flight or started meanwhile. */
+/* Readers must not run at a higher priority than the writers (e.g. in an ISR */
+/* that preempts deposit()), or they can retry forever. */
+class alignas(SEQLOCK_ALIGN) SeqLock
+{
+private:
+    std::atomic<uint32_t> begun;
+    std::atomic<uint32_t> ended;
+
+public:
+    SeqLock();
+    void write_begin();
+    void write_end();
+    uint32_t read_begin() const;
+    bool read_retry(uint32_t start) const;
+};
+
+#endif // SEQLOCK_H
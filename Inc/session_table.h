@@ -0,0 +1,47 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include "main.h"
+
+/* Resume tokens for account sessions. A token is issued at login; when the */
+/* session ends on an input timeout it stays valid for SESSION_RESUME_WAIT, */
+/* so the client can send R<token> at the welcome prompt and be back in its */
+/* account menu without the name and password round trips. The session */
+/* deadline is SESSION_TIMEOUT after its last menu command, running or */
+/* suspended. Quit, the deadline or a newer login to the same account end */
+/* the token. */
+/* Tokens are 32-bit values mixed from the cycle counter at login; they */
+/* are not a cryptographic secret, guessing is bounded by the line rate */
+/* and the few minutes a token lives. */
+
+class SessionTable
+{
+private:
+    struct Entry
+    {
+        uint32_t token;    // 0: free
+        uint32_t expires;  // tick after which the token is refused
+        uint32_t deadline; // SESSION_TIMEOUT after the last command of the session
+        uint16_t account_id;
+        bool active;       // the session is running, so the token cannot be resumed
+    };
+    Entry entries[SESSION_TOKENS_MAX];
+    uint32_t seed;
+
+    static bool before(uint32_t tick, uint32_t now);
+    Entry *find(uint32_t token);
+    uint32_t next_token(uint32_t entropy);
+
+public:
+    SessionTable();
+    void clear();
+    uint32_t issue(uint16_t account_id, uint32_t now, uint32_t entropy);
+    void touch(uint32_t token, uint32_t now);
+    void suspend(uint32_t token, uint32_t now);
+    bool resume(uint32_t token, uint32_t now, uint16_t *account_id, uint32_t *time_left);
+    void revoke(uint32_t token);
+};
+
+uint32_t parse_session_token(const uint8_t *text);
+
+#endif // SESSION_TABLE_H
@@ -0,0 +1,15 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SHA-256 (FIPS 180-4) for checking secrets the firmware only keeps as a */
+/* digest, such as the batch password. One call per message; no streaming. */
+#define SHA256_SIZE                     32U /* digest bytes */
+
+void sha256_compute(const void *data, size_t len, uint8_t digest[SHA256_SIZE]);
+bool sha256_equal(const uint8_t *a, const uint8_t *b, size_t len);
+bool sha256_parse(const char *hex, uint8_t digest[SHA256_SIZE]);
+
+#endif // SHA256_H
@@ -0,0 +1,50 @@
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define STACK_PAINT_PATTERN             0xC5C5C5C5U
+#define FAULT_RECORD_MAGIC              0xFA017EC0U
+
+/* Fault kinds passed by the exception handlers */
+#define FAULT_HARD                      1U
+#define FAULT_MEMMANAGE                 2U
+#define FAULT_BUS                       3U
+#define FAULT_USAGE                     4U
+
+/* Stack that was active when the fault was taken */
+#define FAULT_STACK_MSP                 0U
+#define FAULT_STACK_PSP                 1U
+
+/* Record of the last fault, kept in .noinit RAM so it survives the reset */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t fault_type;
+    uint32_t stack;      // FAULT_STACK_MSP or FAULT_STACK_PSP
+    uint32_t overflowed; // 1 if that stack ran past its limit
+    uint32_t sp;
+    uint32_t pc;
+    uint32_t lr;
+    uint32_t cfsr;
+    uint32_t hfsr;
+} FaultRecord;
+
+void Stack_Paint(void);
+uint32_t Stack_GetSize(void);
+uint32_t Stack_GetReserved(void);
+uint32_t Stack_GetHighWaterMark(void);
+const FaultRecord *Fault_GetLastRecord(void);
+void Fault_ClearRecord(void);
+__attribute__((noreturn)) void Fault_Capture(uint32_t *frame, uint32_t exc_return, uint32_t fault_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STACK_MONITOR_H
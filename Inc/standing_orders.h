@@ -0,0 +1,38 @@
+#ifndef STANDING_ORDERS_H
+#define STANDING_ORDERS_H
+
+#include "main.h"
+#include "bank.h"
+#include "timer_wheel.h"
+
+/* Recurring transfers between accounts. Each order holds a periodic timer */
+/* on the main loop's timing wheel; when it is due the transfer runs as a */
+/* withdraw()/deposit() pair and both accounts are queued for storage. */
+/* Orders are kept in RAM only. */
+#ifdef HOST_BUILD
+#define STANDING_ORDERS_MAX             8192U
+#else
+#define STANDING_ORDERS_MAX             16U
+#endif
+#define STANDING_ORDER_MIN_PERIOD_S     1U
+#define STANDING_ORDER_MAX_PERIOD_S     (90U * 24U * 3600U)
+
+#define STANDING_ORDER_NONE             0xFFFFFFFFU
+
+typedef struct
+{
+    uint32_t from;
+    uint32_t to;
+    amount_t amount;
+    uint32_t period_s;
+    uint32_t executed; // transfers made
+    uint32_t refused;  // runs skipped for insufficient balance
+} StandingOrder;
+
+void StandingOrders_Init(ConsoleBank &bank, TimerWheel &timers);
+uint32_t StandingOrders_Create(uint32_t from, uint32_t to, amount_t amount, uint32_t period_s);
+bool StandingOrders_Cancel(uint32_t order, uint32_t owner);
+const StandingOrder *StandingOrders_Get(uint32_t order);
+uint32_t StandingOrders_Active(void);
+
+#endif // STANDING_ORDERS_H
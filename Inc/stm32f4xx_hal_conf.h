@@ -37,7 +37,7 @@
 /*#define HAL_ADC_MODULE_ENABLED */
 /*#define HAL_CAN_MODULE_ENABLED */
 /*#define HAL_CAN_LEGACY_MODULE_ENABLED */
-/*#define HAL_CRC_MODULE_ENABLED */
+#define HAL_CRC_MODULE_ENABLED
 /* #define HAL_CRYP_MODULE_ENABLED */ 
 /*#define HAL_DAC_MODULE_ENABLED */
 /*#define HAL_DCMI_MODULE_ENABLED */
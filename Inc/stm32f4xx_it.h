@@ -41,6 +41,11 @@ void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
 void USARTx_IRQHandler(void);
+void REPL_IRQHandler(void);
+void EXT_MEM_EV_IRQHandler(void);
+void EXT_MEM_ER_IRQHandler(void);
+void EXT_MEM_DMA_TX_IRQHandler(void);
+void PROFILER_IRQHandler(void);
 
 #ifdef __cplusplus
 }
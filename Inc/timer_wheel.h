@@ -0,0 +1,63 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "main.h"
+
+/* Timers in the pool; each standing order and each session holds one */
+#ifdef HOST_BUILD
+#define TIMER_WHEEL_SIZE                16384U
+#else
+#define TIMER_WHEEL_SIZE                32U
+#endif
+#define TIMER_WHEEL_BITS                6U  /* 64 slots per level */
+#define TIMER_WHEEL_LEVELS              4U  /* 1 ms up to 2^24 ms (4.6 h) */
+
+typedef void (*TimerCallback)(uint32_t arg);
+/* Generation in the high half, pool index in the low half; 0 is no timer */
+typedef uint32_t TimerHandle;
+#define TIMER_NONE                      0U
+
+/* Hierarchical timing wheel with millisecond ticks. Level l has 64 slots of */
+/* 64^l ms; a timer sits in the lowest level its remaining time fits in and */
+/* moves down a level each time the level above turns over. Scheduling and */
+/* cancelling are O(1), and a tick costs the timers due in it plus, every */
+/* 64 ticks, one cascaded slot - not the number of timers pending. */
+/* Timers are index-linked lists in a fixed pool; no dynamic allocation. */
+/* Callbacks run from advance(), in the caller's context. */
+class TimerWheel
+{
+private:
+    static const uint16_t NONE = 0xFFFF;
+    static const uint32_t SLOTS = 1U << TIMER_WHEEL_BITS;
+    struct Timer
+    {
+        uint32_t expires;
+        uint32_t period; // 0 for a one-shot timer
+        TimerCallback callback;
+        uint32_t arg;
+        uint16_t prev, next;
+        uint16_t slot;       // level * SLOTS + index, or NONE when not queued
+        uint16_t generation; // bumped on every reuse, so stale handles miss
+    };
+    Timer timers[TIMER_WHEEL_SIZE];
+    uint16_t slots[TIMER_WHEEL_LEVELS * SLOTS];
+    uint16_t free_head;
+    uint16_t used;
+    uint32_t current; // last tick processed
+
+    void place(uint16_t idx);
+    void unlink(uint16_t idx);
+    void cascade(uint32_t level);
+    Timer *lookup(TimerHandle handle);
+
+public:
+    TimerWheel();
+    void clear(uint32_t now);
+    TimerHandle schedule(uint32_t delay, uint32_t period, TimerCallback callback, uint32_t arg);
+    bool cancel(TimerHandle handle);
+    bool pending(TimerHandle handle);
+    uint32_t advance(uint32_t now);
+    uint16_t active() const { return used; }
+};
+
+#endif // TIMER_WHEEL_H
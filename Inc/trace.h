@@ -0,0 +1,93 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "main.h"
+#include "cycle_counter.h"
+#include <atomic>
+
+/* Event list: X(name, track). Track 0 is the main loop, 1 is interrupt */
+/* context. tools/trace2json.py reads the names and tracks from this list, */
+/* so new events only need adding here. */
+#define TRACE_EVENTS(X)                                                         \
+    X(UART_RX_WAIT, 0)  /* UART_GetChar() waiting for a byte */                 \
+    X(UART_TX, 0)       /* UART_SendString() */                                 \
+    X(UART_RX_BYTE, 1)  /* receive interrupt, arg = byte */                     \
+    X(MENU_CREATE, 0)   /* welcome menu N */                                    \
+    X(MENU_LOGIN, 0)    /* welcome menu E */                                    \
+    X(MENU_STATUS, 0)   /* welcome menu S */                                    \
+    X(MENU_BATCH, 0)    /* welcome menu B */                                    \
+    X(MENU_BALANCE, 0)  /* account menu B */                                    \
+    X(MENU_DEPOSIT, 0)  /* account menu D */                                    \
+    X(MENU_WITHDRAW, 0) /* account menu W */                                    \
+    X(LOOKUP, 0)        /* account name lookup / authentication */              \
+    X(STORE_WRITE, 0)   /* external memory page write started, arg = page */
+
+enum TraceEvent : uint8_t
+{
+#define TRACE_ENUM(name, track) TRACE_##name,
+    TRACE_EVENTS(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_EVENT_COUNT
+};
+
+/* Phases use the Chrome trace letters */
+#define TRACE_PHASE_BEGIN               'B'
+#define TRACE_PHASE_END                 'E'
+#define TRACE_PHASE_INSTANT             'i'
+
+/* Records kept in RAM; when the ring is full the oldest are overwritten */
+#ifdef HOST_BUILD
+#define TRACE_RING_SIZE                 65536U
+#else
+#define TRACE_RING_SIZE                 128U
+#endif
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+typedef struct
+{
+    uint32_t cycles; // CycleCounter_Read()
+    uint32_t tick;   // HAL_GetTick(), to place cycle counter wraps
+    uint8_t event;
+    uint8_t phase;
+    uint16_t arg;
+} TraceRecord;
+
+extern TraceRecord trace_ring[TRACE_RING_SIZE];
+extern std::atomic<uint32_t> trace_head;
+extern std::atomic<bool> trace_paused; // set while the ring is being dumped
+
+/**
+ * @brief  Append one record. A slot is claimed atomically, so interrupts may
+ *         trace while the main loop is tracing.
+ */
+static inline void Trace_Record(uint8_t event, uint8_t phase, uint16_t arg)
+{
+    if (trace_paused.load(std::memory_order_relaxed))
+        return;
+    uint32_t slot = trace_head.fetch_add(1, std::memory_order_relaxed) & (TRACE_RING_SIZE - 1);
+    TraceRecord &r = trace_ring[slot];
+    r.cycles = CycleCounter_Read();
+    r.tick = HAL_GetTick();
+    r.event = event;
+    r.phase = phase;
+    r.arg = arg;
+}
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(name)               Trace_Record(TRACE_##name, TRACE_PHASE_BEGIN, 0)
+#define TRACE_END(name)                 Trace_Record(TRACE_##name, TRACE_PHASE_END, 0)
+#define TRACE_INSTANT(name, arg)        Trace_Record(TRACE_##name, TRACE_PHASE_INSTANT, (uint16_t)(arg))
+#else
+#define TRACE_BEGIN(name)               ((void)0)
+#define TRACE_END(name)                 ((void)0)
+#define TRACE_INSTANT(name, arg)        ((void)0)
+#endif
+
+void Trace_Init(void);
+bool Trace_Next(TraceRecord *record);
+uint32_t Trace_Dropped(void);
+/* Provided by the backend: ITM/SWO on target, a file on the host */
+void Trace_Drain(void);
+uint32_t Trace_CyclesPerUs(void);
+
+#endif // TRACE_H
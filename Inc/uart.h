@@ -0,0 +1,170 @@
+#ifndef UART_H
+#define UART_H
+
+#include "main.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Register-level UART driver with everything resolved at compile time: the */
+/* register block, bus clock and clock enable bit, baud divisor and IRQ of */
+/* the instance are constants, so sending a byte is a TXE poll and a store */
+/* and receiving one is a status and a data register read. No handle, no */
+/* state machine, no locking or timeout bookkeeping per byte. */
+/* Frames are 8N1 with 16x oversampling; only receive interrupts are used, */
+/* transmission polls, as HAL_UART_Transmit() did. */
+
+/**
+ * @brief  Register block of a peripheral at a bus address. The host build
+ *         maps the address onto its model of the peripheral.
+ */
+template <typename Regs, uintptr_t Base>
+inline Regs *peripheral()
+{
+#ifdef HOST_BUILD
+    return static_cast<Regs *>(HAL_Host_Peripheral(Base));
+#else
+    return reinterpret_cast<Regs *>(Base);
+#endif
+}
+
+/* TX and RX pin (GPIO_PIN_x masks) of a UART on one GPIO port, and their */
+/* alternate function */
+template <uintptr_t Port, uint16_t TxPin, uint16_t RxPin, uint8_t Af>
+struct UartPins
+{
+    static_assert(TxPin != 0 && (TxPin & (TxPin - 1)) == 0, "TxPin must be a single GPIO_PIN_x");
+    static_assert(RxPin != 0 && (RxPin & (RxPin - 1)) == 0, "RxPin must be a single GPIO_PIN_x");
+    static constexpr uint32_t PORT_INDEX = (Port - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+    static constexpr uint32_t TX = __builtin_ctz(TxPin);
+    static constexpr uint32_t RX = __builtin_ctz(RxPin);
+
+    /* A two-bit field (MODER, OSPEEDR, PUPDR) set to value for both pins */
+    static constexpr uint32_t both(uint32_t value)
+    {
+        return (value << (2 * TX)) | (value << (2 * RX));
+    }
+
+    static void set_af(GPIO_TypeDef *gpio, uint32_t pin)
+    {
+        const uint32_t shift = (pin & 7) * 4;
+        gpio->AFR[pin >> 3] = (gpio->AFR[pin >> 3] & ~(0xFU << shift)) | ((uint32_t)Af << shift);
+    }
+
+    /**
+     * @brief  Clock the port and switch both pins to the UART: alternate
+     *         function, push-pull, pull-up, fast.
+     */
+    static void init()
+    {
+        RCC->AHB1ENR |= 1U << PORT_INDEX;
+        (void)RCC->AHB1ENR; // the port clock must be running before its registers are written
+        GPIO_TypeDef *gpio = peripheral<GPIO_TypeDef, Port>();
+        set_af(gpio, TX);
+        set_af(gpio, RX);
+        gpio->OTYPER &= ~(uint32_t)(TxPin | RxPin);
+        gpio->OSPEEDR = (gpio->OSPEEDR & ~both(3)) | both(2);
+        gpio->PUPDR = (gpio->PUPDR & ~both(3)) | both(1);
+        gpio->MODER = (gpio->MODER & ~both(3)) | both(2);
+    }
+};
+
+template <uintptr_t Instance, uint32_t Baud, typename Pins>
+class Uart
+{
+private:
+    static constexpr bool ON_APB2 = Instance == USART1_BASE || Instance == USART6_BASE;
+    static_assert(ON_APB2 || Instance == USART2_BASE, "Instance must be USART1_BASE, USART2_BASE or USART6_BASE");
+    static constexpr uint32_t CLOCK_HZ = ON_APB2 ? APB2_CLOCK_HZ : APB1_CLOCK_HZ;
+    static constexpr uint32_t CLOCK_ENABLE = Instance == USART1_BASE   ? RCC_APB2ENR_USART1EN
+                                             : Instance == USART6_BASE ? RCC_APB2ENR_USART6EN
+                                                                       : RCC_APB1ENR_USART2EN;
+    static constexpr uint32_t ERROR_FLAGS = USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE;
+
+    static USART_TypeDef *regs()
+    {
+        return peripheral<USART_TypeDef, Instance>();
+    }
+
+public:
+    /* 16x oversampling: BRR is the bus clock over the baud rate with four */
+    /* fraction bits, i.e. clock / baud rounded */
+    static constexpr uint32_t BRR = (CLOCK_HZ + Baud / 2) / Baud;
+    static_assert(BRR >= 16 && BRR <= 0xFFFF, "baud rate out of range for the bus clock");
+    static constexpr IRQn_Type IRQ = Instance == USART1_BASE   ? USART1_IRQn
+                                     : Instance == USART6_BASE ? USART6_IRQn
+                                                               : USART2_IRQn;
+
+    /**
+     * @brief  Pins, clock, 8N1 at Baud and the receive interrupt at the given
+     *         NVIC priority. The instance's IRQ handler must call receive().
+     */
+    static void init(uint32_t preempt_priority, uint32_t sub_priority)
+    {
+        Pins::init();
+        if (ON_APB2)
+        {
+            RCC->APB2ENR |= CLOCK_ENABLE;
+            (void)RCC->APB2ENR;
+        }
+        else
+        {
+            RCC->APB1ENR |= CLOCK_ENABLE;
+            (void)RCC->APB1ENR;
+        }
+        USART_TypeDef *usart = regs();
+        usart->CR1 = 0;
+        usart->CR2 = 0;
+        usart->CR3 = 0;
+        usart->BRR = BRR;
+        usart->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE;
+        NVIC_SetPriority(IRQ, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), preempt_priority, sub_priority));
+        NVIC_EnableIRQ(IRQ);
+    }
+
+    static void put(uint8_t c)
+    {
+        USART_TypeDef *usart = regs();
+        while ((usart->SR & USART_SR_TXE) == 0)
+        {
+        }
+        usart->DR = c;
+    }
+
+    static void write(const uint8_t *data, size_t size)
+    {
+        while (size-- > 0)
+            put(*data++);
+    }
+
+    /**
+     * @brief  Wait until the last byte has left the shift register, e.g.
+     *         before a reset or a change of baud rate.
+     */
+    static void flush()
+    {
+        while ((regs()->SR & USART_SR_TC) == 0)
+        {
+        }
+    }
+
+    /**
+     * @brief  Service the receive interrupt. Reading SR then DR takes the byte
+     *         and clears RXNE and the error flags in one go.
+     * @param  errors: set to the frame's errors as HAL_UART_ERROR_xxx bits
+     * @retval true if a byte was received; with an overrun, the bytes after
+     *         it were lost but this one is good
+     */
+    static bool receive(uint8_t *byte, uint32_t *errors)
+    {
+        USART_TypeDef *usart = regs();
+        const uint32_t sr = usart->SR;
+        *errors = ((sr & USART_SR_ORE) ? HAL_UART_ERROR_ORE : 0) | ((sr & USART_SR_FE) ? HAL_UART_ERROR_FE : 0) |
+                  ((sr & USART_SR_NE) ? HAL_UART_ERROR_NE : 0) | ((sr & USART_SR_PE) ? HAL_UART_ERROR_PE : 0);
+        if ((sr & (USART_SR_RXNE | ERROR_FLAGS)) == 0)
+            return false;
+        *byte = (uint8_t)usart->DR;
+        return (sr & USART_SR_RXNE) != 0;
+    }
+};
+
+#endif // UART_H
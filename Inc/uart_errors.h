@@ -0,0 +1,39 @@
+#ifndef UART_ERRORS_H
+#define UART_ERRORS_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t overrun;
+    uint32_t framing;
+    uint32_t noise;
+    uint32_t parity;
+    uint32_t rx_bytes;
+    uint32_t since_tick; // HAL tick when counting started
+} UartErrorCounts;
+
+/* CPU cost of the UART interrupt handlers, one byte per interrupt: the */
+/* console on the register-level driver, the replication link on the HAL */
+typedef enum
+{
+    UART_LINK_CONSOLE = 0,
+    UART_LINK_REPL,
+    UART_LINKS
+} UartLink;
+
+typedef struct
+{
+    uint32_t interrupts;
+    uint32_t cycles;     // all of them, wraps after ~40 s of interrupt time
+    uint32_t max_cycles;
+} UartIrqCost;
+
+void UART_Errors_Record(uint32_t error_code);
+void UART_Errors_CountByte(void);
+void UART_Errors_CountIrq(UartLink link, uint32_t cycles);
+void UART_Errors_Get(UartErrorCounts *counts);
+void UART_Errors_GetIrqCost(UartLink link, UartIrqCost *cost);
+void UART_Errors_Reset(void);
+
+#endif // UART_ERRORS_H
@@ -0,0 +1,47 @@
+#ifndef WARM_BOOT_H
+#define WARM_BOOT_H
+
+#include "main.h"
+#include "bank.h"
+
+/* The console bank lives in .noinit RAM behind a header and a CRC, so a */
+/* watchdog, software or reset-pin restart finds every account where it */
+/* was and resumes without reading the external memory back. The table is */
+/* only built fresh after power-on or brown-out, or when the header or the */
+/* CRC does not match. The CRC is renewed after every account change (see */
+/* AccountStore_Update()); a reset that lands between a change and its seal */
+/* counts as corruption and the external memory is used instead. */
+/* The bank is adopted byte for byte, so ConsoleBank must not own heap */
+/* memory (StaticStorage, LinearIndex; checked with Bank::uses_heap()); */
+/* the arena its names live in is retained and sealed along with it. */
+/* .noinit is a NOLOAD section of its own after .bss (stm32_noinit.ld), */
+/* which ram_report.py --check verifies in the map file after each link. */
+
+#define WARM_BOOT_MAGIC                 0x3A7B0071U
+
+typedef enum
+{
+    WARM_BOOT_COLD = 0, // power-on or brown-out: the table was built fresh
+    WARM_BOOT_WARM,     // the retained table was adopted as it was
+    WARM_BOOT_CORRUPT   // restart, but the header or CRC did not match
+} WarmBootKind;
+
+typedef struct
+{
+    WarmBootKind kind;
+    uint32_t accounts;      // accounts adopted by this boot
+    uint32_t warm_boots;    // since the last cold boot
+    uint32_t corrupt_boots; // since the last cold boot
+    uint32_t reset_flags;   // RCC->CSR at boot
+    uint32_t ready_ms;      // from reset to the first prompt
+} WarmBootStats;
+
+/* At boot, after CRC32_Init(): the retained bank, adopted or built fresh */
+ConsoleBank &WarmBoot_Attach(void);
+/* After every account change, so a reset finds the table consistent */
+void WarmBoot_Seal(void);
+/* Once the console is ready for input */
+void WarmBoot_Ready(void);
+void WarmBoot_GetStats(WarmBootStats *stats);
+
+#endif // WARM_BOOT_H
@@ -0,0 +1,224 @@
+#include "account_store.h"
+#include "crc32.h"
+#include "ext_mem.h"
+#include "trace.h"
+#include "warm_boot.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STORE_BYTES                     (MAX_ACCOUNTS * sizeof(AccountRecord))
+#define STORE_PAGES                     ((STORE_BYTES + EXT_MEM_PAGE_SIZE - 1) / EXT_MEM_PAGE_SIZE)
+#define NO_PAGE                         0xFFFFU
+
+static_assert(sizeof(AccountRecord) == 64, "record layout is part of the storage format");
+static_assert(EXT_MEM_PAGE_SIZE % sizeof(AccountRecord) == 0, "records must not straddle a page");
+static_assert(STORE_BYTES <= EXT_MEM_SIZE, "account table does not fit the external memory");
+static_assert(MAX_ACCOUNTS <= 0xFFFF, "records hold 16-bit account ids");
+
+static AccountRecord image[MAX_ACCOUNTS];     // what the device holds once clean
+static uint8_t tx_page[EXT_MEM_PAGE_SIZE];    // page being transferred
+static bool dirty[STORE_PAGES];
+static uint32_t dirty_since[STORE_PAGES];     // tick of the oldest change not yet written
+static uint16_t inflight = NO_PAGE;
+static uint32_t inflight_since;
+static uint16_t next_page;                    // round-robin start, so no page starves
+static AccountStoreStats stats;
+static LedgerDigest digest;                   // over image[], updated with it
+
+static uint32_t record_crc(const AccountRecord &record)
+{
+    return crc32_compute(&record, offsetof(AccountRecord, crc));
+}
+
+static void mark_dirty(uint16_t page, uint32_t since)
+{
+    if (!dirty[page])
+    {
+        dirty[page] = true;
+        dirty_since[page] = since;
+        stats.dirty_pages++;
+    }
+}
+
+#ifdef HOST_BUILD
+/* The host build exits when stdin closes; do not lose the last changes */
+static void flush_at_exit(void)
+{
+    AccountStore_Flush(1000);
+}
+#endif
+
+void AccountStore_Init(void)
+{
+    memset(dirty, 0, sizeof(dirty));
+    memset(&stats, 0, sizeof(stats));
+    inflight = NO_PAGE;
+    next_page = 0;
+    digest.clear();
+    ExtMem_Init();
+#ifdef HOST_BUILD
+    static bool registered = false;
+    if (!registered)
+        atexit(flush_at_exit);
+    registered = true;
+#endif
+}
+
+/**
+ * @brief  Read the table back from the device and restore every valid record
+ *         into the bank. Blank or corrupt slots stay free.
+ * @retval number of accounts restored
+ */
+uint16_t AccountStore_Load(ConsoleBank &bank)
+{
+    if (!ExtMem_Read(0, (uint8_t *)image, sizeof(image)))
+    {
+        memset(image, 0, sizeof(image));
+        return 0;
+    }
+
+    uint16_t restored = 0;
+    for (uint16_t i = 0; i < MAX_ACCOUNTS; i++)
+    {
+        const AccountRecord &record = image[i];
+        if (record.magic != ACCOUNT_RECORD_MAGIC || record.account_id != i || record.crc != record_crc(record))
+            continue;
+        if (bank.restore(record))
+        {
+            digest.update(i, record.crc);
+            restored++;
+        }
+    }
+    stats.restored = restored;
+    return restored;
+}
+
+/**
+ * @brief  Take over a bank retained in RAM across a warm reset instead of
+ *         loading it: the device is only read to compare, and the records
+ *         of accounts that changed after their last page write are queued
+ *         for write-back.
+ * @retval number of accounts adopted
+ */
+uint16_t AccountStore_Adopt(const ConsoleBank &bank)
+{
+    if (!ExtMem_Read(0, (uint8_t *)image, sizeof(image)))
+        memset(image, 0, sizeof(image));
+
+    uint16_t adopted = 0;
+    for (uint32_t i = 0; i < bank.slots(); i++)
+    {
+        if (!bank.in_use(i))
+            continue; // free slot below the highest id
+        AccountRecord record;
+        bank[i].to_record(&record);
+        record.crc = record_crc(record);
+        if (memcmp(&record, &image[i], sizeof(record)) != 0)
+        {
+            image[i] = record;
+            mark_dirty(i * sizeof(AccountRecord) / EXT_MEM_PAGE_SIZE, HAL_GetTick());
+        }
+        digest.update(i, record.crc);
+        adopted++;
+    }
+    stats.restored = adopted;
+    return adopted;
+}
+
+/**
+ * @brief  Queue the account's current state for write-back. Cheap enough to
+ *         call after every transaction: repeated changes to the records of
+ *         one page are written together.
+ */
+void AccountStore_Update(const BankAccount &account)
+{
+    uint32_t id = account.get_account_id();
+    if (id >= MAX_ACCOUNTS)
+        return;
+    account.to_record(&image[id]);
+    image[id].crc = record_crc(image[id]);
+    digest.update(id, image[id].crc);
+    mark_dirty(id * sizeof(AccountRecord) / EXT_MEM_PAGE_SIZE, HAL_GetTick());
+    stats.updates++;
+    WarmBoot_Seal();
+}
+
+/**
+ * @brief  Background write-back, called from the main loop while idle. Starts
+ *         at most one page transfer and never waits for the device.
+ */
+void AccountStore_Service(void)
+{
+    ExtMemState device = ExtMem_Poll();
+    if (device == EXT_MEM_BUSY)
+        return;
+    if (inflight != NO_PAGE)
+    {
+        if (device == EXT_MEM_ERROR)
+        {
+            stats.write_errors++;
+            mark_dirty(inflight, inflight_since);
+        }
+        else
+        {
+            uint32_t latency = HAL_GetTick() - inflight_since;
+            if (latency > stats.max_latency_ms)
+                stats.max_latency_ms = latency;
+            stats.page_writes++;
+        }
+        inflight = NO_PAGE;
+    }
+
+    if (stats.dirty_pages == 0)
+        return;
+    uint16_t page = next_page;
+    while (!dirty[page])
+        page = (page + 1) % STORE_PAGES;
+    next_page = (page + 1) % STORE_PAGES;
+
+    uint32_t addr = page * EXT_MEM_PAGE_SIZE;
+    uint32_t len = STORE_BYTES - addr < EXT_MEM_PAGE_SIZE ? STORE_BYTES - addr : EXT_MEM_PAGE_SIZE;
+    memcpy(tx_page, (const uint8_t *)image + addr, len);
+    dirty[page] = false;
+    stats.dirty_pages--;
+    if (!ExtMem_WriteStart(addr, tx_page, len))
+    {
+        stats.write_errors++;
+        mark_dirty(page, dirty_since[page]);
+        return;
+    }
+    TRACE_INSTANT(STORE_WRITE, page);
+    inflight = page;
+    inflight_since = dirty_since[page];
+    stats.bytes_written += len;
+}
+
+/**
+ * @brief  Write back everything that is pending.
+ * @retval false if the device did not become clean within timeout ms
+ */
+bool AccountStore_Flush(uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+    while (stats.dirty_pages > 0 || inflight != NO_PAGE)
+    {
+        if (HAL_GetTick() - start > timeout)
+            return false;
+        AccountStore_Service();
+    }
+    return true;
+}
+
+void AccountStore_GetStats(AccountStoreStats *out)
+{
+    *out = stats;
+}
+
+/**
+ * @brief  Digest of every account as last queued with AccountStore_Update()
+ */
+const LedgerDigest &AccountStore_GetDigest(void)
+{
+    return digest;
+}
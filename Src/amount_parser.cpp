@@ -0,0 +1,169 @@
+#include "amount_parser.h"
+#include <stdio.h>
+
+static_assert(AMOUNT_SCALE == 100, "AMOUNT_DECIMALS assumes cents");
+
+static int8_t hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+AmountParser::AmountParser()
+{
+    reset();
+}
+
+void AmountParser::reset()
+{
+    state = START;
+    error = AMOUNT_OK;
+    int_digits = 0;
+    decimals = 0;
+    id_digits = 0;
+    whole = 0;
+    fraction = 0;
+    id = 0;
+}
+
+void AmountParser::fail(AmountError e)
+{
+    if (error == AMOUNT_OK)
+        error = e;
+}
+
+/**
+ * @brief  Consume one character of the amount line (without the line end).
+ */
+void AmountParser::feed(uint8_t c)
+{
+    if (error != AMOUNT_OK)
+        return;
+    bool digit = c >= '0' && c <= '9';
+
+    switch (state)
+    {
+    case START:
+        if (c == '+')
+        {
+            state = INTEGER;
+            return;
+        }
+        if (c == '-')
+            return fail(AMOUNT_NEGATIVE);
+        state = INTEGER;
+        /* fall through */
+    case INTEGER:
+        if (digit)
+        {
+            if (++int_digits > AMOUNT_INT_DIGITS)
+                return fail(AMOUNT_TOO_MANY_DIGITS);
+            whole = whole * 10 + (c - '0');
+        }
+        else if (c == '.' && int_digits > 0)
+            state = POINT;
+        else if (c == '#' && int_digits > 0)
+            state = REQUEST_ID;
+        else
+            fail(AMOUNT_BAD_FORMAT);
+        return;
+    case POINT:
+    case FRACTION:
+        if (digit)
+        {
+            if (++decimals > AMOUNT_DECIMALS)
+                return fail(AMOUNT_TOO_MANY_DECIMALS);
+            fraction = fraction * 10 + (c - '0');
+            state = FRACTION;
+        }
+        else if (c == '#' && state == FRACTION)
+            state = REQUEST_ID;
+        else
+            fail(AMOUNT_BAD_FORMAT);
+        return;
+    case REQUEST_ID:
+        if (hex_value(c) < 0 || ++id_digits > 8)
+            return fail(AMOUNT_BAD_REQUEST_ID);
+        id = (id << 4) | (uint32_t)hex_value(c);
+        return;
+    }
+}
+
+/**
+ * @brief  End of line: validate and convert to exact minor units.
+ * @param  request_id: set to the '#' suffix, 0 if there is none; may be nullptr
+ * @retval AMOUNT_OK, or the first problem found in the line
+ */
+AmountError AmountParser::finish(amount_t *amount, uint32_t *request_id)
+{
+    if (error == AMOUNT_OK)
+    {
+        if (state == START)
+            error = AMOUNT_EMPTY;
+        else if (int_digits == 0 || state == POINT)
+            error = AMOUNT_BAD_FORMAT;
+        else if (state == REQUEST_ID && id_digits == 0)
+            error = AMOUNT_BAD_REQUEST_ID;
+    }
+    if (error != AMOUNT_OK)
+        return error;
+
+    uint32_t cents = decimals == 1 ? fraction * 10 : fraction;
+    uint64_t minor = (uint64_t)whole * AMOUNT_SCALE + cents;
+    if (minor == 0 || minor > INT32_MAX)
+        return AMOUNT_OUT_OF_RANGE;
+    *amount = (amount_t)minor;
+    if (request_id != nullptr)
+        *request_id = id;
+    return AMOUNT_OK;
+}
+
+/**
+ * @brief  Parse an amount held in memory, e.g. a line from a socket.
+ */
+AmountError parse_amount(const uint8_t *text, size_t len, amount_t *amount, uint32_t *request_id)
+{
+    AmountParser parser;
+    for (size_t i = 0; i < len && text[i] != 0; i++)
+        parser.feed(text[i]);
+    return parser.finish(amount, request_id);
+}
+
+const char *amount_error_text(AmountError error)
+{
+    switch (error)
+    {
+    case AMOUNT_OK:
+        return "ok";
+    case AMOUNT_EMPTY:
+        return "no amount given";
+    case AMOUNT_NEGATIVE:
+        return "amount must not be negative";
+    case AMOUNT_BAD_FORMAT:
+        return "use digits with an optional '.' and up to 2 decimals";
+    case AMOUNT_TOO_MANY_DIGITS:
+        return "too many digits";
+    case AMOUNT_TOO_MANY_DECIMALS:
+        return "at most 2 decimals";
+    case AMOUNT_OUT_OF_RANGE:
+        return "amount out of range";
+    case AMOUNT_BAD_REQUEST_ID:
+        return "request id must be 1 to 8 hex digits";
+    }
+    return "invalid amount";
+}
+
+/**
+ * @brief  Print minor units exactly, e.g. 2505 as "25.05", without floating point.
+ */
+void format_amount(char *buf, size_t size, int64_t minor)
+{
+    uint64_t magnitude = minor < 0 ? 0 - (uint64_t)minor : (uint64_t)minor;
+    snprintf(buf, size, "%s%lu.%02u", minor < 0 ? "-" : "", (unsigned long)(magnitude / AMOUNT_SCALE),
+             (unsigned)(magnitude % AMOUNT_SCALE));
+}
@@ -1,59 +1,314 @@
 #include "bank_account.h"
 #include "etl/string.h"
+#include <string.h>
 
-uint16_t BankAccount::total_accounts = 0;
+std::atomic<uint32_t> BankAccount::total_accounts(0);
+SeqLock BankAccount::ledger_seq[SEQLOCK_STRIPES];
 
 BankAccount::BankAccount()
-    : account_id(0), account_balance(0.0)
+    : account_id(0), account_name(NAME_EMPTY), account_balance(0), hot(nullptr)
 {
-    memset(account_name, 0, NAMESIZE);
     memset(account_password, 0,PASSWORDSIZE);
 }
 
+/**
+ * @brief  name is up to NAME_LEN_MAX bytes, 0-terminated if shorter; it is stored
+ *         in Names(), and the account is nameless if the arena is full.
+ */
 BankAccount::BankAccount(const uint8_t *name, const uint8_t *password)
-    : account_id(total_accounts++), account_balance(0.0)
+    : account_id(total_accounts.fetch_add(1, std::memory_order_relaxed)),
+      account_name(Names().add(name, strnlen((const char *)name, NAME_LEN_MAX))), account_balance(0), hot(nullptr)
 {
-    memcpy(account_name, name, NAMESIZE);
     memcpy(account_password, password,PASSWORDSIZE);
 }
 
-uint16_t BankAccount::get_account_id() const
+/**
+ * @brief  Account with an id chosen by the caller, e.g. its slot in a Bank.
+ *         Ids handed out by the other constructor continue after it.
+ */
+BankAccount::BankAccount(uint32_t id, const uint8_t *name, const uint8_t *password)
+    : BankAccount(id, Names().add(name, strnlen((const char *)name, NAME_LEN_MAX)), password)
+{
+}
+
+/**
+ * @brief  As above, taking over a name already added to Names().
+ */
+BankAccount::BankAccount(uint32_t id, NameHandle name, const uint8_t *password)
+    : account_id(id), account_name(name), account_balance(0), hot(nullptr)
+{
+    memcpy(account_password, password, PASSWORDSIZE);
+    reserve_id(id);
+}
+
+/* Copies share the name: releasing it is up to whoever owns the original */
+BankAccount::BankAccount(const BankAccount &other)
+    : account_id(other.account_id), account_name(other.account_name), account_balance(other.get_account_balance()),
+      hot(nullptr)
+{
+    memcpy(account_password, other.account_password, PASSWORDSIZE);
+}
+
+BankAccount &BankAccount::operator=(const BankAccount &other)
+{
+    SeqLock &old_seq = seq();
+    old_seq.write_begin();
+    account_id = other.account_id;
+    account_name = other.account_name;
+    memcpy(account_password, other.account_password, PASSWORDSIZE);
+    seq().write_begin();
+    account_balance.store(other.get_account_balance(), std::memory_order_release);
+    clear_slices();
+    seq().write_end();
+    old_seq.write_end();
+    return *this;
+}
+
+/**
+ * @brief  Serialize the account for external storage; the CRC is left to the caller.
+ */
+void BankAccount::to_record(AccountRecord *record) const
+{
+    memset(record, 0, sizeof(*record));
+    record->magic = ACCOUNT_RECORD_MAGIC;
+    record->account_id = (uint16_t)account_id;
+    memcpy(record->name, Names().text(account_name), Names().length(account_name)); // at most NAME_LEN_MAX
+    memcpy(record->password, account_password, PASSWORDSIZE);
+    record->balance = get_account_balance();
+}
+
+/**
+ * @brief  Restore an account saved with to_record(). Ids handed out to new
+ *         accounts continue after the highest restored id. The name is kept
+ *         if it is unchanged, otherwise the old one is released.
+ */
+void BankAccount::from_record(const AccountRecord &record)
+{
+    uint32_t length = strnlen((const char *)record.name, NAME_LEN_MAX);
+    if (!has_name(record.name, length, NameArena::hash(record.name, length)))
+    {
+        release_name(); // before add(), which may compact
+        account_name = Names().add(record.name, length);
+    }
+
+    SeqLock &old_seq = seq();
+    old_seq.write_begin();
+    account_id = record.account_id;
+    memcpy(account_password, record.password, PASSWORDSIZE);
+    seq().write_begin();
+    account_balance.store(record.balance, std::memory_order_release);
+    clear_slices();
+    seq().write_end();
+    old_seq.write_end();
+
+    reserve_id(record.account_id);
+}
+
+void BankAccount::reserve_id(uint32_t id)
+{
+    uint32_t total = total_accounts.load(std::memory_order_relaxed);
+    while (total <= id && !total_accounts.compare_exchange_weak(total, id + 1, std::memory_order_relaxed))
+    {
+    }
+}
+
+SeqLock &BankAccount::seq() const
+{
+    return ledger_seq[account_id % SEQLOCK_STRIPES];
+}
+
+uint32_t BankAccount::get_account_id() const
 {
     return account_id;
 }
 
 bool BankAccount::verify_account_name(uint8_t *name) const
 {
-    if (memcmp(account_name, name, NAMESIZE) != 0)
+    uint32_t length = strnlen((const char *)name, NAME_LEN_MAX);
+    return has_name(name, length, NameArena::hash(name, length));
+}
+
+/**
+ * @brief  Compare the name with one whose NameArena::hash() is known.
+ */
+bool BankAccount::has_name(const uint8_t *name, uint32_t length, NameHash hash) const
+{
+    return Names().equals(account_name, name, length, hash);
+}
+
+/**
+ * @brief  The name, 0-terminated; valid until the next compaction of Names().
+ */
+const uint8_t *BankAccount::get_account_name() const
+{
+    return Names().text(account_name);
+}
+
+uint32_t BankAccount::get_account_name_length() const
+{
+    return Names().length(account_name);
+}
+
+void BankAccount::release_name()
+{
+    Names().release(account_name);
+    account_name = NAME_EMPTY;
+}
+
+/**
+ * @brief  Balance of the account; of a hot one, the folded balance plus its
+ *         slices, read again if a fold moved credit between them meanwhile.
+ */
+amount_t BankAccount::get_account_balance() const
+{
+    if (hot == nullptr)
+        return account_balance.load(std::memory_order_acquire);
+    int64_t balance = 0;
+    uint32_t start = 0;
+    do
     {
+        start = seq().read_begin();
+        balance = account_balance.load(std::memory_order_acquire);
+        for (const HotSlices::Slice &slice : hot->slice)
+            balance += slice.credit.load(std::memory_order_acquire);
+    } while (seq().read_retry(start));
+    return balance > INT32_MAX ? INT32_MAX : (amount_t)balance;
+}
+
+/**
+ * @brief  Let deposits to this account go to per-thread slices instead of all
+ *         contending for the balance. Only while no other thread uses it, e.g.
+ *         while setting up a bank; slices must outlive the account's hot use.
+ *         nullptr folds the slices and makes the account a normal one again.
+ */
+void BankAccount::make_hot(HotSlices *slices)
+{
+    seq().write_begin();
+    fold_all();
+    hot = slices;
+    clear_slices();
+    seq().write_end();
+}
+
+bool BankAccount::is_hot() const
+{
+    return hot != nullptr;
+}
+
+/* Slice of the calling thread: threads are dealt slices round robin */
+static uint32_t slice_index()
+{
+#if HOT_SLICES > 1
+    static std::atomic<uint32_t> next(0);
+    static thread_local uint32_t index = next.fetch_add(1, std::memory_order_relaxed) % HOT_SLICES;
+    return index;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief  Deposit into the calling thread's slice of a hot account. Slices hold
+ *         at most HOT_SLICE_MAX and only take credit while the folded balance
+ *         is at most HOT_BALANCE_MAX, so the merged balance cannot overflow.
+ * @retval false if the deposit has to take the exact path instead
+ */
+bool BankAccount::deposit_slice(amount_t amount)
+{
+    if (amount > HOT_SLICE_MAX || account_balance.load(std::memory_order_relaxed) > HOT_BALANCE_MAX)
         return false;
-    }
+    std::atomic<amount_t> &credit = hot->slice[slice_index()].credit;
+    amount_t held = credit.load(std::memory_order_relaxed);
+    do
+    {
+        if (held > HOT_SLICE_MAX - amount)
+            return false;
+    } while (!credit.compare_exchange_weak(held, held + amount, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
     return true;
 }
 
-const uint8_t *BankAccount::get_account_name() const
+/* Move one slice's credit into the balance; call inside a write section */
+void BankAccount::fold(HotSlices::Slice &slice)
 {
-    return account_name;
+    amount_t credit = slice.credit.exchange(0, std::memory_order_acq_rel);
+    if (credit != 0)
+        account_balance.fetch_add(credit, std::memory_order_acq_rel);
 }
 
-double BankAccount::get_account_balance() const
+void BankAccount::fold_all()
 {
-    return account_balance;
+    if (hot == nullptr)
+        return;
+    for (HotSlices::Slice &slice : hot->slice)
+        fold(slice);
 }
 
-void BankAccount::deposit(double amount)
+void BankAccount::clear_slices()
 {
-    account_balance += amount;
+    if (hot == nullptr)
+        return;
+    for (HotSlices::Slice &slice : hot->slice)
+        slice.credit.store(0, std::memory_order_release);
 }
 
-bool BankAccount::withdraw(double amount)
+/**
+ * @brief  Add amount to the balance. Lock-free, safe from any thread or ISR.
+ *         A hot account takes it into the caller's slice where there is room;
+ *         otherwise the slices are folded first, and its balance is capped at
+ *         HOT_BALANCE_MAX.
+ * @retval false if the amount is negative or the balance would overflow
+ */
+bool BankAccount::deposit(amount_t amount)
 {
-    if (account_balance >= amount)
-    {
-        account_balance -= amount;
+    if (amount < 0)
+        return false;
+    if (hot != nullptr && deposit_slice(amount))
         return true;
-    }
-    return false;
+    const amount_t limit = hot != nullptr ? HOT_BALANCE_MAX : INT32_MAX;
+    bool ok = true;
+    seq().write_begin();
+    fold_all();
+    amount_t balance = account_balance.load(std::memory_order_relaxed);
+    do
+    {
+        if (balance > limit - amount)
+        {
+            ok = false;
+            break;
+        }
+    } while (!account_balance.compare_exchange_weak(balance, balance + amount,
+                                                    std::memory_order_acq_rel, std::memory_order_relaxed));
+    seq().write_end();
+    return ok;
+}
+
+/**
+ * @brief  Take amount from the balance if it is covered. The check and the update
+ *         are one compare-and-swap, so concurrent callers can never overdraw.
+ *         A hot account folds its slices in first; as slices only ever hold
+ *         credit, the folded balance never exceeds the true one.
+ * @retval false if the amount is negative or the balance is insufficient
+ */
+bool BankAccount::withdraw(amount_t amount)
+{
+    if (amount < 0)
+        return false;
+    bool ok = true;
+    seq().write_begin();
+    fold_all();
+    amount_t balance = account_balance.load(std::memory_order_relaxed);
+    do
+    {
+        if (balance < amount)
+        {
+            ok = false;
+            break;
+        }
+    } while (!account_balance.compare_exchange_weak(balance, balance - amount,
+                                                    std::memory_order_acq_rel, std::memory_order_relaxed));
+    seq().write_end();
+    return ok;
 }
 
 void BankAccount::set_password(const uint8_t *password)
@@ -70,7 +325,41 @@ bool BankAccount::verify_password(const uint8_t *password) const
     return false;
 }
 
-uint16_t BankAccount::get_total_accounts()
+uint32_t BankAccount::get_total_accounts()
+{
+    return total_accounts.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Move amount between two accounts as one write, so consistent readers
+ *         never see it taken from one account and not yet added to the other.
+ * @retval false if 'from' cannot cover the amount or 'to' would overflow
+ */
+bool BankAccount::transfer(BankAccount &from, BankAccount &to, amount_t amount)
+{
+    from.seq().write_begin();
+    to.seq().write_begin();
+    bool ok = from.withdraw(amount);
+    if (ok && !to.deposit(amount))
+    {
+        from.deposit(amount); // refund
+        ok = false;
+    }
+    to.seq().write_end();
+    from.seq().write_end();
+    return ok;
+}
+
+/**
+ * @brief  Sum of all balances at a single point in time.
+ */
+int64_t BankAccount::total_balance(const BankAccount *accounts, size_t count)
 {
-    return total_accounts;
+    int64_t total = 0;
+    read_consistent([&]() {
+        total = 0;
+        for (size_t i = 0; i < count; i++)
+            total += accounts[i].get_account_balance();
+    });
+    return total;
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+/* Portable slice-by-8 CRC-32 matching the STM32 CRC unit bit for bit. */
+/* Eight 256-entry tables let one step consume two words with eight lookups */
+/* instead of 64 shift/XOR rounds. */
+
+#include "crc32.h"
+#include <array>
+#include <string.h>
+
+typedef std::array<std::array<uint32_t, 256>, 8> Crc32Tables;
+
+/* tables[k][b]: CRC contribution of byte b followed by k zero bytes */
+static constexpr Crc32Tables make_tables()
+{
+    Crc32Tables tables{};
+    for (uint32_t b = 0; b < 256; b++)
+    {
+        uint32_t crc = b << 24;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80000000U) ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+        tables[0][b] = crc;
+    }
+    for (uint32_t k = 1; k < 8; k++)
+        for (uint32_t b = 0; b < 256; b++)
+            tables[k][b] = (tables[k - 1][b] << 8) ^ tables[0][tables[k - 1][b] >> 24];
+    return tables;
+}
+
+static constexpr Crc32Tables tables = make_tables();
+
+static inline uint32_t load_word(const uint8_t *p)
+{
+    uint32_t word;
+    memcpy(&word, p, sizeof(word)); // unaligned-safe, a single load where allowed
+    return word;
+}
+
+static inline uint32_t crc32_word(uint32_t crc, uint32_t word)
+{
+    crc ^= word;
+    return tables[3][crc >> 24] ^ tables[2][(crc >> 16) & 0xFF] ^
+           tables[1][(crc >> 8) & 0xFF] ^ tables[0][crc & 0xFF];
+}
+
+/**
+ * @brief  Software CRC-32, same result as crc32_compute() on target.
+ */
+uint32_t crc32_sw(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t crc = CRC32_INITIAL;
+
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        uint32_t one = crc ^ load_word(p);
+        uint32_t two = load_word(p + 4);
+        crc = tables[7][one >> 24] ^ tables[6][(one >> 16) & 0xFF] ^
+              tables[5][(one >> 8) & 0xFF] ^ tables[4][one & 0xFF] ^
+              tables[3][two >> 24] ^ tables[2][(two >> 16) & 0xFF] ^
+              tables[1][(two >> 8) & 0xFF] ^ tables[0][two & 0xFF];
+    }
+    if (len >= 4)
+    {
+        crc = crc32_word(crc, load_word(p));
+        p += 4;
+        len -= 4;
+    }
+    if (len > 0)
+    {
+        uint8_t tail[4] = {0};
+        memcpy(tail, p, len);
+        crc = crc32_word(crc, load_word(tail));
+    }
+    return crc;
+}
@@ -0,0 +1,20 @@
+#include "main.h"
+#include "cycle_counter.h"
+
+/**
+ * @brief  Enable the DWT cycle counter. Safe to call more than once.
+ */
+void CycleCounter_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0)
+  {
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+}
+
+uint32_t CycleCounter_Read(void)
+{
+  return DWT->CYCCNT;
+}
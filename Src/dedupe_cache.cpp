@@ -0,0 +1,139 @@
+#include "dedupe_cache.h"
+#include <string.h>
+
+static_assert((DEDUPE_CACHE_BUCKETS & (DEDUPE_CACHE_BUCKETS - 1)) == 0, "bucket count must be a power of two");
+static_assert(DEDUPE_CACHE_SIZE < 0xFFFF, "entry indices are 16-bit");
+
+DedupeCache::DedupeCache()
+{
+    clear();
+}
+
+void DedupeCache::clear()
+{
+    for (uint16_t i = 0; i < DEDUPE_CACHE_BUCKETS; i++)
+        buckets[i] = NONE;
+    lru_head = NONE;
+    lru_tail = NONE;
+    used = 0;
+}
+
+uint32_t DedupeCache::bucket_of(uint8_t op, uint16_t account_id, uint32_t request_id)
+{
+    uint32_t h = request_id ^ ((uint32_t)account_id << 16) ^ op;
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return h & (DEDUPE_CACHE_BUCKETS - 1);
+}
+
+void DedupeCache::unlink(uint16_t idx)
+{
+    Entry &e = entries[idx];
+    if (e.prev != NONE)
+        entries[e.prev].next = e.next;
+    else
+        lru_head = e.next;
+    if (e.next != NONE)
+        entries[e.next].prev = e.prev;
+    else
+        lru_tail = e.prev;
+}
+
+void DedupeCache::push_front(uint16_t idx)
+{
+    Entry &e = entries[idx];
+    e.prev = NONE;
+    e.next = lru_head;
+    if (lru_head != NONE)
+        entries[lru_head].prev = idx;
+    lru_head = idx;
+    if (lru_tail == NONE)
+        lru_tail = idx;
+}
+
+void DedupeCache::remove_from_bucket(uint16_t idx)
+{
+    Entry &e = entries[idx];
+    uint16_t *link = &buckets[bucket_of(e.op, e.account_id, e.request_id)];
+    while (*link != idx)
+        link = &entries[*link].chain;
+    *link = e.chain;
+}
+
+/**
+ * @brief  Look up a request and mark it most recently used.
+ * @retval the stored result, or nullptr if the request id has not been seen
+ */
+const DedupeResult *DedupeCache::find(uint8_t op, uint16_t account_id, uint32_t request_id)
+{
+    for (uint16_t idx = buckets[bucket_of(op, account_id, request_id)]; idx != NONE; idx = entries[idx].chain)
+    {
+        Entry &e = entries[idx];
+        if (e.request_id == request_id && e.account_id == account_id && e.op == op)
+        {
+            unlink(idx);
+            push_front(idx);
+            return &e.result;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief  Remember the result of an applied request, evicting the least
+ *         recently used entry when the cache is full.
+ */
+void DedupeCache::insert(uint8_t op, uint16_t account_id, uint32_t request_id, const DedupeResult &result)
+{
+    uint16_t idx;
+    if (used < DEDUPE_CACHE_SIZE)
+        idx = used++;
+    else
+    {
+        idx = lru_tail;
+        unlink(idx);
+        remove_from_bucket(idx);
+    }
+
+    Entry &e = entries[idx];
+    e.request_id = request_id;
+    e.account_id = account_id;
+    e.op = op;
+    e.result = result;
+    uint16_t &bucket = buckets[bucket_of(op, account_id, request_id)];
+    e.chain = bucket;
+    bucket = idx;
+    push_front(idx);
+}
+
+/**
+ * @brief  Split an optional "#<hex id>" suffix off a console input line.
+ *         The suffix is removed from buf.
+ * @retval the request id, 0 if there is none or it is malformed
+ */
+uint32_t split_request_id(uint8_t *buf, uint32_t buf_size)
+{
+    uint8_t *mark = (uint8_t *)memchr(buf, '#', buf_size);
+    if (mark == nullptr)
+        return 0;
+
+    uint32_t id = 0;
+    uint32_t digits = 0;
+    for (uint8_t *p = mark + 1; p < buf + buf_size && *p != 0; p++, digits++)
+    {
+        uint8_t c = *p;
+        uint32_t v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            return 0;
+        id = (id << 4) | v;
+    }
+    memset(mark, 0, buf + buf_size - mark);
+    return digits > 0 && digits <= 8 ? id : 0;
+}
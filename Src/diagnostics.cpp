@@ -0,0 +1,332 @@
+/* Diagnostics menu - runtime status of the firmware over the same UART console. */
+
+#include "diagnostics.h"
+#include "account_store.h"
+#include "amount_parser.h"
+#include "crc32.h"
+#include "name_arena.h"
+#include "cycle_counter.h"
+#include "profiler.h"
+#include "replication.h"
+#include "stack_monitor.h"
+#include "trace.h"
+#include "uart_errors.h"
+#include "warm_boot.h"
+#include <stdio.h>
+
+/* CRC throughput is measured over the start of flash, so no RAM buffer is needed */
+#ifdef HOST_BUILD
+static const uint8_t crc_bench_data[16384] = {0};
+#define CRC_BENCH_DATA                  ((const void *)crc_bench_data)
+#else
+#define CRC_BENCH_DATA                  ((const void *)FLASH_BASE)
+#endif
+#define CRC_BENCH_SIZE                  16384U
+
+static const char *const fault_names[] = {"", "HardFault", "MemManage", "BusFault", "UsageFault"};
+
+static void report_stack(void)
+{
+  char msg[100] = {0};
+  sprintf(msg, "\r\nStack high-water mark: %lu of %lu bytes (reserved %lu)",
+          (unsigned long)Stack_GetHighWaterMark(), (unsigned long)Stack_GetSize(),
+          (unsigned long)Stack_GetReserved());
+  UART_SendString(msg);
+}
+
+static void report_last_fault(void)
+{
+  const FaultRecord *record = Fault_GetLastRecord();
+  if (record == nullptr)
+  {
+    UART_SendString("\r\nNo fault recorded.");
+    return;
+  }
+
+  char msg[100] = {0};
+  const char *name = record->fault_type < COUNTOF(fault_names) ? fault_names[record->fault_type] : "Unknown";
+  sprintf(msg, "\r\nLast fault: %s on %s%s", name,
+          record->stack == FAULT_STACK_PSP ? "PSP" : "MSP",
+          record->overflowed ? " (stack overflow)" : "");
+  UART_SendString(msg);
+  sprintf(msg, "\r\nSP=0x%08lx PC=0x%08lx LR=0x%08lx CFSR=0x%08lx HFSR=0x%08lx",
+          (unsigned long)record->sp, (unsigned long)record->pc, (unsigned long)record->lr,
+          (unsigned long)record->cfsr, (unsigned long)record->hfsr);
+  UART_SendString(msg);
+}
+
+static void report_total(const ConsoleBank &bank)
+{
+  char msg[60] = {0};
+  char text[24] = {0};
+  format_amount(text, sizeof(text), bank.total_balance());
+  sprintf(msg, "\r\nTotal balance: %s", text);
+  UART_SendString(msg);
+}
+
+static void report_crc_throughput(void)
+{
+  char msg[100] = {0};
+  CycleCounter_Init();
+
+  uint32_t start = CycleCounter_Read();
+  uint32_t sw = crc32_sw(CRC_BENCH_DATA, CRC_BENCH_SIZE);
+  uint32_t sw_cycles = CycleCounter_Read() - start;
+
+  start = CycleCounter_Read();
+  uint32_t hw = crc32_compute(CRC_BENCH_DATA, CRC_BENCH_SIZE);
+  uint32_t hw_cycles = CycleCounter_Read() - start;
+
+  sprintf(msg, "\r\nCRC-32 of %u bytes: 0x%08lx %s", CRC_BENCH_SIZE, (unsigned long)hw, hw == sw ? "(match)" : "(MISMATCH)");
+  UART_SendString(msg);
+  uint32_t sw_milli = sw_cycles ? CRC_BENCH_SIZE * 1000U / sw_cycles : 0;
+  uint32_t hw_milli = hw_cycles ? CRC_BENCH_SIZE * 1000U / hw_cycles : 0;
+  sprintf(msg, "\r\nSoftware: %lu cycles, %lu.%03lu bytes/cycle", (unsigned long)sw_cycles,
+          (unsigned long)(sw_milli / 1000U), (unsigned long)(sw_milli % 1000U));
+  UART_SendString(msg);
+  sprintf(msg, "\r\nCRC unit: %lu cycles, %lu.%03lu bytes/cycle", (unsigned long)hw_cycles,
+          (unsigned long)(hw_milli / 1000U), (unsigned long)(hw_milli % 1000U));
+  UART_SendString(msg);
+}
+
+static void report_uart_errors(void)
+{
+  char msg[100] = {0};
+  char per_bytes[16] = {0}, per_minute[16] = {0};
+  UartErrorCounts counts;
+  UART_Errors_Get(&counts);
+
+  /* Rates in hundredths, printed like amounts, so no float printf is linked */
+  uint32_t errors = counts.overrun + counts.framing + counts.noise + counts.parity;
+  uint32_t elapsed = HAL_GetTick() - counts.since_tick;
+  sprintf(msg, "\r\nUART errors: %lu overrun, %lu framing, %lu noise, %lu parity",
+          (unsigned long)counts.overrun, (unsigned long)counts.framing,
+          (unsigned long)counts.noise, (unsigned long)counts.parity);
+  UART_SendString(msg);
+  format_amount(per_bytes, sizeof(per_bytes), counts.rx_bytes ? 1000000LL * errors / counts.rx_bytes : 0);
+  format_amount(per_minute, sizeof(per_minute), elapsed ? 6000000LL * errors / elapsed : 0);
+  sprintf(msg, "\r\n%lu bytes received, %s errors per 10k bytes, %s errors per minute",
+          (unsigned long)counts.rx_bytes, per_bytes, per_minute);
+  UART_SendString(msg);
+
+  static const char *const link_names[UART_LINKS] = {"Console (registers)", "Replication (HAL)"};
+  for (int link = 0; link < UART_LINKS; link++)
+  {
+    UartIrqCost cost;
+    UART_Errors_GetIrqCost((UartLink)link, &cost);
+    sprintf(msg, "\r\n%s: %lu interrupts, %lu cycles/byte average, %lu max", link_names[link],
+            (unsigned long)cost.interrupts, (unsigned long)(cost.interrupts ? cost.cycles / cost.interrupts : 0),
+            (unsigned long)cost.max_cycles);
+    UART_SendString(msg);
+  }
+}
+
+/* Rehash the live accounts and compare with the digest kept as they */
+/* changed; a difference means an account was modified outside a deposit, */
+/* withdrawal or create (bad write, stray pointer, bit flip). */
+static void report_audit(const ConsoleBank &bank)
+{
+  char msg[100] = {0};
+  const LedgerDigest &digest = AccountStore_GetDigest();
+  LedgerDigest live;
+  for (uint32_t i = 0; i < bank.slots(); i++)
+    if (bank.in_use(i))
+      live.update(bank[i]);
+
+  sprintf(msg, "\r\nLedger digest: 0x%08lx over %lu accounts", (unsigned long)digest.root(), (unsigned long)bank.size());
+  UART_SendString(msg);
+  uint32_t bad = digest.find_mismatch(live);
+  if (bad == LedgerDigest::NO_MISMATCH)
+    UART_SendString("\r\nAudit passed: every account matches the digest.");
+  else
+  {
+    sprintf(msg, "\r\nAudit FAILED: account %lu does not match the digest (0x%08lx, now 0x%08lx).",
+            (unsigned long)bad, (unsigned long)digest.leaf(bad), (unsigned long)live.leaf(bad));
+    UART_SendString(msg);
+  }
+}
+
+static void report_replication(void)
+{
+  static const char *const roles[] = {"none (no link)", "primary", "backup"};
+  char msg[128] = {0};
+  char rate[16] = {0};
+  ReplicationStats stats;
+  Replication_GetStats(&stats);
+  ReplRole role = Replication_Role();
+
+  snprintf(msg, sizeof(msg), "\r\nReplication: %s, %lu bad frames", roles[role], (unsigned long)stats.bad_frames);
+  UART_SendString(msg);
+  if (role == REPL_ROLE_PRIMARY)
+  {
+    uint32_t elapsed = HAL_GetTick() - stats.start_tick;
+    snprintf(msg, sizeof(msg), "\r\nSeq %lu, acked %lu, lag %lu records / %lu ms (max %lu ms)",
+             (unsigned long)stats.next_seq, (unsigned long)stats.acked_seq,
+             (unsigned long)(stats.next_seq - stats.acked_seq), (unsigned long)stats.lag_ms,
+             (unsigned long)stats.max_lag_ms);
+    UART_SendString(msg);
+    format_amount(rate, sizeof(rate), elapsed ? 100000LL * stats.acked_records / elapsed : 0);
+    snprintf(msg, sizeof(msg), "\r\n%s records/s acked, %lu frames sent, %lu retransmits, %lu resyncs",
+             rate, (unsigned long)stats.frames_sent,
+             (unsigned long)stats.retransmits, (unsigned long)stats.resyncs);
+    UART_SendString(msg);
+  }
+  else if (role == REPL_ROLE_BACKUP)
+  {
+    snprintf(msg, sizeof(msg), "\r\nExpecting seq %lu, %lu applied, %lu duplicates, %lu gaps, last frame %lu ms ago",
+             (unsigned long)stats.acked_seq, (unsigned long)stats.applied, (unsigned long)stats.duplicates,
+             (unsigned long)stats.gaps, (unsigned long)(HAL_GetTick() - stats.last_rx_tick));
+    UART_SendString(msg);
+  }
+}
+
+static void report_storage(void)
+{
+  char msg[100] = {0};
+  AccountStoreStats stats;
+  AccountStore_GetStats(&stats);
+
+  sprintf(msg, "\r\nStorage: %lu restored, %lu updates, %lu pages pending",
+          (unsigned long)stats.restored, (unsigned long)stats.updates, (unsigned long)stats.dirty_pages);
+  UART_SendString(msg);
+  sprintf(msg, "\r\n%lu page writes, %lu bytes, %lu errors, worst write-back %lu ms",
+          (unsigned long)stats.page_writes, (unsigned long)stats.bytes_written,
+          (unsigned long)stats.write_errors, (unsigned long)stats.max_latency_ms);
+  UART_SendString(msg);
+
+  static const char *const kinds[] = {"cold", "warm", "corrupt"};
+  WarmBootStats boot;
+  WarmBoot_GetStats(&boot);
+  sprintf(msg, "\r\nBoot: %s, %lu accounts adopted, ready in %lu ms", kinds[boot.kind],
+          (unsigned long)boot.accounts, (unsigned long)boot.ready_ms);
+  UART_SendString(msg);
+  sprintf(msg, "\r\n%lu warm and %lu corrupt restarts since power-on, reset flags %08lx",
+          (unsigned long)boot.warm_boots, (unsigned long)boot.corrupt_boots, (unsigned long)boot.reset_flags);
+  UART_SendString(msg);
+}
+
+static void report_names(void)
+{
+  char msg[128] = {0};
+  NameArenaStats stats;
+  Names().get_stats(&stats);
+  uint32_t live_bytes = stats.used - stats.dead_bytes;
+
+  sprintf(msg, "\r\nNames: %lu live in %lu bytes, %lu released in %lu bytes, %lu of %lu bytes used",
+          (unsigned long)stats.names, (unsigned long)live_bytes, (unsigned long)stats.dead_names,
+          (unsigned long)stats.dead_bytes, (unsigned long)stats.used, (unsigned long)stats.capacity);
+  UART_SendString(msg);
+  sprintf(msg, "\r\nFragmentation %lu%%, %lu compactions reclaimed %lu bytes, %lu names did not fit",
+          (unsigned long)(stats.used ? 100U * stats.dead_bytes / stats.used : 0), (unsigned long)stats.compactions,
+          (unsigned long)stats.reclaimed_bytes, (unsigned long)stats.failed_adds);
+  UART_SendString(msg);
+  if (stats.names > 0)
+  {
+    sprintf(msg, "\r\n%lu bytes per name with its handle, %u in a fixed field",
+            (unsigned long)((live_bytes + stats.names - 1) / stats.names + sizeof(NameHandle)),
+            (unsigned)ConsoleBank::name_size());
+    UART_SendString(msg);
+  }
+}
+
+/* Print the trace ring, oldest first, in the text form tools/trace2json.py */
+/* reads from a terminal capture. Tracing is paused so the dump does not */
+/* overwrite the records it is printing. */
+static void report_trace(void)
+{
+  char msg[48] = {0};
+  trace_paused.store(true, std::memory_order_relaxed);
+  uint32_t head = trace_head.load(std::memory_order_acquire);
+  uint32_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+  sprintf(msg, "\r\ntrace v1 %lu %lu", (unsigned long)Trace_CyclesPerUs(), (unsigned long)(head - first));
+  UART_SendString(msg);
+  for (uint32_t i = first; i != head; i++)
+  {
+    const TraceRecord &r = trace_ring[i & (TRACE_RING_SIZE - 1)];
+    sprintf(msg, "\r\n%08lx %08lx %u %c %u", (unsigned long)r.cycles, (unsigned long)r.tick, r.event, r.phase, r.arg);
+    UART_SendString(msg);
+  }
+  UART_SendString("\r\nend trace");
+  trace_paused.store(false, std::memory_order_relaxed);
+}
+
+/* Print the PC histogram since the last dump, non-empty buckets only, in */
+/* the text form tools/profile2sym.py reads, then start a new one. */
+/* Sampling is paused meanwhile, so the dump does not profile itself. */
+static void report_profile(void)
+{
+  char msg[112] = {0};
+  ProfilerInfo info;
+  Profiler_Pause(true);
+  Profiler_GetInfo(&info);
+
+  sprintf(msg, "\r\nprofile v1 %lu %lx %lu %lu %lx %lu %lu %lu", (unsigned long)info.hz, (unsigned long)info.base,
+          (unsigned long)info.shift, (unsigned long)info.buckets, (unsigned long)info.anchor,
+          (unsigned long)info.samples, (unsigned long)info.outside, (unsigned long)info.halvings);
+  UART_SendString(msg);
+  for (uint32_t i = 0; i < info.buckets; i++)
+  {
+    if (profiler_counts[i] == 0)
+      continue;
+    sprintf(msg, "\r\n%lx %u", (unsigned long)i, profiler_counts[i]);
+    UART_SendString(msg);
+  }
+  UART_SendString("\r\nend profile");
+  Profiler_Clear();
+  Profiler_Pause(false);
+}
+
+/**
+ * @brief  Diagnostics menu loop
+ * @retval false on input timeout, true when the user quits
+ */
+bool run_diagnostics(const ConsoleBank &bank)
+{
+  uint8_t option[OPTIONSIZE] = {0};
+  const char *prompt = nullptr;
+  while (true)
+  {
+    prompt = "\r\nStack (K), Last fault (F), Clear fault (C), Total balance (T), CRC speed (R), \r\n"
+             "UART errors (U), Storage (P), Names (N), Audit (A), Event trace (E), Profile (H), Replication (L) \r\n"
+             "or Quit (Q). \r\n"
+             "Please enter: ";
+    if (!get_user_input(prompt, option, sizeof(option), TRANSACTION_WAIT))
+      return false;
+
+    if (option[0] == 'K')
+      report_stack();
+    else if (option[0] == 'F')
+      report_last_fault();
+    else if (option[0] == 'C')
+    {
+      Fault_ClearRecord();
+      UART_SendString("\r\nFault record cleared.");
+    }
+    else if (option[0] == 'T')
+      report_total(bank);
+    else if (option[0] == 'R')
+      report_crc_throughput();
+    else if (option[0] == 'U')
+      report_uart_errors();
+    else if (option[0] == 'P')
+      report_storage();
+    else if (option[0] == 'N')
+      report_names();
+    else if (option[0] == 'A')
+      report_audit(bank);
+    else if (option[0] == 'E')
+      report_trace();
+    else if (option[0] == 'H')
+      report_profile();
+    else if (option[0] == 'L')
+      report_replication();
+    else if (option[0] == 'Q')
+      break;
+    else if (option[0] == 0) // no input, timeout
+      continue;
+    else
+      UART_SendString("\r\nInvalid option.");
+  }
+  return true;
+}
@@ -0,0 +1,130 @@
+/* External I2C FRAM/EEPROM on I2C1. Page writes are sent by DMA (DMA1 Stream7) */
+/* and an EEPROM's internal write cycle is waited out by acknowledge polling, */
+/* so the main loop only ever checks a flag. */
+
+#include "main.h"
+#include "ext_mem.h"
+#include <atomic>
+
+I2C_HandleTypeDef ExtMemHandle;
+DMA_HandleTypeDef ExtMemDmaTxHandle;
+
+enum
+{
+  STATE_IDLE = 0,
+  STATE_TRANSFER, // DMA and I2C busy, completion comes from interrupt context
+  STATE_CYCLE,    // data sent, device may still be programming the page
+  STATE_ERROR,
+};
+static std::atomic<uint8_t> state(STATE_IDLE);
+
+/* Blocking reads are split so the HAL transfer counter does not overflow */
+#define EXT_MEM_READ_CHUNK              0x8000U
+#define EXT_MEM_READ_TIMEOUT            1000U
+
+void ExtMem_Init(void)
+{
+  ExtMemHandle.Instance = EXT_MEM_I2C;
+  ExtMemHandle.Init.ClockSpeed = EXT_MEM_I2C_SPEED;
+  ExtMemHandle.Init.DutyCycle = I2C_DUTYCYCLE_2;
+  ExtMemHandle.Init.OwnAddress1 = 0;
+  ExtMemHandle.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+  ExtMemHandle.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+  ExtMemHandle.Init.OwnAddress2 = 0;
+  ExtMemHandle.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+  ExtMemHandle.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+  if (HAL_I2C_Init(&ExtMemHandle) != HAL_OK)
+    Error_Handler();
+
+  EXT_MEM_DMA_CLK_ENABLE();
+  ExtMemDmaTxHandle.Instance = EXT_MEM_DMA_TX_STREAM;
+  ExtMemDmaTxHandle.Init.Channel = EXT_MEM_DMA_TX_CHANNEL;
+  ExtMemDmaTxHandle.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  ExtMemDmaTxHandle.Init.PeriphInc = DMA_PINC_DISABLE;
+  ExtMemDmaTxHandle.Init.MemInc = DMA_MINC_ENABLE;
+  ExtMemDmaTxHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  ExtMemDmaTxHandle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  ExtMemDmaTxHandle.Init.Mode = DMA_NORMAL;
+  ExtMemDmaTxHandle.Init.Priority = DMA_PRIORITY_LOW;
+  ExtMemDmaTxHandle.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(&ExtMemDmaTxHandle) != HAL_OK)
+    Error_Handler();
+  __HAL_LINKDMA(&ExtMemHandle, hdmatx, ExtMemDmaTxHandle);
+
+  /* Below the UART so console input is never held up by storage traffic */
+  HAL_NVIC_SetPriority(EXT_MEM_DMA_TX_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(EXT_MEM_DMA_TX_IRQn);
+}
+
+/**
+ * @brief  Blocking read, used while restoring the account table at boot.
+ * @retval false on a bus error or timeout
+ */
+bool ExtMem_Read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+  while (len > 0)
+  {
+    uint16_t chunk = len > EXT_MEM_READ_CHUNK ? EXT_MEM_READ_CHUNK : (uint16_t)len;
+    if (HAL_I2C_Mem_Read(&ExtMemHandle, EXT_MEM_DEV_ADDR, (uint16_t)addr, I2C_MEMADD_SIZE_16BIT,
+                         buf, chunk, EXT_MEM_READ_TIMEOUT) != HAL_OK)
+      return false;
+    addr += chunk;
+    buf += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+/**
+ * @brief  Start a write of at most one page. buf must stay unchanged until
+ *         ExtMem_Poll() no longer reports EXT_MEM_BUSY.
+ * @retval false if the device is busy or the transfer could not be started
+ */
+bool ExtMem_WriteStart(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+  if (state.load(std::memory_order_acquire) != STATE_IDLE)
+    return false;
+  if (len == 0 || addr / EXT_MEM_PAGE_SIZE != (addr + len - 1) / EXT_MEM_PAGE_SIZE)
+    return false;
+
+  state.store(STATE_TRANSFER, std::memory_order_release);
+  if (HAL_I2C_Mem_Write_DMA(&ExtMemHandle, EXT_MEM_DEV_ADDR, (uint16_t)addr, I2C_MEMADD_SIZE_16BIT,
+                            (uint8_t *)buf, (uint16_t)len) != HAL_OK)
+  {
+    state.store(STATE_IDLE, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
+
+ExtMemState ExtMem_Poll(void)
+{
+  switch (state.load(std::memory_order_acquire))
+  {
+  case STATE_TRANSFER:
+    return EXT_MEM_BUSY;
+  case STATE_CYCLE:
+    /* An EEPROM does not acknowledge its address until the page is programmed */
+    if (EXT_MEM_WRITE_CYCLE_MS > 0 && HAL_I2C_IsDeviceReady(&ExtMemHandle, EXT_MEM_DEV_ADDR, 1, 1) != HAL_OK)
+      return EXT_MEM_BUSY;
+    state.store(STATE_IDLE, std::memory_order_release);
+    return EXT_MEM_IDLE;
+  case STATE_ERROR:
+    state.store(STATE_IDLE, std::memory_order_release);
+    return EXT_MEM_ERROR;
+  default:
+    return EXT_MEM_IDLE;
+  }
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == EXT_MEM_I2C)
+    state.store(STATE_CYCLE, std::memory_order_release);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  if (hi2c->Instance == EXT_MEM_I2C)
+    state.store(STATE_ERROR, std::memory_order_release);
+}
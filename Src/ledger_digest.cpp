@@ -0,0 +1,61 @@
+#include "ledger_digest.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+
+LedgerDigest::LedgerDigest()
+{
+    clear();
+}
+
+/**
+ * @brief  Empty table: every leaf is 0 and the inner nodes hash those
+ */
+void LedgerDigest::clear()
+{
+    memset(nodes, 0, sizeof(nodes));
+    for (uint32_t n = LEAVES - 1; n > 0; n--)
+        nodes[n] = crc32_compute(&nodes[2 * n], 2 * sizeof(uint32_t));
+}
+
+/**
+ * @brief  Set leaf index and rehash its path to the root
+ */
+void LedgerDigest::update(uint32_t index, uint32_t leaf)
+{
+    if (index >= LEAVES)
+        return;
+    uint32_t n = LEAVES + index;
+    nodes[n] = leaf;
+    for (n /= 2; n > 0; n /= 2)
+        nodes[n] = crc32_compute(&nodes[2 * n], 2 * sizeof(uint32_t));
+}
+
+void LedgerDigest::update(const BankAccount &account)
+{
+    update(account.get_account_id(), leaf_hash(account));
+}
+
+/**
+ * @brief  Follow the differing children from the root down to a leaf
+ * @retval the lowest account index whose leaf differs, or NO_MISMATCH
+ */
+uint32_t LedgerDigest::find_mismatch(const LedgerDigest &other) const
+{
+    if (root() == other.root())
+        return NO_MISMATCH;
+    uint32_t n = 1;
+    while (n < LEAVES)
+        n = nodes[2 * n] != other.nodes[2 * n] ? 2 * n : 2 * n + 1;
+    return n - LEAVES;
+}
+
+/**
+ * @retval CRC-32 of the account's record without its crc field
+ */
+uint32_t LedgerDigest::leaf_hash(const BankAccount &account)
+{
+    AccountRecord record;
+    account.to_record(&record);
+    return crc32_compute(&record, offsetof(AccountRecord, crc));
+}
@@ -3,30 +3,71 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
-#include "bank_account.h"
+#include "bank.h"
+#include "account_store.h"
+#include "amount_parser.h"
+#include "crc32.h"
+#include "cycle_counter.h"
+#include "dedupe_cache.h"
+#include "diagnostics.h"
+#include "profiler.h"
+#include "replication.h"
+#include "session_table.h"
+#include "sha256.h"
+#include "stack_monitor.h"
+#include "standing_orders.h"
+#include "stm32f4xx_it.h"
+#include "timer_wheel.h"
+#include "trace.h"
+#include "uart.h"
+#include "uart_errors.h"
+#include "warm_boot.h"
 #include <stdio.h>
-#include <string.h>
 #include <stdlib.h>
+#include <string.h>
 #include <array>
+#include <atomic>
 
-UART_HandleTypeDef UartHandle;
+typedef Uart<USARTx_BASE, USARTx_BAUD, UartPins<USARTx_GPIO_BASE, USARTx_TX_PIN, USARTx_RX_PIN, USARTx_AF>>
+    ConsoleUart;
 static GPIO_InitTypeDef GPIO_InitStruct;
 
-/* Interrupt flags */
-volatile uint8_t rx_done = 0;
-volatile uint8_t tx_done = 0;
+/* Receive ring, filled one byte at a time by the UART interrupt */
+static uint8_t rx_ring[UART_RX_RING_SIZE];
+static std::atomic<uint16_t> rx_head(0); // written by the interrupt
+static std::atomic<uint16_t> rx_tail(0); // written by the main loop
+
+/* Set from interrupt context, serviced by Error_Blink_Service() in the main loop */
+static std::atomic<bool> blink_request(false);
+/* Results of recent requests that carried a client request id */
+static DedupeCache dedupe_cache;
+/* Standing orders and session inactivity limits, advanced from the main loop */
+static TimerWheel timers;
+static bool session_expired = false;
+static TimerHandle session_timer = TIMER_NONE;
+static uint32_t session_token = 0; // of the running account session
+/* Resume tokens of recent account sessions */
+static SessionTable sessions;
+/* Wrong batch passwords in a row, and the tick of the last one */
+static uint32_t batch_failures = 0;
+static uint32_t batch_failure_tick = 0;
 
 /* Private function prototypes -----------------------------------------------*/
 static void SystemClock_Config(void);
 static void Error_Blink(void);
+static void Error_Blink_Service(void);
 static void UART_Init(void);
 static void GPIO_Init(void);
+static void idle_poll(void);
+bool UART_GetChar(uint8_t *c, uint32_t delay);
 bool UART_ReadChars(uint8_t *buf, uint32_t buf_size, uint32_t delay);
-void UART_SendString(const char *msg);
-bool get_user_input(const char *prompt, uint8_t *buf, uint32_t buf_size, uint32_t delay);
-bool create_account(std::array<BankAccount, MAX_ACCOUNTS> &accounts);
-bool manage_account(BankAccount &account);
-static void Error_Handler(void);
+bool UART_ReadLine(uint8_t *buf, uint32_t buf_size, uint32_t delay, bool *too_long);
+static bool get_account_name(const char *prompt, uint8_t *name, uint32_t *request_id, bool *too_long);
+bool UART_ReadAmount(AmountParser *parser, uint32_t delay);
+bool create_account(ConsoleBank &bank, uint32_t *account_id);
+bool manage_account(ConsoleBank &bank, BankAccount &account);
+bool resume_account(ConsoleBank &bank, const uint8_t *option);
+bool batch_post(ConsoleBank &bank);
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -37,12 +78,31 @@ static void Error_Handler(void);
  */
 int main(void)
 {
+  Stack_Paint();
   HAL_Init();
   SystemClock_Config();
   GPIO_Init();
+  CycleCounter_Init();
   UART_Init();
+  Trace_Init();
+  Profiler_Init();
+  CRC32_Init();
+  AccountStore_Init();
 
-  std::array<BankAccount, MAX_ACCOUNTS> accounts;
+  ConsoleBank &bank = WarmBoot_Attach();
+  WarmBootStats boot;
+  WarmBoot_GetStats(&boot);
+  if (boot.kind == WARM_BOOT_WARM)
+    AccountStore_Adopt(bank);
+  else
+  {
+    AccountStore_Load(bank);
+    WarmBoot_Seal();
+  }
+  timers.clear(HAL_GetTick());
+  StandingOrders_Init(bank, timers);
+  Replication_Init(bank);
+  WarmBoot_Ready();
   const char *prompt = nullptr;
   /* Infinite loop */
   while (1)
@@ -50,20 +110,35 @@ int main(void)
     UART_SendString("\r\n*****************************************************\r\n\
 ------------- Welcome to Embedded Bank! -------------\r\n\
 *****************************************************");
-    prompt = "\r\nNew account (N) or Existing account (E). \r\nPlease enter: ";
-    uint8_t option[OPTIONSIZE] = {0};
+    bool backup = Replication_Role() == REPL_ROLE_BACKUP;
+    if (backup)
+      prompt = "\r\nBackup ledger. Status (S) or Promote to primary (P). \r\nPlease enter: ";
+    else
+      prompt = "\r\nNew account (N), Existing account (E), Resume (R<code>), Batch deposits (B) or Status (S). "
+               "\r\nPlease enter: ";
+    uint8_t option[OPTIONSIZE + SESSION_TOKEN_DIGITS] = {0};
     get_user_input(prompt, option, sizeof(option), ENTRY_WAIT); // blocking forever
 
-    if (option[0] == 'N')
+    if (backup && (option[0] == 'N' || option[0] == 'E' || option[0] == 'R' || option[0] == 'B'))
+      UART_SendString("\r\nThis is the backup; use the primary or promote this board.");
+    else if (backup && option[0] == 'P')
+    {
+      Replication_Promote();
+      UART_SendString("\r\nPromoted to primary.");
+    }
+    else if (option[0] == 'N')
     {
       {
-        if (!create_account(accounts))
+        uint32_t new_account_id = 0;
+        TRACE_BEGIN(MENU_CREATE);
+        bool created = create_account(bank, &new_account_id);
+        TRACE_END(MENU_CREATE);
+        if (!created)
         {
           UART_SendString("\r\nOperation aborted! Please try again!");
           continue;
         }
-        const uint16_t new_account_idx = BankAccount::get_total_accounts() - 1;
-        if (!manage_account(accounts[new_account_idx]))
+        if (!manage_account(bank, bank[new_account_id]))
         {
           UART_SendString("\r\nOperation aborted! Please try again!");
           continue;
@@ -72,40 +147,65 @@ int main(void)
     }
     else if (option[0] == 'E')
     {
-      uint8_t account_name[NAMESIZE] = {0};
-      prompt = "\r\nEnter account name: ";
-      if (!get_user_input(prompt, account_name, sizeof(account_name), TRANSACTION_WAIT))
+      TRACE_BEGIN(MENU_LOGIN);
+      uint8_t account_name[NAME_LEN_MAX + 1] = {0};
+      uint32_t request_id = 0; // not used by a login
+      bool too_long = false;
+      if (!get_account_name("\r\nEnter account name: ", account_name, &request_id, &too_long))
       {
+        TRACE_END(MENU_LOGIN);
         UART_SendString("\r\nOperation aborted! Please try again!");
         continue;
       }
+      if (too_long)
+      {
+        TRACE_END(MENU_LOGIN);
+        continue;
+      }
 
       uint8_t password[PASSWORDSIZE] = {0};
       prompt = "\r\nEnter password: ";
       if (!get_user_input(prompt, password, sizeof(password), TRANSACTION_WAIT))
       {
+        TRACE_END(MENU_LOGIN);
         UART_SendString("\r\nOperation aborted! Please try again!");
         continue;
       }
 
-      // Find the account
-      bool account_found = false;
-      bool manage_success = false;
-      for (auto &account : accounts)
+      TRACE_BEGIN(LOOKUP);
+      BankAccount *account = account_name[0] != 0 ? bank.authenticate(account_name, password) : nullptr;
+      TRACE_END(LOOKUP);
+      TRACE_END(MENU_LOGIN);
+      if (account == nullptr)
+        UART_SendString("\r\nInvalid account name or password.");
+      else
       {
-        if (account.verify_account_name(account_name) && account.verify_password(password))
-        {
-          account_found = true;
-          char tx_buf[100] = {0};
-          sprintf(tx_buf, "\r\nWelcome back user '%s'!", account_name);
-          UART_SendString(tx_buf);
-          manage_success = manage_account(account);
-          break;
-        }
+        char tx_buf[100] = {0};
+        snprintf(tx_buf, sizeof(tx_buf), "\r\nWelcome back user '%s'!", account_name);
+        UART_SendString(tx_buf);
+        if (!manage_account(bank, *account))
+          UART_SendString("\r\nOperation aborted! Please try again!");
       }
-      if (!account_found)
-        UART_SendString("\r\nInvalid account name or password.");
-      else if (!manage_success)
+    }
+    else if (option[0] == 'R')
+    {
+      if (!resume_account(bank, option + 1))
+        UART_SendString("\r\nOperation aborted! Please try again!");
+    }
+    else if (option[0] == 'B')
+    {
+      TRACE_BEGIN(MENU_BATCH);
+      bool completed = batch_post(bank);
+      TRACE_END(MENU_BATCH);
+      if (!completed)
+        UART_SendString("\r\nOperation aborted! Please try again!");
+    }
+    else if (option[0] == 'S')
+    {
+      TRACE_BEGIN(MENU_STATUS);
+      bool completed = run_diagnostics(bank);
+      TRACE_END(MENU_STATUS);
+      if (!completed)
         UART_SendString("\r\nOperation aborted! Please try again!");
     }
     else
@@ -152,76 +252,102 @@ static void SystemClock_Config(void)
 }
 
 /**
- * @brief  Tx Transfer completed callback
- * @param  UartHandle: UART handle.
- * @note   This example shows a simple way to report end of IT Tx transfer, and
- *         you can add your own implementation.
- * @retval None
+ * @brief  Console UART interrupt: one received byte into the ring, or an error.
+ *         The cycles it takes are counted for the diagnostics menu.
  */
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
+void USARTx_IRQHandler(void)
 {
-  tx_done = 1;
+  const uint32_t start = CycleCounter_Read();
+  uint8_t byte = 0;
+  uint32_t errors = 0;
+  bool received = ConsoleUart::receive(&byte, &errors);
+  if (errors != 0)
+  {
+    UART_Errors_Record(errors);
+    Error_Blink();
+  }
+  if (received)
+  {
+    uint16_t head = rx_head.load(std::memory_order_relaxed);
+    uint16_t next = (head + 1) % UART_RX_RING_SIZE;
+    if (next != rx_tail.load(std::memory_order_acquire))
+    {
+      rx_ring[head] = byte;
+      rx_head.store(next, std::memory_order_release);
+    }
+    else
+      UART_Errors_Record(HAL_UART_ERROR_ORE); // ring full, the byte is lost like a hardware overrun
+    UART_Errors_CountByte();
+    TRACE_INSTANT(UART_RX_BYTE, byte);
+  }
+  UART_Errors_CountIrq(UART_LINK_CONSOLE, CycleCounter_Read() - start);
 }
 
 /**
- * @brief  Rx Transfer completed callback
- * @param  UartHandle: UART handle
- * @note   This example shows a simple way to report end of IT Rx transfer, and
- *         you can add your own implementation.
- * @retval None
+ * @brief  Replication link interrupt, still serviced by the HAL; timed the same
+ *         way as the console's as the baseline for the register-level driver.
  */
+void REPL_IRQHandler(void)
+{
+  const uint32_t start = CycleCounter_Read();
+  HAL_UART_IRQHandler(&ReplHandle);
+  UART_Errors_CountIrq(UART_LINK_REPL, CycleCounter_Read() - start);
+}
+
+/* The HAL only drives the replication link */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
+{
+  if (UartHandle->Instance == REPL_USART)
+    Replication_TxCpltCallback();
+}
+
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *UartHandle)
 {
-  rx_done = 1;
+  if (UartHandle->Instance == REPL_USART)
+    Replication_RxCpltCallback();
 }
 
-static void Error_Blink(void)
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *UartHandle)
 {
-  for (uint8_t i = 0; i < 3; i++)
-  {
-    HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13);
-    HAL_Delay(500);
-  }
-  HAL_GPIO_WritePin(GPIOC, GPIO_PIN_13, GPIO_PIN_RESET);
+  if (UartHandle->Instance == REPL_USART)
+    Replication_ErrorCallback();
 }
 
 /**
- * @brief  UART error callbacks
- * @param  UartHandle: UART handle
- * @note   This example shows a simple way to report transfer error, and you can
- *         add your own implementation.
- * @retval None
+ * @brief  Request three blinks of the LED. Safe from interrupt context; the
+ *         blinking itself is done by Error_Blink_Service() in the main loop.
  */
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *UartHandle)
+static void Error_Blink(void)
 {
-  Error_Blink();
+  blink_request.store(true, std::memory_order_relaxed);
 }
 
-void UART_Init(void)
+static void Error_Blink_Service(void)
 {
-  /* Put the USART peripheral in the Asynchronous mode (UART Mode) */
-  /* UART1 configured as follow:
-      - Word Length = 8 Bits
-      - Stop Bit = One Stop bit
-      - Parity = ODD parity
-      - BaudRate = 9600 baud
-      - Hardware flow control disabled (RTS and CTS signals) */
-  UartHandle.Instance = USARTx;
-  UartHandle.Init.BaudRate = 9600;
-  UartHandle.Init.WordLength = UART_WORDLENGTH_8B;
-  UartHandle.Init.StopBits = UART_STOPBITS_1;
-  UartHandle.Init.Parity = UART_PARITY_NONE;
-  UartHandle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-  UartHandle.Init.Mode = UART_MODE_TX_RX;
-  UartHandle.Init.OverSampling = UART_OVERSAMPLING_16;
+  /* Three toggles 500 ms apart, then the LED is switched off */
+  static uint8_t steps_left = 0;
+  static uint32_t last_step = 0;
 
-  if (HAL_UART_Init(&UartHandle) != HAL_OK)
+  if (blink_request.exchange(false, std::memory_order_relaxed))
   {
-    Error_Blink();
-    while (1)
-    {
-    }
+    steps_left = 4;
+    last_step = HAL_GetTick() - 500;
   }
+  if (steps_left == 0 || HAL_GetTick() - last_step < 500)
+    return;
+
+  last_step = HAL_GetTick();
+  if (--steps_left > 0)
+    HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_13);
+  else
+    HAL_GPIO_WritePin(GPIOC, GPIO_PIN_13, GPIO_PIN_RESET);
+}
+
+static void UART_Init(void)
+{
+  /* USARTx_BAUD, 8 data bits, no parity, one stop bit, no flow control */
+  ConsoleUart::init(1, 1);
+  UART_Errors_Reset();
 }
 
 static void GPIO_Init(void)
@@ -237,6 +363,48 @@ static void GPIO_Init(void)
   HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
 }
 
+/**
+ * @brief  Background work done while waiting for console input
+ */
+static void idle_poll(void)
+{
+  Error_Blink_Service();
+  AccountStore_Service();
+  timers.advance(HAL_GetTick());
+  Replication_Service();
+  Trace_Drain();
+}
+
+/**
+ * @brief  Take one byte from the receive ring, sleeping until it arrives
+ * @param  delay: timeout in ms, HAL_MAX_DELAY to wait forever
+ * @retval false on timeout
+ */
+bool UART_GetChar(uint8_t *c, uint32_t delay)
+{
+  const uint32_t tickstart = HAL_GetTick();
+  uint16_t tail = rx_tail.load(std::memory_order_relaxed);
+
+  if (tail == rx_head.load(std::memory_order_acquire))
+  {
+    TRACE_BEGIN(UART_RX_WAIT);
+    while (tail == rx_head.load(std::memory_order_acquire))
+    {
+      if (session_expired || (delay != HAL_MAX_DELAY && HAL_GetTick() - tickstart >= delay))
+      {
+        TRACE_END(UART_RX_WAIT);
+        return false;
+      }
+      idle_poll();
+      __WFI(); // the UART interrupt or the next SysTick wakes us up
+    }
+    TRACE_END(UART_RX_WAIT);
+  }
+  *c = rx_ring[tail];
+  rx_tail.store((tail + 1) % UART_RX_RING_SIZE, std::memory_order_release);
+  return true;
+}
+
 bool UART_ReadChars(uint8_t *buf, uint32_t buf_size, uint32_t delay)
 {
   memset(buf, 0, buf_size);
@@ -244,7 +412,7 @@ bool UART_ReadChars(uint8_t *buf, uint32_t buf_size, uint32_t delay)
 
   for (uint8_t i = 0; i < buf_size - 1; i++)
   {
-    if (HAL_UART_Receive(&UartHandle, &temp_char, 1, delay) != HAL_OK)
+    if (!UART_GetChar(&temp_char, delay))
       return false;
     if (temp_char == '\r')
       break;
@@ -253,9 +421,54 @@ bool UART_ReadChars(uint8_t *buf, uint32_t buf_size, uint32_t delay)
   return true;
 }
 
+/**
+ * @brief  As UART_ReadChars(), but the whole line is consumed, however long
+ *         it is.
+ * @param  too_long: set if characters past buf_size - 1 were dropped
+ * @retval false on timeout
+ */
+bool UART_ReadLine(uint8_t *buf, uint32_t buf_size, uint32_t delay, bool *too_long)
+{
+  memset(buf, 0, buf_size);
+  *too_long = false;
+  uint8_t c = 0;
+  uint32_t length = 0;
+
+  while (UART_GetChar(&c, delay))
+  {
+    if (c == '\r')
+      return true;
+    if (length < buf_size - 1)
+      buf[length++] = c;
+    else
+      *too_long = true;
+  }
+  return false;
+}
+
+/**
+ * @brief  Feed one input line to an amount parser straight from the receive
+ *         ring. The whole line is consumed, however long it is.
+ * @retval false on timeout
+ */
+bool UART_ReadAmount(AmountParser *parser, uint32_t delay)
+{
+  uint8_t c = 0;
+  parser->reset();
+  while (UART_GetChar(&c, delay))
+  {
+    if (c == '\r')
+      return true;
+    parser->feed(c);
+  }
+  return false;
+}
+
 void UART_SendString(const char *msg)
 {
-  HAL_UART_Transmit(&UartHandle, (uint8_t *)msg, strlen(msg), HAL_MAX_DELAY);
+  TRACE_BEGIN(UART_TX);
+  ConsoleUart::write((const uint8_t *)msg, strlen(msg));
+  TRACE_END(UART_TX);
 }
 
 bool get_user_input(const char *prompt, uint8_t *buf, uint32_t buf_size, uint32_t delay)
@@ -264,36 +477,77 @@ bool get_user_input(const char *prompt, uint8_t *buf, uint32_t buf_size, uint32_
   return UART_ReadChars(buf, buf_size, delay);
 }
 
-bool create_account(std::array<BankAccount, MAX_ACCOUNTS> &accounts)
+/**
+ * @brief  Prompt for an account name, optionally followed by "#<hex id>".
+ *         A name longer than NAME_LEN_MAX is reported and comes back empty,
+ *         never cut short into someone else's name.
+ * @param  name: NAME_LEN_MAX + 1 bytes, set to the name 0-terminated
+ * @param  request_id: set to the request id, 0 if there is none
+ * @param  too_long: set if the name was refused for its length
+ * @retval false on timeout
+ */
+static bool get_account_name(const char *prompt, uint8_t *name, uint32_t *request_id, bool *too_long)
 {
-  uint8_t account_name[NAMESIZE] = {0};
+  uint8_t line[NAME_LEN_MAX + REQUEST_ID_SIZE + 1] = {0};
+  char msg[64] = {0};
+
+  memset(name, 0, NAME_LEN_MAX + 1);
+  *request_id = 0;
+  UART_SendString(prompt);
+  if (!UART_ReadLine(line, sizeof(line), TRANSACTION_WAIT, too_long))
+    return false;
+  *request_id = split_request_id(line, sizeof(line));
+  *too_long = *too_long || strnlen((const char *)line, sizeof(line)) > NAME_LEN_MAX;
+  if (*too_long)
+  {
+    sprintf(msg, "\r\nAccount names have at most %u characters.", (unsigned)NAME_LEN_MAX);
+    UART_SendString(msg);
+    return true;
+  }
+  memcpy(name, line, NAME_LEN_MAX);
+  return true;
+}
+
+bool create_account(ConsoleBank &bank, uint32_t *account_id)
+{
+  uint8_t account_name[NAME_LEN_MAX + 1] = {0};
   uint8_t password[PASSWORDSIZE] = {0};
   uint8_t confirm_password[PASSWORDSIZE] = {0};
   char tx_buf[100] = {0};
-  bool is_unique = true;
-
-  uint16_t count = BankAccount::get_total_accounts();
-  if (count == MAX_ACCOUNTS)
-    UART_SendString("\r\nThe bank capacity is full. Your account cannot be created.");
+  uint32_t request_id = 0;
+  const DedupeResult *replay = nullptr;
 
   while (true)
   {
-    if (!get_user_input("\r\nEnter account name: ", account_name, sizeof(account_name), TRANSACTION_WAIT))
+    bool too_long = false;
+    if (!get_account_name("\r\nEnter account name: ", account_name, &request_id, &too_long))
       return false;
-    is_unique = true;
-    for (auto &account : accounts)
+    if (too_long)
+      continue;
+    if (account_name[0] == 0)
     {
-      if (account.verify_account_name(account_name))
-      {
-        sprintf(tx_buf, "\r\nAccount name '%s' is not available!", account_name);
-        UART_SendString(tx_buf);
-        is_unique = false;
-        break;
-      }
+      UART_SendString("\r\nThe account name must not be empty.");
+      continue;
     }
 
-    if (is_unique)
+    // A retried create: the account already exists, only the password is checked
+    replay = request_id ? dedupe_cache.find(DEDUPE_CREATE, DEDUPE_NO_ACCOUNT, request_id) : nullptr;
+    if (replay)
       break;
+    TRACE_BEGIN(LOOKUP);
+    bool taken = bank.find(account_name) != nullptr;
+    TRACE_END(LOOKUP);
+    if (!taken)
+      break;
+
+    sprintf(tx_buf, "\r\nAccount name '%s' is not available!", account_name);
+    UART_SendString(tx_buf);
+  }
+
+  if (!replay && bank.full())
+  {
+    UART_SendString("\r\nThe bank capacity is full. Your account cannot be created.");
+    return false;
   }
 
   while (true)
@@ -309,57 +563,272 @@ bool create_account(std::array<BankAccount, MAX_ACCOUNTS> &accounts)
       UART_SendString("\r\nPassword and confirm password do not match.\n");
       continue;
     }
-    BankAccount new_account(account_name, password);
-    uint16_t id = new_account.get_account_id();
-    accounts[id] = new_account;
+    if (replay)
+    {
+      BankAccount *account = bank.authenticate(account_name, password);
+      if (account == nullptr || account->get_account_id() != replay->account_id)
+      {
+        sprintf(tx_buf, "\r\nAccount name '%s' is not available!", account_name);
+        UART_SendString(tx_buf);
+        return false;
+      }
+      *account_id = replay->account_id;
+    }
+    else
+    {
+      ConsoleBank::CreateStatus status = bank.create(account_name, password, account_id);
+      if (status == ConsoleBank::CreateStatus::NameTaken)
+      {
+        sprintf(tx_buf, "\r\nAccount name '%s' is not available!", account_name);
+        UART_SendString(tx_buf);
+        return false;
+      }
+      if (status == ConsoleBank::CreateStatus::BadName)
+      {
+        UART_SendString("\r\nThe account name must not be empty.");
+        return false;
+      }
+      if (status == ConsoleBank::CreateStatus::Full)
+      {
+        UART_SendString("\r\nThe bank capacity is full. Your account cannot be created.");
+        return false;
+      }
+      if (status == ConsoleBank::CreateStatus::NoNameSpace)
+      {
+        UART_SendString("\r\nThere is no room left for account names. Your account cannot be created.");
+        return false;
+      }
+      AccountStore_Update(bank[*account_id]);
+      Replication_Log(REPL_OP_CREATE, bank[*account_id]);
+      if (request_id)
+        dedupe_cache.insert(DEDUPE_CREATE, DEDUPE_NO_ACCOUNT, request_id, {true, (uint16_t)*account_id, 0});
+    }
     sprintf(tx_buf, "\r\nNew account '%s' created.", account_name);
     UART_SendString(tx_buf);
     return true;
   }
 }
 
-bool manage_account(BankAccount &account)
+/**
+ * @brief  Apply a deposit or withdrawal, unless request_id was already
+ *         applied; then the original outcome is returned without touching
+ *         the balance.
+ * @retval true if the (original) operation succeeded
+ */
+static bool apply_once(uint8_t op, BankAccount &account, amount_t *amount, uint32_t request_id)
+{
+  const DedupeResult *replay = request_id ? dedupe_cache.find(op, account.get_account_id(), request_id) : nullptr;
+  if (replay)
+  {
+    *amount = replay->amount;
+    return replay->ok;
+  }
+
+  bool ok = op == DEDUPE_DEPOSIT ? account.deposit(*amount) : account.withdraw(*amount);
+  if (ok)
+  {
+    AccountStore_Update(account);
+    Replication_Log(op == DEDUPE_DEPOSIT ? REPL_OP_DEPOSIT : REPL_OP_WITHDRAW, account);
+  }
+  if (request_id)
+    dedupe_cache.insert(op, account.get_account_id(), request_id, {ok, (uint16_t)account.get_account_id(), *amount});
+  return ok;
+}
+
+/**
+ * @brief  Prompt for an amount and parse it as it arrives.
+ * @retval false on timeout; otherwise the parse result is in parser
+ */
+static bool get_user_amount(const char *prompt, AmountParser *parser, uint32_t delay)
+{
+  UART_SendString(prompt);
+  return UART_ReadAmount(parser, delay);
+}
+
+static void report_amount_error(AmountError error)
+{
+  char msg[80] = {0};
+  sprintf(msg, "\r\nInvalid amount: %s.", amount_error_text(error));
+  UART_SendString(msg);
+}
+
+/**
+ * @brief  Standing order submenu of an account session
+ * @retval false on input timeout
+ */
+static bool standing_orders_menu(ConsoleBank &bank, BankAccount &account)
 {
   uint8_t option[OPTIONSIZE] = {0};
-  uint8_t amount_buf[AMOUNTSIZE] = {0};
+  uint8_t line[NAME_LEN_MAX + 1] = {0};
+  AmountParser parser;
+  amount_t amount = 0;
+  uint32_t request_id = 0;
+  char text[16] = {0};
+  char msg[160] = {0};
+  const uint32_t owner = account.get_account_id();
+
+  if (!get_user_input("\r\nNew (N), List (L) or Cancel (C) standing order. \r\nPlease enter: ", option, sizeof(option),
+                      TRANSACTION_WAIT))
+    return false;
+
+  if (option[0] == 'N')
+  {
+    bool too_long = false;
+    if (!get_account_name("\r\nEnter payee account name: ", line, &request_id, &too_long))
+      return false;
+    if (too_long)
+      return true;
+    BankAccount *payee = bank.find(line);
+    if (payee == nullptr)
+    {
+      snprintf(msg, sizeof(msg), "\r\nAccount '%s' not found.", line);
+      UART_SendString(msg);
+      return true;
+    }
+    if (!get_user_amount("\r\nEnter amount: ", &parser, TRANSACTION_WAIT))
+      return false;
+    AmountError error = parser.finish(&amount, &request_id);
+    if (error != AMOUNT_OK)
+    {
+      report_amount_error(error);
+      return true;
+    }
+    if (!get_user_input("\r\nEnter period in seconds: ", line, sizeof(line), TRANSACTION_WAIT))
+      return false;
+    uint32_t period = strtoul((const char *)line, nullptr, 10);
+    uint32_t order = StandingOrders_Create(owner, payee->get_account_id(), amount, period);
+    if (order == STANDING_ORDER_NONE)
+    {
+      UART_SendString("\r\nStanding order could not be created.");
+      return true;
+    }
+    format_amount(text, sizeof(text), amount);
+    snprintf(msg, sizeof(msg), "\r\nStanding order %lu: %s to '%s' every %lu s.", (unsigned long)order, text,
+            payee->get_account_name(), (unsigned long)period);
+    UART_SendString(msg);
+  }
+  else if (option[0] == 'L')
+  {
+    bool any = false;
+    for (uint32_t i = 0; i < STANDING_ORDERS_MAX; i++)
+    {
+      const StandingOrder *o = StandingOrders_Get(i);
+      if (o == nullptr || o->from != owner)
+        continue;
+      any = true;
+      format_amount(text, sizeof(text), o->amount);
+      snprintf(msg, sizeof(msg), "\r\nStanding order %lu: %s to '%s' every %lu s, %lu paid, %lu refused", (unsigned long)i, text,
+              bank[o->to].get_account_name(), (unsigned long)o->period_s, (unsigned long)o->executed,
+              (unsigned long)o->refused);
+      UART_SendString(msg);
+    }
+    if (!any)
+      UART_SendString("\r\nNo standing orders.");
+  }
+  else if (option[0] == 'C')
+  {
+    if (!get_user_input("\r\nEnter standing order number: ", line, sizeof(line), TRANSACTION_WAIT))
+      return false;
+    uint32_t order = strtoul((const char *)line, nullptr, 10);
+    if (StandingOrders_Cancel(order, owner))
+      sprintf(msg, "\r\nStanding order %lu cancelled.", (unsigned long)order);
+    else
+      sprintf(msg, "\r\nNo standing order %lu on this account.", (unsigned long)order);
+    UART_SendString(msg);
+  }
+  else if (option[0] != 0)
+    UART_SendString("\r\nInvalid option.");
+  return true;
+}
+
+static void expire_session(uint32_t arg)
+{
+  (void)arg;
+  session_expired = true;
+}
+
+/* A menu command was accepted: restart the session's SESSION_TIMEOUT */
+static void touch_session(void)
+{
+  timers.cancel(session_timer);
+  session_timer = timers.schedule(SESSION_TIMEOUT, 0, expire_session, 0);
+  sessions.touch(session_token, HAL_GetTick());
+}
+
+static bool run_session(ConsoleBank &bank, BankAccount &account)
+{
+  uint8_t option[OPTIONSIZE] = {0};
+  AmountParser parser;
+  AmountError error = AMOUNT_OK;
   const char *prompt = nullptr;
-  double amount = 0;
+  amount_t amount = 0;
+  uint32_t request_id = 0;
+  char text[16] = {0};
   char msg[50] = {0};
   while (true)
   {
-    prompt = "\r\nBalance (B), Deposit (D), Withdraw (W) or Quit (Q). \r\nPlease enter: ";
+    prompt = "\r\nBalance (B), Deposit (D), Withdraw (W), Standing orders (O) or Quit (Q). \r\nPlease enter: ";
     if (!get_user_input(prompt, option, sizeof(option), TRANSACTION_WAIT))
       return false;
+    if (option[0] != 0 && strchr("BDWOQ", option[0]) != nullptr)
+      touch_session(); // empty lines and invalid options are not activity
 
     if (option[0] == 'B')
     {
-      double balance = account.get_account_balance();
-      sprintf(msg, "\r\nBalance: %0.1f", balance);
+      TRACE_BEGIN(MENU_BALANCE);
+      format_amount(text, sizeof(text), account.get_account_balance());
+      sprintf(msg, "\r\nBalance: %s", text);
       UART_SendString(msg);
+      TRACE_END(MENU_BALANCE);
     }
     else if (option[0] == 'D')
     {
+      TRACE_BEGIN(MENU_DEPOSIT);
       prompt = "\r\nEnter deposit amount: ";
-      if (!get_user_input(prompt, amount_buf, sizeof(amount_buf), TRANSACTION_WAIT))
+      if (!get_user_amount(prompt, &parser, TRANSACTION_WAIT))
+      {
+        TRACE_END(MENU_DEPOSIT);
         return false;
-      amount = atof((char *)amount_buf);
-      account.deposit(amount);
-      sprintf(msg, "\r\nDeposit of %0.1f successful.", amount);
-      UART_SendString(msg);
+      }
+      error = parser.finish(&amount, &request_id);
+      if (error != AMOUNT_OK)
+        report_amount_error(error);
+      else if (apply_once(DEDUPE_DEPOSIT, account, &amount, request_id))
+      {
+        format_amount(text, sizeof(text), amount);
+        sprintf(msg, "\r\nDeposit of %s successful.", text);
+        UART_SendString(msg);
+      }
+      else
+        UART_SendString("\r\nDeposit rejected.");
+      TRACE_END(MENU_DEPOSIT);
     }
     else if (option[0] == 'W')
     {
+      TRACE_BEGIN(MENU_WITHDRAW);
       prompt = "\r\nEnter withdrawal amount: ";
-      if (!get_user_input(prompt, amount_buf, sizeof(amount_buf), TRANSACTION_WAIT))
+      if (!get_user_amount(prompt, &parser, TRANSACTION_WAIT))
+      {
+        TRACE_END(MENU_WITHDRAW);
         return false;
-      amount = atof((char *)amount_buf);
-      if (account.withdraw(amount))
+      }
+      error = parser.finish(&amount, &request_id);
+      if (error != AMOUNT_OK)
+        report_amount_error(error);
+      else if (apply_once(DEDUPE_WITHDRAW, account, &amount, request_id))
       {
-        sprintf(msg, "\r\nWithdrawal of %0.1f successful.", amount);
+        format_amount(text, sizeof(text), amount);
+        sprintf(msg, "\r\nWithdrawal of %s successful.", text);
         UART_SendString(msg);
       }
       else
         UART_SendString("\r\nInsufficient balance for withdrawal.");
+      TRACE_END(MENU_WITHDRAW);
+    }
+    else if (option[0] == 'O')
+    {
+      if (!standing_orders_menu(bank, account))
+        return false;
     }
     else if (option[0] == 'Q')
       break;
@@ -371,7 +840,214 @@ bool manage_account(BankAccount &account)
   return true;
 }
 
-static void Error_Handler(void)
+/* Run a session that holds token. An input timeout keeps the token for a */
+/* resume; Quit and SESSION_TIMEOUT without a command end it. */
+static bool run_token_session(ConsoleBank &bank, BankAccount &account, uint32_t token, uint32_t time_left)
+{
+  session_expired = false;
+  session_token = token;
+  session_timer = timers.schedule(time_left, 0, expire_session, 0);
+  bool completed = run_session(bank, account);
+  timers.cancel(session_timer);
+  session_timer = TIMER_NONE;
+  session_token = 0;
+  if (session_expired)
+  {
+    UART_SendString("\r\nSession expired.");
+    session_expired = false;
+    sessions.revoke(token);
+  }
+  else if (completed)
+    sessions.revoke(token);
+  else
+    sessions.suspend(token, HAL_GetTick());
+  return completed;
+}
+
+/**
+ * @brief  Account session: ends on Quit, an input timeout, or SESSION_TIMEOUT
+ *         without a menu command. The resume code printed at the start
+ *         takes the client back in after an input timeout.
+ * @retval false if the session did not end with Quit
+ */
+bool manage_account(ConsoleBank &bank, BankAccount &account)
+{
+  char msg[32] = {0};
+  uint32_t token = sessions.issue((uint16_t)account.get_account_id(), HAL_GetTick(), CycleCounter_Read());
+  sprintf(msg, "\r\nResume code R%08lx.", (unsigned long)token);
+  UART_SendString(msg);
+  return run_token_session(bank, account, token, SESSION_TIMEOUT);
+}
+
+/**
+ * @brief  Welcome menu R<code>: back into the account menu of a session that
+ *         timed out waiting for input, in one round trip.
+ * @param  option: the characters after R
+ * @retval false if the resumed session did not end with Quit
+ */
+bool resume_account(ConsoleBank &bank, const uint8_t *option)
+{
+  uint16_t account_id = 0;
+  uint32_t time_left = 0;
+  uint32_t token = parse_session_token(option);
+  TRACE_BEGIN(MENU_LOGIN);
+  bool resumed = sessions.resume(token, HAL_GetTick(), &account_id, &time_left);
+  TRACE_END(MENU_LOGIN);
+  if (!resumed)
+  {
+    UART_SendString("\r\nUnknown or expired resume code.");
+    return true;
+  }
+  char msg[80] = {0};
+  snprintf(msg, sizeof(msg), "\r\nResumed session of '%s'.", bank[account_id].get_account_name());
+  UART_SendString(msg);
+  return run_token_session(bank, bank[account_id], token, time_left);
+}
+
+/* One line of a batch: the name is the only part kept, the amount goes */
+/* straight into the parser */
+typedef struct
+{
+  uint8_t name[NAME_LEN_MAX + 1];
+  uint8_t name_len;
+  bool has_amount; // a ',' was seen
+  bool too_long;   // name longer than NAME_LEN_MAX
+} BatchLine;
+
+typedef struct
+{
+  uint32_t record; // 1-based position in the batch
+  char reason;     // see batch_post()
+} BatchFailure;
+
+/**
+ * @brief  Read one batch line, up to CR or LF
+ * @retval false on timeout
+ */
+static bool read_batch_line(BatchLine *line, AmountParser *parser)
+{
+  uint8_t c = 0;
+  memset(line, 0, sizeof(*line));
+  parser->reset();
+  while (UART_GetChar(&c, TRANSACTION_WAIT))
+  {
+    if (c == '\r' || c == '\n')
+      return true;
+    if (line->has_amount)
+      parser->feed(c);
+    else if (c == ',')
+      line->has_amount = true;
+    else if (line->name_len < NAME_LEN_MAX)
+      line->name[line->name_len++] = c;
+    else
+      line->too_long = true;
+  }
+  return false;
+}
+
+/**
+ * @brief  Batch deposits: "name,amount" lines are looked up and deposited as
+ *         they arrive, nothing is echoed, and a line holding only '.' ends
+ *         the batch. Amounts may carry a request id as in the deposit
+ *         dialog, so a batch can be resent after a lost reply. The summary
+ *         lists failed records as <record><reason>: F malformed line,
+ *         A bad amount, N unknown account, R deposit refused.
+ * @retval false if the input timed out before the end; records received
+ *         until then stay posted
+ */
+bool batch_post(ConsoleBank &bank)
+{
+  if (batch_failures >= BATCH_ATTEMPTS_MAX)
+  {
+    if (HAL_GetTick() - batch_failure_tick < BATCH_LOCKOUT_MS)
+    {
+      UART_SendString("\r\nBatch deposits locked after wrong passwords, try again later.");
+      return true;
+    }
+    batch_failures = 0;
+  }
+  uint8_t password[PASSWORDSIZE] = {0};
+  uint8_t digest[SHA256_SIZE], expected[SHA256_SIZE];
+  if (!get_user_input("\r\nEnter batch password: ", password, sizeof(password), TRANSACTION_WAIT))
+    return false;
+  sha256_compute(password, strnlen((const char *)password, sizeof(password)), digest);
+  memset(password, 0, sizeof(password));
+  if (!sha256_parse(BATCH_PASSWORD_SHA256, expected) || !sha256_equal(digest, expected, SHA256_SIZE))
+  {
+    batch_failures++;
+    batch_failure_tick = HAL_GetTick();
+    UART_SendString("\r\nInvalid batch password.");
+    return true;
+  }
+  batch_failures = 0;
+  UART_SendString("\r\nSend one 'name,amount' line per deposit, then '.' on its own line.\r\n");
+
+  static BatchFailure failures[BATCH_FAILURES_MAX];
+  uint32_t records = 0, posted = 0, failed = 0;
+  int64_t total = 0;
+  bool completed = false;
+  BatchLine line;
+  AmountParser parser;
+  const uint32_t start = HAL_GetTick();
+  while (read_batch_line(&line, &parser))
+  {
+    if (!line.has_amount && !line.too_long && line.name_len == 1 && line.name[0] == '.')
+    {
+      completed = true;
+      break;
+    }
+    if (!line.has_amount && !line.too_long && line.name_len == 0)
+      continue; // blank line, or the LF of a CR LF
+
+    records++;
+    amount_t amount = 0;
+    uint32_t request_id = 0;
+    BankAccount *account = nullptr;
+    char reason = 0;
+    if (!line.has_amount || line.too_long)
+      reason = 'F';
+    else if (parser.finish(&amount, &request_id) != AMOUNT_OK)
+      reason = 'A';
+    else if ((account = bank.find(line.name)) == nullptr)
+      reason = 'N';
+    else if (!apply_once(DEDUPE_DEPOSIT, *account, &amount, request_id))
+      reason = 'R';
+
+    if (reason == 0)
+    {
+      posted++;
+      total += amount;
+    }
+    else if (failed++ < BATCH_FAILURES_MAX)
+      failures[failed - 1] = {records, reason};
+  }
+  uint32_t elapsed = HAL_GetTick() - start;
+
+  char msg[160] = {0};
+  char text[16] = {0};
+  format_amount(text, sizeof(text), total);
+  snprintf(msg, sizeof(msg), "\r\nBatch %s: %lu records, %lu posted (%s), %lu failed in %lu ms (%lu records/s)",
+           completed ? "complete" : "interrupted", (unsigned long)records, (unsigned long)posted, text,
+           (unsigned long)failed, (unsigned long)elapsed, (unsigned long)(elapsed ? records * 1000ULL / elapsed : 0));
+  UART_SendString(msg);
+  if (failed > 0)
+  {
+    UART_SendString("\r\nFailed:");
+    for (uint32_t i = 0; i < failed && i < BATCH_FAILURES_MAX; i++)
+    {
+      sprintf(msg, " %lu%c", (unsigned long)failures[i].record, failures[i].reason);
+      UART_SendString(msg);
+    }
+    if (failed > BATCH_FAILURES_MAX)
+    {
+      sprintf(msg, " +%lu more", (unsigned long)(failed - BATCH_FAILURES_MAX));
+      UART_SendString(msg);
+    }
+  }
+  return completed;
+}
+
+void Error_Handler(void)
 {
   while (1)
   {
@@ -0,0 +1,243 @@
+#include "name_arena.h"
+#include <string.h>
+
+/* Entry: length and ENTRY_DEAD, hash, text, 0 */
+static const uint32_t ENTRY_HEADER = 1 + sizeof(NameHash);
+
+static_assert(NAME_LEN_MAX <= 0x7F, "the top bit of the length byte marks released names");
+
+#ifdef HOST_BUILD
+static uint8_t default_bytes[NAME_ARENA_DEFAULT_SIZE];
+static NameArena arena(default_bytes, sizeof(default_bytes));
+#else
+static NameArena arena; // bound by WarmBoot_Attach()
+#endif
+
+NameArena &Names(void)
+{
+    return arena;
+}
+
+NameArena::NameArena()
+    : bytes(nullptr), capacity(0), used(0), names(0), dead_names(0), dead_bytes(0), compactions(0),
+      reclaimed_bytes(0), failed_adds(0), compactor(nullptr)
+{
+}
+
+NameArena::NameArena(uint8_t *buffer, uint32_t size)
+    : NameArena()
+{
+    bind(buffer, size, 0);
+}
+
+/**
+ * @brief  Use buffer for the names, keeping the first in_use bytes of names
+ *         an earlier arena left in it. Handles into the old buffer are void.
+ * @retval false if those bytes are not a sequence of entries; the arena is
+ *         then empty
+ */
+bool NameArena::bind(uint8_t *buffer, uint32_t size, uint32_t in_use)
+{
+#ifndef HOST_BUILD
+    if (size > UINT16_MAX)
+        size = UINT16_MAX; // handles are offset + 1
+#endif
+    bytes = buffer;
+    capacity = size;
+    compactions = 0;
+    reclaimed_bytes = 0;
+    failed_adds.store(0, std::memory_order_relaxed);
+
+    uint32_t live = 0, dead = 0, garbage = 0, at = 0;
+    bool valid = in_use <= size;
+    while (valid && at < in_use)
+    {
+        uint32_t end = at + entry_size(bytes[at]);
+        valid = (bytes[at] & ENTRY_LENGTH) <= NAME_LEN_MAX && end <= in_use && bytes[end - 1] == 0;
+        if (valid && (bytes[at] & ENTRY_DEAD))
+        {
+            dead++;
+            garbage += end - at;
+        }
+        else
+            live++;
+        at = end;
+    }
+    if (!valid)
+        live = dead = garbage = in_use = 0;
+    used.store(in_use, std::memory_order_release);
+    names.store(live, std::memory_order_relaxed);
+    dead_names = dead;
+    dead_bytes = garbage;
+    return valid;
+}
+
+/**
+ * @brief  Let add() call fn to compact the arena when it runs out of room.
+ *         Only for an arena whose every holder fn can reach, and whose
+ *         names are added from one thread.
+ */
+void NameArena::set_compactor(NameCompactor fn)
+{
+    compactor = fn;
+}
+
+/**
+ * @brief  Store a name. Safe from several threads at once, unless there is
+ *         a compactor.
+ * @retval its handle; NAME_EMPTY for an empty name, or if the name is longer
+ *         than NAME_LEN_MAX or there is no room for it
+ */
+NameHandle NameArena::add(const uint8_t *name, uint32_t length)
+{
+    if (length == 0)
+        return NAME_EMPTY;
+    uint32_t size = entry_size(length);
+    bool compacted = false;
+    uint32_t at = used.load(std::memory_order_relaxed);
+    do
+    {
+        while (length > NAME_LEN_MAX || size > capacity - at)
+        {
+            if (compacted || compactor == nullptr || dead_bytes == 0 || length > NAME_LEN_MAX)
+            {
+                failed_adds.fetch_add(1, std::memory_order_relaxed);
+                return NAME_EMPTY;
+            }
+            compactor(*this);
+            compacted = true;
+            at = used.load(std::memory_order_relaxed);
+        }
+    } while (!used.compare_exchange_weak(at, at + size, std::memory_order_relaxed));
+
+    NameHash h = hash(name, length);
+    uint8_t *entry = bytes + at;
+    entry[0] = (uint8_t)length;
+    memcpy(entry + 1, &h, sizeof(h));
+    memcpy(entry + ENTRY_HEADER, name, length);
+    entry[ENTRY_HEADER + length] = 0;
+    names.fetch_add(1, std::memory_order_relaxed);
+    return (NameHandle)(at + 1);
+}
+
+/**
+ * @brief  Give up a name. Its bytes are only reclaimed by the next compact().
+ */
+void NameArena::release(NameHandle name)
+{
+    if (name == NAME_EMPTY)
+        return;
+    uint8_t *entry = bytes + name - 1;
+    if (entry[0] & ENTRY_DEAD)
+        return;
+    entry[0] |= ENTRY_DEAD;
+    names.fetch_sub(1, std::memory_order_relaxed);
+    dead_names++;
+    dead_bytes += entry_size(entry[0]);
+}
+
+/**
+ * @brief  Compare a stored name with text whose hash() is known: mostly a
+ *         mismatch of the hash or the length decides without the bytes.
+ */
+bool NameArena::equals(NameHandle name, const uint8_t *text, uint32_t length, NameHash hash) const
+{
+    if (name == NAME_EMPTY)
+        return length == 0;
+    return entry(name)[0] == length && stored_hash(name) == hash &&
+           memcmp(entry(name) + ENTRY_HEADER, text, length) == 0;
+}
+
+/**
+ * @brief  The name, 0-terminated.
+ */
+const uint8_t *NameArena::text(NameHandle name) const
+{
+    static const uint8_t empty[1] = {0};
+    return name == NAME_EMPTY ? empty : entry(name) + ENTRY_HEADER;
+}
+
+uint32_t NameArena::length(NameHandle name) const
+{
+    return name == NAME_EMPTY ? 0 : entry(name)[0] & ENTRY_LENGTH;
+}
+
+NameHash NameArena::stored_hash(NameHandle name) const
+{
+    NameHash h;
+    memcpy(&h, entry(name) + 1, sizeof(h));
+    return h;
+}
+
+/* compact() step 1: put each entry's handle after the move in its hash field */
+void NameArena::forward_all()
+{
+    uint32_t end = used.load(std::memory_order_acquire), to = 0;
+    for (uint32_t at = 0; at < end; at += entry_size(bytes[at]))
+    {
+        NameHandle forward = NAME_EMPTY;
+        if (!(bytes[at] & ENTRY_DEAD))
+        {
+            forward = (NameHandle)(to + 1);
+            to += entry_size(bytes[at]);
+        }
+        memcpy(bytes + at + 1, &forward, sizeof(forward));
+    }
+}
+
+/* compact() step 2, for each holder */
+NameHandle NameArena::forward(NameHandle name) const
+{
+    return name == NAME_EMPTY ? NAME_EMPTY : stored_hash(name);
+}
+
+/* compact() step 3: move the live entries down and restore their hashes */
+void NameArena::slide()
+{
+    uint32_t end = used.load(std::memory_order_acquire), to = 0;
+    for (uint32_t at = 0; at < end;)
+    {
+        uint32_t size = entry_size(bytes[at]);
+        if (!(bytes[at] & ENTRY_DEAD))
+        {
+            memmove(bytes + to, bytes + at, size);
+            NameHash h = hash(bytes + to + ENTRY_HEADER, bytes[to]);
+            memcpy(bytes + to + 1, &h, sizeof(h));
+            to += size;
+        }
+        at += size;
+    }
+    reclaimed_bytes += end - to;
+    compactions++;
+    dead_names = 0;
+    dead_bytes = 0;
+    used.store(to, std::memory_order_release);
+}
+
+void NameArena::get_stats(NameArenaStats *stats) const
+{
+    stats->capacity = capacity;
+    stats->used = used.load(std::memory_order_acquire);
+    stats->names = names.load(std::memory_order_relaxed);
+    stats->dead_names = dead_names;
+    stats->dead_bytes = dead_bytes;
+    stats->compactions = compactions;
+    stats->reclaimed_bytes = reclaimed_bytes;
+    stats->failed_adds = failed_adds.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief  FNV-1a, on target folded to the 16 bits of a NameHash.
+ */
+NameHash NameArena::hash(const uint8_t *name, uint32_t length)
+{
+    uint32_t h = 2166136261U;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        h ^= name[i];
+        h *= 16777619U;
+    }
+    if (sizeof(NameHash) < sizeof(h))
+        h ^= h >> 16;
+    return (NameHash)h;
+}
@@ -0,0 +1,74 @@
+#include "profiler.h"
+#include <atomic>
+#include <string.h>
+
+uint16_t profiler_counts[PROFILER_BUCKETS];
+
+static ProfilerInfo info;
+static std::atomic<bool> paused(true); // until the range is set up
+
+/**
+ * @brief  Size the histogram to the code and start the sampling timer.
+ */
+void Profiler_Init(void)
+{
+    uintptr_t start = 0, end = 0;
+    Profiler_CodeRange(&start, &end);
+    info.base = start;
+    info.shift = 2; // Thumb instructions are at least 2 bytes, buckets of 4 are plenty
+    while (((end - start + (1U << info.shift) - 1) >> info.shift) > PROFILER_BUCKETS)
+        info.shift++;
+    info.buckets = (uint32_t)((end - start + (1U << info.shift) - 1) >> info.shift);
+    info.anchor = (uintptr_t)&Profiler_Init;
+    info.hz = PROFILER_HZ;
+    Profiler_Clear();
+#if PROFILER_ENABLED
+    paused.store(false, std::memory_order_release);
+    Profiler_StartTimer(PROFILER_HZ);
+#endif
+}
+
+void Profiler_Sample(uintptr_t pc)
+{
+    if (paused.load(std::memory_order_relaxed))
+        return;
+    info.samples++;
+    uintptr_t offset = pc - info.base;
+    if (pc < info.base || (offset >> info.shift) >= info.buckets)
+    {
+        info.outside++;
+        return;
+    }
+    uint16_t &count = profiler_counts[offset >> info.shift];
+    if (count == UINT16_MAX)
+    {
+        for (uint32_t i = 0; i < info.buckets; i++)
+            profiler_counts[i] >>= 1;
+        info.halvings++;
+    }
+    count++;
+}
+
+/**
+ * @brief  Stop counting while the histogram is read, so a dump is one
+ *         consistent snapshot.
+ */
+void Profiler_Pause(bool pause)
+{
+    paused.store(pause, std::memory_order_release);
+}
+
+void Profiler_Clear(void)
+{
+    bool was_paused = paused.exchange(true, std::memory_order_acquire);
+    memset(profiler_counts, 0, sizeof(profiler_counts));
+    info.samples = 0;
+    info.outside = 0;
+    info.halvings = 0;
+    paused.store(was_paused, std::memory_order_release);
+}
+
+void Profiler_GetInfo(ProfilerInfo *out)
+{
+    *out = info;
+}
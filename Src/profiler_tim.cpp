@@ -0,0 +1,51 @@
+/* Profiler sampling on target: PROFILER_TIM runs at 1 MHz and interrupts at */
+/* PROFILER_HZ with the highest priority, so samples land in other interrupt */
+/* handlers as well. The handler reads the PC from the exception frame the */
+/* core stacked on entry. */
+
+#include "profiler.h"
+#include "stm32f4xx_it.h"
+
+/* Symbols provided by the linker script */
+extern "C" uint32_t _etext;
+
+void Profiler_CodeRange(uintptr_t *start, uintptr_t *end)
+{
+  *start = FLASH_BASE;
+  *end = (uintptr_t)&_etext;
+}
+
+void Profiler_StartTimer(uint32_t hz)
+{
+  PROFILER_TIM_CLK_ENABLE();
+  PROFILER_TIM->CR1 = 0;
+  PROFILER_TIM->PSC = PROFILER_TIM_CLOCK_HZ / 1000000U - 1; // 1 MHz
+  PROFILER_TIM->ARR = 1000000U / hz - 1;
+  PROFILER_TIM->EGR = TIM_EGR_UG;
+  PROFILER_TIM->SR = 0;
+  PROFILER_TIM->DIER = TIM_DIER_UIE;
+  HAL_NVIC_SetPriority(PROFILER_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(PROFILER_IRQn);
+  PROFILER_TIM->CR1 = TIM_CR1_CEN;
+}
+
+/* frame: R0-R3, R12, LR, PC, xPSR as stacked on exception entry */
+extern "C" void Profiler_TimerSample(const uint32_t *frame)
+{
+  PROFILER_TIM->SR = ~TIM_SR_UIF;
+  (void)PROFILER_TIM->SR; // the flag must be clear before the handler returns
+  Profiler_Sample(frame[6]);
+}
+
+/**
+ * @brief  Pass the stack the interrupted code was using to
+ *         Profiler_TimerSample(), which returns straight to it.
+ */
+extern "C" __attribute__((naked)) void PROFILER_IRQHandler(void)
+{
+  __asm volatile("tst lr, #4                 \n"
+                 "ite eq                     \n"
+                 "mrseq r0, msp              \n"
+                 "mrsne r0, psp              \n"
+                 "b Profiler_TimerSample     \n");
+}
@@ -0,0 +1,408 @@
+#include "replication.h"
+#include "account_store.h"
+#include "crc32.h"
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPL_MAGIC                      0x5EB1U
+#define REPL_FRAME_DATA                 1U
+#define REPL_FRAME_ACK                  2U /* seq: next record the backup expects */
+#define REPL_FRAME_HELLO                3U /* backup without a usable position */
+#define REPL_RX_RING_SIZE               256U
+#define REPL_NO_ACCOUNT                 0xFFFFU
+
+typedef struct
+{
+    uint16_t magic;
+    uint8_t type;
+    uint8_t length; // payload bytes
+    uint32_t seq;
+} ReplHeader;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t reserved[3];
+    AccountRecord record;
+} ReplData;
+
+typedef struct
+{
+    uint32_t tick; // when it was logged, for the lag
+    uint16_t account;
+    uint8_t op;
+} ReplLogEntry;
+
+/* Header, payload, CRC-32 of both */
+#define REPL_FRAME_MAX                  (sizeof(ReplHeader) + sizeof(ReplData) + sizeof(uint32_t))
+
+static_assert(sizeof(ReplHeader) == 8 && sizeof(ReplData) == 68, "frame layout is the wire format");
+static_assert(REPL_LOG_SIZE > MAX_ACCOUNTS, "a snapshot must fit the log");
+static_assert((REPL_RX_RING_SIZE & (REPL_RX_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+UART_HandleTypeDef ReplHandle;
+
+static ConsoleBank *repl_bank = nullptr;
+static ReplRole role = REPL_ROLE_NONE;
+static ReplicationStats stats;
+
+/* Receive ring, filled by the UART interrupt one byte at a time */
+static uint8_t rx_byte;
+static uint8_t rx_ring[REPL_RX_RING_SIZE];
+static std::atomic<uint16_t> rx_head(0);
+static std::atomic<uint16_t> rx_tail(0);
+static uint8_t rx_frame[REPL_FRAME_MAX];
+static uint32_t rx_len = 0;
+
+static uint8_t tx_frame[REPL_FRAME_MAX];
+static std::atomic<bool> tx_busy(false);
+
+/* Primary: records acked_seq .. next_seq - 1 are in the log */
+static ReplLogEntry log_entries[REPL_LOG_SIZE];
+static uint32_t send_seq;           // next record to transmit
+static uint32_t progress_tick;      // last acknowledgement or (re)start of sending
+static bool need_resync = false;
+
+/* Backup */
+static uint32_t expected_seq;
+static bool synced = false;
+static bool ack_pending = false;
+static uint32_t hello_tick;
+
+static void start_receive(void)
+{
+    HAL_UART_Receive_IT(&ReplHandle, &rx_byte, 1);
+}
+
+static bool send_frame(uint8_t type, uint32_t seq, const void *payload, uint8_t length)
+{
+    if (tx_busy.load(std::memory_order_acquire))
+        return false;
+    ReplHeader header = {REPL_MAGIC, type, length, seq};
+    memcpy(tx_frame, &header, sizeof(header));
+    memcpy(tx_frame + sizeof(header), payload, length);
+    uint32_t crc = crc32_compute(tx_frame, sizeof(header) + length);
+    memcpy(tx_frame + sizeof(header) + length, &crc, sizeof(crc));
+    tx_busy.store(true, std::memory_order_release);
+    if (HAL_UART_Transmit_IT(&ReplHandle, tx_frame, sizeof(header) + length + sizeof(crc)) != HAL_OK)
+    {
+        tx_busy.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+/* Wrap-safe sequence comparison */
+static int32_t seq_diff(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b);
+}
+
+static void append(uint8_t op, uint16_t account)
+{
+    ReplLogEntry &e = log_entries[stats.next_seq % REPL_LOG_SIZE];
+    e.tick = HAL_GetTick();
+    e.account = account;
+    e.op = op;
+    stats.next_seq++;
+}
+
+/**
+ * @brief  Drop the log and queue a SYNC record followed by every account
+ */
+static void start_resync(void)
+{
+    stats.acked_seq = stats.next_seq;
+    append(REPL_OP_SYNC, REPL_NO_ACCOUNT);
+    for (uint32_t id = 0; id < repl_bank->slots(); id++)
+        if (repl_bank->in_use(id))
+            append(REPL_OP_SNAPSHOT, (uint16_t)id);
+    send_seq = stats.acked_seq;
+    progress_tick = HAL_GetTick();
+    need_resync = false;
+    stats.resyncs++;
+}
+
+static void apply(const AccountRecord &record)
+{
+    ConsoleBank &bank = *repl_bank;
+    uint32_t id = record.account_id;
+    if (record.magic != ACCOUNT_RECORD_MAGIC || id >= bank.capacity())
+        return;
+    if (bank.in_use(id))
+        bank[id].from_record(record);
+    else if (!bank.restore(record))
+        return;
+    AccountStore_Update(bank[id]);
+}
+
+static void handle_frame(const ReplHeader &header, const uint8_t *payload)
+{
+    if (role == REPL_ROLE_PRIMARY)
+    {
+        if (header.type == REPL_FRAME_HELLO)
+            need_resync = true;
+        else if (header.type == REPL_FRAME_ACK)
+        {
+            if (seq_diff(header.seq, stats.acked_seq) > 0 && seq_diff(header.seq, stats.next_seq) <= 0)
+            {
+                stats.acked_records += header.seq - stats.acked_seq;
+                stats.acked_seq = header.seq;
+                progress_tick = HAL_GetTick();
+                if (seq_diff(send_seq, stats.acked_seq) < 0)
+                    send_seq = stats.acked_seq;
+            }
+            else if (seq_diff(header.seq, stats.next_seq) > 0)
+                need_resync = true; // the backup followed an earlier primary further
+            /* Older acknowledgements are for records a resync replaced; the */
+            /* SYNC at its start puts the backup back in step */
+        }
+        return;
+    }
+
+    if (header.type != REPL_FRAME_DATA || header.length != sizeof(ReplData))
+        return;
+    ReplData data;
+    memcpy(&data, payload, sizeof(data));
+    stats.last_rx_tick = HAL_GetTick();
+    if (data.op == REPL_OP_SYNC)
+    {
+        expected_seq = header.seq + 1;
+        synced = true;
+    }
+    else if (!synced)
+        return;
+    else if (header.seq == expected_seq)
+    {
+        apply(data.record);
+        expected_seq++;
+        stats.applied++;
+    }
+    else if (seq_diff(header.seq, expected_seq) < 0)
+        stats.duplicates++;
+    else
+        stats.gaps++;
+    ack_pending = true;
+}
+
+/**
+ * @brief  Take received bytes off the ring and handle every complete frame.
+ *         Bad frames are skipped by hunting for the next magic number.
+ */
+static void receive_frames(void)
+{
+    uint16_t tail = rx_tail.load(std::memory_order_relaxed);
+    while (tail != rx_head.load(std::memory_order_acquire))
+    {
+        rx_frame[rx_len++] = rx_ring[tail];
+        tail = (tail + 1) % REPL_RX_RING_SIZE;
+        rx_tail.store(tail, std::memory_order_release);
+
+        while (rx_len > 0)
+        {
+            ReplHeader header;
+            bool bad = false;
+            if (rx_len >= 2)
+            {
+                uint16_t magic = (uint16_t)(rx_frame[0] | rx_frame[1] << 8);
+                bad = magic != REPL_MAGIC;
+            }
+            else if (rx_frame[0] != (REPL_MAGIC & 0xFF))
+                bad = true;
+            if (!bad && rx_len >= sizeof(header))
+            {
+                memcpy(&header, rx_frame, sizeof(header));
+                uint32_t total = sizeof(header) + header.length + sizeof(uint32_t);
+                if (header.length > sizeof(ReplData))
+                    bad = true;
+                else if (rx_len == total)
+                {
+                    uint32_t crc;
+                    memcpy(&crc, rx_frame + total - sizeof(crc), sizeof(crc));
+                    if (crc == crc32_compute(rx_frame, total - sizeof(crc)))
+                    {
+                        handle_frame(header, rx_frame + sizeof(header));
+                        rx_len = 0;
+                        break;
+                    }
+                    bad = true;
+                }
+            }
+            if (!bad)
+                break;
+            stats.bad_frames += rx_len >= sizeof(header) ? 1 : 0;
+            memmove(rx_frame, rx_frame + 1, --rx_len);
+        }
+    }
+}
+
+static void service_primary(void)
+{
+    if (need_resync)
+        start_resync();
+    uint32_t now = HAL_GetTick();
+
+    if (stats.acked_seq != stats.next_seq)
+    {
+        if (now - progress_tick >= REPL_RETRY_MS && send_seq != stats.acked_seq)
+        {
+            send_seq = stats.acked_seq; // go back N
+            progress_tick = now;
+            stats.retransmits++;
+        }
+        stats.lag_ms = now - log_entries[stats.acked_seq % REPL_LOG_SIZE].tick;
+        if (stats.lag_ms > stats.max_lag_ms)
+            stats.max_lag_ms = stats.lag_ms;
+    }
+    else
+        stats.lag_ms = 0;
+
+    if (send_seq == stats.next_seq)
+        return;
+    const ReplLogEntry &e = log_entries[send_seq % REPL_LOG_SIZE];
+    ReplData data;
+    memset(&data, 0, sizeof(data));
+    data.op = e.op;
+    if (e.account != REPL_NO_ACCOUNT)
+        (*repl_bank)[e.account].to_record(&data.record); // current state: newer changes ride along
+    if (send_frame(REPL_FRAME_DATA, send_seq, &data, sizeof(data)))
+    {
+        if (send_seq == stats.acked_seq)
+            progress_tick = now;
+        send_seq++;
+        stats.frames_sent++;
+    }
+}
+
+static void service_backup(uint32_t now)
+{
+    if (ack_pending && send_frame(REPL_FRAME_ACK, expected_seq, nullptr, 0))
+        ack_pending = false;
+    if (!synced && now - hello_tick >= REPL_HELLO_MS && send_frame(REPL_FRAME_HELLO, 0, nullptr, 0))
+        hello_tick = now;
+}
+
+void Replication_Init(ConsoleBank &bank)
+{
+    repl_bank = &bank;
+    memset(&stats, 0, sizeof(stats));
+    stats.start_tick = HAL_GetTick();
+    hello_tick = stats.start_tick - REPL_HELLO_MS;
+
+#ifdef HOST_BUILD
+    const char *env = getenv("BANK_ROLE");
+    bool backup = env != nullptr && strcmp(env, "backup") == 0;
+#else
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    REPL_ROLE_GPIO_CLK_ENABLE();
+    GPIO_InitStruct.Pin = REPL_ROLE_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(REPL_ROLE_GPIO_PORT, &GPIO_InitStruct);
+    bool backup = HAL_GPIO_ReadPin(REPL_ROLE_GPIO_PORT, REPL_ROLE_PIN) == GPIO_PIN_RESET;
+#endif
+
+    ReplHandle.Instance = REPL_USART;
+    ReplHandle.Init.BaudRate = REPL_BAUD;
+    ReplHandle.Init.WordLength = UART_WORDLENGTH_8B;
+    ReplHandle.Init.StopBits = UART_STOPBITS_1;
+    ReplHandle.Init.Parity = UART_PARITY_NONE;
+    ReplHandle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    ReplHandle.Init.Mode = UART_MODE_TX_RX;
+    ReplHandle.Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&ReplHandle) != HAL_OK)
+    {
+        role = REPL_ROLE_NONE;
+        return;
+    }
+    role = backup ? REPL_ROLE_BACKUP : REPL_ROLE_PRIMARY;
+    /* A primary starts its sequence over, after a restart too: the SYNC in */
+    /* front of a snapshot puts a backup that is further along back in step */
+    need_resync = !backup;
+    start_receive();
+}
+
+ReplRole Replication_Role(void)
+{
+    return role;
+}
+
+/**
+ * @brief  Primary: record that the account changed. Called after the change
+ *         is applied; the backup receives the account's state at send time.
+ */
+void Replication_Log(uint8_t op, const BankAccount &account)
+{
+    if (role != REPL_ROLE_PRIMARY || need_resync)
+        return; // a pending snapshot carries this change too
+    if (stats.next_seq - stats.acked_seq >= REPL_LOG_SIZE)
+    {
+        need_resync = true; // the backup is too far behind, or absent
+        return;
+    }
+    append(op, (uint16_t)account.get_account_id());
+}
+
+/**
+ * @brief  Background work, called from the main loop while idle
+ */
+void Replication_Service(void)
+{
+    if (role == REPL_ROLE_NONE)
+        return;
+    receive_frames();
+    if (role == REPL_ROLE_PRIMARY)
+        service_primary();
+    else
+        service_backup(HAL_GetTick());
+}
+
+/**
+ * @brief  Make a backup the primary, continuing its sequence with a full
+ *         snapshot for whichever board is backup now or connects later.
+ * @retval false if this board is not a backup
+ */
+bool Replication_Promote(void)
+{
+    if (role != REPL_ROLE_BACKUP)
+        return false;
+    stats.next_seq = expected_seq;
+    stats.acked_seq = expected_seq;
+    send_seq = expected_seq;
+    stats.start_tick = HAL_GetTick();
+    stats.acked_records = 0;
+    need_resync = true;
+    role = REPL_ROLE_PRIMARY;
+    return true;
+}
+
+void Replication_GetStats(ReplicationStats *out)
+{
+    *out = stats;
+    if (role == REPL_ROLE_BACKUP)
+        out->acked_seq = expected_seq;
+}
+
+void Replication_RxCpltCallback(void)
+{
+    uint16_t head = rx_head.load(std::memory_order_relaxed);
+    uint16_t next = (head + 1) % REPL_RX_RING_SIZE;
+    if (next != rx_tail.load(std::memory_order_acquire))
+    {
+        rx_ring[head] = rx_byte;
+        rx_head.store(next, std::memory_order_release);
+    }
+    start_receive(); // a full ring drops the byte; the frame CRC catches it
+}
+
+void Replication_TxCpltCallback(void)
+{
+    tx_busy.store(false, std::memory_order_release);
+}
+
+void Replication_ErrorCallback(void)
+{
+    if (ReplHandle.RxState == HAL_UART_STATE_READY)
+        start_receive();
+}
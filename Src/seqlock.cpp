@@ -0,0 +1,32 @@
+#include "seqlock.h"
+
+SeqLock::SeqLock()
+    : begun(0), ended(0)
+{
+}
+
+void SeqLock::write_begin()
+{
+    /* acq_rel keeps the protected stores from moving above the increment */
+    begun.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void SeqLock::write_end()
+{
+    ended.fetch_add(1, std::memory_order_release);
+}
+
+uint32_t SeqLock::read_begin() const
+{
+    return ended.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief  Check a read section started with read_begin().
+ * @retval true if a write overlapped the read and it must be repeated
+ */
+bool SeqLock::read_retry(uint32_t start) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return begun.load(std::memory_order_relaxed) != start;
+}
@@ -0,0 +1,151 @@
+#include "session_table.h"
+#include <string.h>
+
+SessionTable::SessionTable()
+{
+    seed = 0;
+    clear();
+}
+
+void SessionTable::clear()
+{
+    memset(entries, 0, sizeof(entries));
+}
+
+/* True while now has not reached tick; wraps with the tick counter */
+bool SessionTable::before(uint32_t tick, uint32_t now)
+{
+    return (int32_t)(tick - now) > 0;
+}
+
+SessionTable::Entry *SessionTable::find(uint32_t token)
+{
+    for (uint32_t i = 0; i < SESSION_TOKENS_MAX; i++)
+        if (entries[i].token == token)
+            return &entries[i];
+    return nullptr;
+}
+
+uint32_t SessionTable::next_token(uint32_t entropy)
+{
+    uint32_t token;
+    do
+    {
+        seed += entropy + 0x9E3779B9U;
+        token = seed;
+        token ^= token >> 16;
+        token *= 0x45d9f3bU;
+        token ^= token >> 16;
+        token *= 0x45d9f3bU;
+        token ^= token >> 16;
+    } while (token == 0 || find(token) != nullptr);
+    return token;
+}
+
+/**
+ * @brief  Start a session on the account. Earlier tokens of the account are
+ *         revoked; with the table full, the token closest to expiry is.
+ * @param  entropy: something the caller cannot predict, e.g. the cycle counter
+ * @retval the session's token, never 0
+ */
+uint32_t SessionTable::issue(uint16_t account_id, uint32_t now, uint32_t entropy)
+{
+    Entry *slot = nullptr;
+    for (uint32_t i = 0; i < SESSION_TOKENS_MAX; i++)
+    {
+        Entry &e = entries[i];
+        if (e.token != 0 && (e.account_id == account_id || !before(e.expires, now)))
+            e.token = 0;
+        if (e.token == 0)
+        {
+            if (slot == nullptr || slot->token != 0)
+                slot = &e;
+        }
+        else if (slot == nullptr || (slot->token != 0 && before(slot->expires, e.expires)))
+            slot = &e;
+    }
+    slot->token = next_token(entropy);
+    slot->account_id = account_id;
+    slot->deadline = now + SESSION_TIMEOUT;
+    slot->expires = slot->deadline;
+    slot->active = true;
+    return slot->token;
+}
+
+/**
+ * @brief  The running session took a command: move its deadline on.
+ */
+void SessionTable::touch(uint32_t token, uint32_t now)
+{
+    Entry *e = token != 0 ? find(token) : nullptr;
+    if (e == nullptr || !e->active)
+        return;
+    e->deadline = now + SESSION_TIMEOUT;
+    e->expires = e->deadline;
+}
+
+/**
+ * @brief  The session ended on an input timeout: keep its token for
+ *         SESSION_RESUME_WAIT, but not past the session deadline.
+ */
+void SessionTable::suspend(uint32_t token, uint32_t now)
+{
+    Entry *e = token != 0 ? find(token) : nullptr;
+    if (e == nullptr)
+        return;
+    e->active = false;
+    e->expires = before(e->deadline, now + SESSION_RESUME_WAIT) ? now + SESSION_RESUME_WAIT : e->deadline;
+}
+
+/**
+ * @brief  Take up a suspended session again.
+ * @param  time_left: set to the time until the session deadline, ms
+ * @retval false if the token is unknown, expired or its session is running
+ */
+bool SessionTable::resume(uint32_t token, uint32_t now, uint16_t *account_id, uint32_t *time_left)
+{
+    Entry *e = token != 0 ? find(token) : nullptr;
+    if (e == nullptr || e->active)
+        return false;
+    if (!before(e->expires, now))
+    {
+        e->token = 0;
+        return false;
+    }
+    e->active = true;
+    e->expires = e->deadline;
+    *account_id = e->account_id;
+    *time_left = e->deadline - now;
+    return true;
+}
+
+void SessionTable::revoke(uint32_t token)
+{
+    Entry *e = token != 0 ? find(token) : nullptr;
+    if (e != nullptr)
+        e->token = 0;
+}
+
+/**
+ * @brief  Read a token as typed after R: exactly 8 hex digits.
+ * @retval the token, 0 if malformed
+ */
+uint32_t parse_session_token(const uint8_t *text)
+{
+    uint32_t token = 0;
+    for (uint32_t i = 0; i < SESSION_TOKEN_DIGITS; i++)
+    {
+        uint8_t c = text[i];
+        uint32_t v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            return 0;
+        token = (token << 4) | v;
+    }
+    return text[SESSION_TOKEN_DIGITS] == 0 ? token : 0;
+}
@@ -0,0 +1,133 @@
+/* Stack painting, high-water mark and fault recording. */
+/* The free RAM between the heap and the stack pointer is filled with a known */
+/* pattern at boot; the deepest overwritten word gives the stack high-water mark. */
+
+#include "main.h"
+#include "stack_monitor.h"
+#include <unistd.h>
+
+/* Symbols provided by the linker script */
+extern "C" uint32_t _estack;
+extern "C" uint32_t _Min_Stack_Size;
+extern "C" uint32_t _end;
+
+static uint32_t *stack_floor = nullptr;
+static FaultRecord fault_record NOINIT;
+
+/* Lowest address the stack may grow to: the current end of the heap */
+static uint32_t *heap_end(void)
+{
+  uint32_t *brk = (uint32_t *)sbrk(0);
+  if (brk == (uint32_t *)-1 || brk < &_end)
+    brk = &_end;
+  return (uint32_t *)(((uint32_t)brk + 3U) & ~3U);
+}
+
+/**
+ * @brief  Fill the unused stack with STACK_PAINT_PATTERN. Call first thing in main().
+ * @retval None
+ */
+void Stack_Paint(void)
+{
+  stack_floor = heap_end();
+  /* Leave a margin below the current SP for this function's own frame */
+  uint32_t *top = (uint32_t *)(__get_MSP() - 64U);
+
+  for (uint32_t *p = stack_floor; p < top; p++)
+    *p = STACK_PAINT_PATTERN;
+}
+
+/**
+ * @brief  Total stack space between the heap end at boot and the top of RAM.
+ */
+uint32_t Stack_GetSize(void)
+{
+  if (stack_floor == nullptr)
+    return 0;
+  return (uint32_t)&_estack - (uint32_t)stack_floor;
+}
+
+/**
+ * @brief  Stack size reserved by the linker script (_Min_Stack_Size).
+ */
+uint32_t Stack_GetReserved(void)
+{
+  return (uint32_t)&_Min_Stack_Size;
+}
+
+/**
+ * @brief  Deepest stack usage in bytes since Stack_Paint().
+ */
+uint32_t Stack_GetHighWaterMark(void)
+{
+  if (stack_floor == nullptr)
+    return 0;
+
+  /* Skip anything the heap has claimed since boot */
+  uint32_t *p = heap_end();
+  if (p < stack_floor)
+    p = stack_floor;
+  while (p < &_estack && *p == STACK_PAINT_PATTERN)
+    p++;
+  return (uint32_t)&_estack - (uint32_t)p;
+}
+
+const FaultRecord *Fault_GetLastRecord(void)
+{
+  if (fault_record.magic != FAULT_RECORD_MAGIC)
+    return nullptr;
+  return &fault_record;
+}
+
+void Fault_ClearRecord(void)
+{
+  fault_record.magic = 0;
+}
+
+/**
+ * @brief  Called from the fault handlers with the stacked exception frame.
+ *         Records which stack was in use and whether it overflowed, then resets.
+ * @param  frame: stack pointer at exception entry (MSP or PSP)
+ * @param  exc_return: EXC_RETURN value from LR
+ * @param  fault_type: one of FAULT_HARD, FAULT_MEMMANAGE, FAULT_BUS, FAULT_USAGE
+ * @retval None
+ */
+void Fault_Capture(uint32_t *frame, uint32_t exc_return, uint32_t fault_type)
+{
+  const uint32_t sp = (uint32_t)frame;
+  const uint32_t cfsr = SCB->CFSR;
+
+  fault_record.fault_type = fault_type;
+  fault_record.stack = (exc_return & 0x4U) ? FAULT_STACK_PSP : FAULT_STACK_MSP;
+  fault_record.sp = sp;
+  fault_record.cfsr = cfsr;
+  fault_record.hfsr = SCB->HFSR;
+
+  /* A stacking error means the exception frame itself could not be pushed */
+  bool overflowed = (cfsr & (SCB_CFSR_MSTKERR_Msk | SCB_CFSR_STKERR_Msk)) != 0;
+  if (fault_record.stack == FAULT_STACK_MSP && stack_floor != nullptr)
+  {
+    /* As in Stack_GetHighWaterMark(), heap the program grew since boot */
+    /* (e.g. newlib's printf buffers) has overwritten the paint below it */
+    uint32_t *floor = heap_end();
+    if (floor < stack_floor)
+      floor = stack_floor;
+    overflowed = overflowed || sp < (uint32_t)floor || (floor < &_estack && *floor != STACK_PAINT_PATTERN);
+  }
+  fault_record.overflowed = overflowed ? 1U : 0U;
+
+  /* Only trust the frame contents if it lies inside RAM */
+  if (sp >= SRAM1_BASE && sp + 32U <= (uint32_t)&_estack)
+  {
+    fault_record.lr = frame[5];
+    fault_record.pc = frame[6];
+  }
+  else
+  {
+    fault_record.lr = 0;
+    fault_record.pc = 0;
+  }
+  fault_record.magic = FAULT_RECORD_MAGIC;
+
+  NVIC_SystemReset();
+}
@@ -0,0 +1,93 @@
+#include "standing_orders.h"
+#include "account_store.h"
+#include "replication.h"
+#include <string.h>
+
+static ConsoleBank *orders_bank = nullptr;
+static TimerWheel *orders_timers = nullptr;
+static StandingOrder orders[STANDING_ORDERS_MAX];
+static TimerHandle order_timers[STANDING_ORDERS_MAX]; // TIMER_NONE for a free slot
+static uint32_t free_orders[STANDING_ORDERS_MAX];     // stack of free slots
+static uint32_t free_count = 0;
+
+static void run_order(uint32_t order)
+{
+    StandingOrder &o = orders[order];
+    ConsoleBank &bank = *orders_bank;
+    if (!bank.in_use(o.from) || !bank.in_use(o.to))
+        return;
+    if (BankAccount::transfer(bank[o.from], bank[o.to], o.amount))
+    {
+        AccountStore_Update(bank[o.from]);
+        AccountStore_Update(bank[o.to]);
+        Replication_Log(REPL_OP_TRANSFER, bank[o.from]);
+        Replication_Log(REPL_OP_TRANSFER, bank[o.to]);
+        o.executed++;
+    }
+    else
+        o.refused++;
+}
+
+void StandingOrders_Init(ConsoleBank &bank, TimerWheel &timers)
+{
+    orders_bank = &bank;
+    orders_timers = &timers;
+    memset(orders, 0, sizeof(orders));
+    for (uint32_t i = 0; i < STANDING_ORDERS_MAX; i++)
+    {
+        order_timers[i] = TIMER_NONE;
+        free_orders[i] = STANDING_ORDERS_MAX - 1 - i; // lowest numbers first
+    }
+    free_count = STANDING_ORDERS_MAX;
+}
+
+/**
+ * @brief  Start a transfer of amount from one account to another every
+ *         period_s seconds, the first one period_s from now.
+ * @retval order number, or STANDING_ORDER_NONE if there is no free order
+ *         or timer, or the arguments are invalid
+ */
+uint32_t StandingOrders_Create(uint32_t from, uint32_t to, amount_t amount, uint32_t period_s)
+{
+    if (from == to || amount <= 0 || period_s < STANDING_ORDER_MIN_PERIOD_S || period_s > STANDING_ORDER_MAX_PERIOD_S)
+        return STANDING_ORDER_NONE;
+    if (free_count == 0)
+        return STANDING_ORDER_NONE;
+    uint32_t order = free_orders[free_count - 1];
+    uint32_t period_ms = period_s * 1000U;
+    TimerHandle timer = orders_timers->schedule(period_ms, period_ms, run_order, order);
+    if (timer == TIMER_NONE)
+        return STANDING_ORDER_NONE;
+    free_count--;
+    orders[order] = {from, to, amount, period_s, 0, 0};
+    order_timers[order] = timer;
+    return order;
+}
+
+/**
+ * @retval false unless the order exists and pays from owner
+ */
+bool StandingOrders_Cancel(uint32_t order, uint32_t owner)
+{
+    if (order >= STANDING_ORDERS_MAX || order_timers[order] == TIMER_NONE || orders[order].from != owner)
+        return false;
+    orders_timers->cancel(order_timers[order]);
+    order_timers[order] = TIMER_NONE;
+    free_orders[free_count++] = order;
+    return true;
+}
+
+/**
+ * @retval the order, or nullptr if the slot is free
+ */
+const StandingOrder *StandingOrders_Get(uint32_t order)
+{
+    if (order >= STANDING_ORDERS_MAX || order_timers[order] == TIMER_NONE)
+        return nullptr;
+    return &orders[order];
+}
+
+uint32_t StandingOrders_Active(void)
+{
+    return STANDING_ORDERS_MAX - free_count;
+}
@@ -47,69 +47,78 @@
 //   __HAL_RCC_PWR_CLK_ENABLE();
 // }
 /**
-  * @brief UART MSP Initialization 
-  *        This function configures the hardware resources used in this example: 
-  *           - Peripheral's clock enable
-  *           - Peripheral's GPIO Configuration  
-  *           - NVIC configuration for UART interrupt request enable
+  * @brief CRC MSP Initialization
+  * @param hcrc: CRC handle pointer
+  * @retval None
+  */
+void HAL_CRC_MspInit(CRC_HandleTypeDef *hcrc)
+{
+  __HAL_RCC_CRC_CLK_ENABLE();
+}
+
+/**
+  * @brief I2C MSP Initialization
+  *        Clock, open-drain pins and event/error interrupts of the I2C bus
+  *        to the external FRAM/EEPROM. The TX DMA stream is set up in
+  *        ExtMem_Init().
+  * @param hi2c: I2C handle pointer
+  * @retval None
+  */
+void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c)
+{
+  GPIO_InitTypeDef  GPIO_InitStruct;
+
+  EXT_MEM_GPIO_CLK_ENABLE();
+  EXT_MEM_I2C_CLK_ENABLE();
+
+  GPIO_InitStruct.Pin       = EXT_MEM_SCL_PIN | EXT_MEM_SDA_PIN;
+  GPIO_InitStruct.Mode      = GPIO_MODE_AF_OD;
+  GPIO_InitStruct.Pull      = GPIO_PULLUP;
+  GPIO_InitStruct.Speed     = GPIO_SPEED_FAST;
+  GPIO_InitStruct.Alternate = EXT_MEM_AF;
+  HAL_GPIO_Init(EXT_MEM_GPIO_PORT, &GPIO_InitStruct);
+
+  HAL_NVIC_SetPriority(EXT_MEM_EV_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(EXT_MEM_EV_IRQn);
+  HAL_NVIC_SetPriority(EXT_MEM_ER_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(EXT_MEM_ER_IRQn);
+}
+
+/**
+  * @brief UART MSP Initialization
+  *        Clock, pins and interrupt of the replication link, the only UART
+  *        left on the HAL; the console is set up by Uart<>::init().
   * @param huart: UART handle pointer
   * @retval None
   */
 void HAL_UART_MspInit(UART_HandleTypeDef *huart)
-{  
+{
   GPIO_InitTypeDef  GPIO_InitStruct;
-  
-  /*##-1- Enable peripherals and GPIO Clocks #################################*/
-  /* Enable GPIO TX/RX clock */
-  USARTx_TX_GPIO_CLK_ENABLE();
-  USARTx_RX_GPIO_CLK_ENABLE();
-  /* Enable USART1 clock */
-  USARTx_CLK_ENABLE(); 
-  
-  /*##-2- Configure peripheral GPIO ##########################################*/  
-  /* UART TX GPIO pin configuration  */
-  GPIO_InitStruct.Pin       = USARTx_TX_PIN;
+
+  /* Replication link: both pins on one port, same settings as the console */
+  REPL_GPIO_CLK_ENABLE();
+  REPL_USART_CLK_ENABLE();
+  GPIO_InitStruct.Pin       = REPL_TX_PIN | REPL_RX_PIN;
   GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
   GPIO_InitStruct.Pull      = GPIO_PULLUP;
   GPIO_InitStruct.Speed     = GPIO_SPEED_FAST;
-  GPIO_InitStruct.Alternate = USARTx_TX_AF;
-  
-  HAL_GPIO_Init(USARTx_TX_GPIO_PORT, &GPIO_InitStruct);
-    
-  /* UART RX GPIO pin configuration  */
-  GPIO_InitStruct.Pin = USARTx_RX_PIN;
-  GPIO_InitStruct.Alternate = USARTx_RX_AF;
-    
-  HAL_GPIO_Init(USARTx_RX_GPIO_PORT, &GPIO_InitStruct);
-    
-  /*##-3- Configure the NVIC for UART ########################################*/
-  /* NVIC for USART1 */
-  HAL_NVIC_SetPriority(USARTx_IRQn, 0, 1);
-  HAL_NVIC_EnableIRQ(USARTx_IRQn);
+  GPIO_InitStruct.Alternate = REPL_AF;
+  HAL_GPIO_Init(REPL_GPIO_PORT, &GPIO_InitStruct);
+  HAL_NVIC_SetPriority(REPL_IRQn, 1, 2);
+  HAL_NVIC_EnableIRQ(REPL_IRQn);
 }
 
 /**
-  * @brief UART MSP De-Initialization 
-  *        This function frees the hardware resources used in this example:
-  *          - Disable the Peripheral's clock
-  *          - Revert GPIO and NVIC configuration to their default state
+  * @brief UART MSP De-Initialization
   * @param huart: UART handle pointer
   * @retval None
   */
 void HAL_UART_MspDeInit(UART_HandleTypeDef *huart)
 {
-  /*##-1- Reset peripherals ##################################################*/
-  USARTx_FORCE_RESET();
-  USARTx_RELEASE_RESET();
-
-  /*##-2- Disable peripherals and GPIO Clocks ################################*/
-  /* Configure UART Tx as alternate function */
-  HAL_GPIO_DeInit(USARTx_TX_GPIO_PORT, USARTx_TX_PIN);
-  /* Configure UART Rx as alternate function */
-  HAL_GPIO_DeInit(USARTx_RX_GPIO_PORT, USARTx_RX_PIN);
-  
-  /*##-3- Disable the NVIC for UART ##########################################*/
-  HAL_NVIC_DisableIRQ(USARTx_IRQn);
+  REPL_USART_FORCE_RESET();
+  REPL_USART_RELEASE_RESET();
+  HAL_GPIO_DeInit(REPL_GPIO_PORT, REPL_TX_PIN | REPL_RX_PIN);
+  HAL_NVIC_DisableIRQ(REPL_IRQn);
 }
 
 /**
@@ -21,6 +21,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "stm32f4xx_it.h"   
+#include "stack_monitor.h"
 
 /** @addtogroup STM32F4xx_HAL_Examples
   * @{
@@ -33,9 +34,20 @@
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
+/* Pass the active stack pointer and EXC_RETURN to Fault_Capture(), which
+   records the fault in .noinit RAM and resets the MCU */
+#define FAULT_CAPTURE(__TYPE__)                                     \
+  __asm volatile("tst lr, #4        \n"                              \
+                 "ite eq            \n"                              \
+                 "mrseq r0, msp     \n"                              \
+                 "mrsne r0, psp     \n"                              \
+                 "mov r1, lr        \n"                              \
+                 "mov r2, %0        \n"                              \
+                 "b Fault_Capture   \n" ::"i"(__TYPE__))
 /* Private variables ---------------------------------------------------------*/
-/* UART handler declared in "main.c" file */
-extern UART_HandleTypeDef UartHandle;
+/* External memory handles declared in "ext_mem.cpp" */
+extern I2C_HandleTypeDef ExtMemHandle;
+extern DMA_HandleTypeDef ExtMemDmaTxHandle;
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 
@@ -57,12 +69,10 @@ void NMI_Handler(void)
   * @param  None
   * @retval None
   */
-void HardFault_Handler(void)
+__attribute__((naked)) void HardFault_Handler(void)
 {
-  /* Go to infinite loop when Hard Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the faulting stack when Hard Fault exception occurs */
+  FAULT_CAPTURE(FAULT_HARD);
 }
 
 /**
@@ -70,12 +80,10 @@ void HardFault_Handler(void)
   * @param  None
   * @retval None
   */
-void MemManage_Handler(void)
+__attribute__((naked)) void MemManage_Handler(void)
 {
-  /* Go to infinite loop when Memory Manage exception occurs */
-  while (1)
-  {
-  }
+  /* Record the faulting stack when Memory Manage exception occurs */
+  FAULT_CAPTURE(FAULT_MEMMANAGE);
 }
 
 /**
@@ -83,12 +91,10 @@ void MemManage_Handler(void)
   * @param  None
   * @retval None
   */
-void BusFault_Handler(void)
+__attribute__((naked)) void BusFault_Handler(void)
 {
-  /* Go to infinite loop when Bus Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the faulting stack when Bus Fault exception occurs */
+  FAULT_CAPTURE(FAULT_BUS);
 }
 
 /**
@@ -96,12 +102,10 @@ void BusFault_Handler(void)
   * @param  None
   * @retval None
   */
-void UsageFault_Handler(void)
+__attribute__((naked)) void UsageFault_Handler(void)
 {
-  /* Go to infinite loop when Usage Fault exception occurs */
-  while (1)
-  {
-  }
+  /* Record the faulting stack when Usage Fault exception occurs */
+  FAULT_CAPTURE(FAULT_USAGE);
 }
 
 /**
@@ -147,16 +151,27 @@ void SysTick_Handler(void)
 /*  available peripheral interrupt handler's name please refer to the startup */
 /*  file (startup_stm32f4xx.s).                                               */
 /******************************************************************************/
+/* The console and replication link UART handlers are in main.cpp */
+
 /**
-  * @brief  This function handles UART interrupt request.  
+  * @brief  This function handles the external memory I2C event, error and
+  *         TX DMA interrupt requests.
   * @param  None
   * @retval None
-  * @Note   This function is redefined in "main.h" and related to DMA stream 
-  *         used for USART data transmission     
   */
-void USARTx_IRQHandler(void)
+void EXT_MEM_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&ExtMemHandle);
+}
+
+void EXT_MEM_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&ExtMemHandle);
+}
+
+void EXT_MEM_DMA_TX_IRQHandler(void)
 {
-  HAL_UART_IRQHandler(& UartHandle);
+  HAL_DMA_IRQHandler(&ExtMemDmaTxHandle);
 }
 
 
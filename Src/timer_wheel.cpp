@@ -0,0 +1,179 @@
+#include "timer_wheel.h"
+
+static_assert(TIMER_WHEEL_SIZE < 0xFFFF, "timer indices are 16-bit");
+static_assert(TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS <= 30, "the wheel must span less than the tick counter");
+
+TimerWheel::TimerWheel()
+{
+    clear(0);
+}
+
+void TimerWheel::clear(uint32_t now)
+{
+    for (uint32_t i = 0; i < TIMER_WHEEL_LEVELS * SLOTS; i++)
+        slots[i] = NONE;
+    for (uint32_t i = 0; i < TIMER_WHEEL_SIZE; i++)
+    {
+        timers[i].next = i + 1 < TIMER_WHEEL_SIZE ? (uint16_t)(i + 1) : NONE;
+        timers[i].slot = NONE;
+        timers[i].generation = 0;
+    }
+    free_head = 0;
+    used = 0;
+    current = now;
+}
+
+/**
+ * @brief  Queue a timer in the lowest level whose span covers its remaining time
+ */
+void TimerWheel::place(uint16_t idx)
+{
+    Timer &t = timers[idx];
+    uint32_t remaining = t.expires - current;
+    uint32_t level = 0;
+    while (level + 1 < TIMER_WHEEL_LEVELS && remaining >= (1U << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+    uint32_t expires = t.expires;
+    if (remaining >= (1U << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+        expires = current + (1U << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1; // re-placed when it comes round
+    uint16_t slot = level * SLOTS + ((expires >> (TIMER_WHEEL_BITS * level)) & (SLOTS - 1));
+
+    t.slot = slot;
+    t.prev = NONE;
+    t.next = slots[slot];
+    if (t.next != NONE)
+        timers[t.next].prev = idx;
+    slots[slot] = idx;
+}
+
+void TimerWheel::unlink(uint16_t idx)
+{
+    Timer &t = timers[idx];
+    if (t.prev != NONE)
+        timers[t.prev].next = t.next;
+    else
+        slots[t.slot] = t.next;
+    if (t.next != NONE)
+        timers[t.next].prev = t.prev;
+    t.slot = NONE;
+}
+
+/**
+ * @brief  Move the timers of the level's current slot down to lower levels
+ */
+void TimerWheel::cascade(uint32_t level)
+{
+    uint16_t slot = level * SLOTS + ((current >> (TIMER_WHEEL_BITS * level)) & (SLOTS - 1));
+    uint16_t idx = slots[slot];
+    slots[slot] = NONE;
+    while (idx != NONE)
+    {
+        uint16_t next = timers[idx].next;
+        place(idx);
+        idx = next;
+    }
+}
+
+TimerWheel::Timer *TimerWheel::lookup(TimerHandle handle)
+{
+    uint16_t idx = handle & 0xFFFF;
+    if (handle == TIMER_NONE || idx >= TIMER_WHEEL_SIZE)
+        return nullptr;
+    Timer &t = timers[idx];
+    if (t.generation != handle >> 16 || t.slot == NONE)
+        return nullptr;
+    return &t;
+}
+
+/**
+ * @brief  Start a timer
+ * @param  delay: ms until the first expiry, at least 1
+ * @param  period: ms between later expiries, 0 for a one-shot timer
+ * @retval handle for cancel(), or TIMER_NONE if the pool is exhausted
+ */
+TimerHandle TimerWheel::schedule(uint32_t delay, uint32_t period, TimerCallback callback, uint32_t arg)
+{
+    if (free_head == NONE)
+        return TIMER_NONE;
+    uint16_t idx = free_head;
+    Timer &t = timers[idx];
+    free_head = t.next;
+    used++;
+
+    t.expires = current + (delay ? delay : 1);
+    t.period = period;
+    t.callback = callback;
+    t.arg = arg;
+    if (++t.generation == 0)
+        t.generation = 1;
+    place(idx);
+    return (TimerHandle)t.generation << 16 | idx;
+}
+
+/**
+ * @retval false if the timer already fired (one-shot) or was cancelled
+ */
+bool TimerWheel::cancel(TimerHandle handle)
+{
+    Timer *t = lookup(handle);
+    if (t == nullptr)
+        return false;
+    uint16_t idx = (uint16_t)(t - timers);
+    unlink(idx);
+    t->next = free_head;
+    free_head = idx;
+    used--;
+    return true;
+}
+
+bool TimerWheel::pending(TimerHandle handle)
+{
+    return lookup(handle) != nullptr;
+}
+
+/**
+ * @brief  Process every tick up to now, running the callbacks of the timers
+ *         that expire. Callbacks may schedule and cancel timers.
+ * @retval number of callbacks run
+ */
+uint32_t TimerWheel::advance(uint32_t now)
+{
+    uint32_t fired = 0;
+    while (current != now)
+    {
+        current++;
+        for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+        {
+            if ((current & ((1U << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+                break;
+            cascade(level);
+        }
+
+        uint16_t slot = current & (SLOTS - 1);
+        while (slots[slot] != NONE)
+        {
+            uint16_t idx = slots[slot];
+            Timer &t = timers[idx];
+            unlink(idx);
+            if (t.expires != current) // parked at the top level, not due yet
+            {
+                place(idx);
+                continue;
+            }
+            if (t.period)
+            {
+                t.expires = current + t.period;
+                place(idx);
+            }
+            else
+            {
+                t.next = free_head;
+                free_head = idx;
+                used--;
+            }
+            t.callback(t.arg);
+            fired++;
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,42 @@
+#include "trace.h"
+
+TraceRecord trace_ring[TRACE_RING_SIZE];
+std::atomic<uint32_t> trace_head(0);
+std::atomic<bool> trace_paused(false);
+static uint32_t drained = 0; // next record for Trace_Next()
+static uint32_t dropped = 0;
+
+void Trace_Init(void)
+{
+    CycleCounter_Init();
+    trace_head.store(0, std::memory_order_relaxed);
+    drained = 0;
+    dropped = 0;
+}
+
+/**
+ * @brief  Take the oldest record not yet drained. Main loop only.
+ * @retval false if there is none
+ */
+bool Trace_Next(TraceRecord *record)
+{
+    uint32_t head = trace_head.load(std::memory_order_acquire);
+    if (head - drained > TRACE_RING_SIZE)
+    {
+        dropped += head - drained - TRACE_RING_SIZE;
+        drained = head - TRACE_RING_SIZE;
+    }
+    if (drained == head)
+        return false;
+    *record = trace_ring[drained & (TRACE_RING_SIZE - 1)];
+    drained++;
+    return true;
+}
+
+/**
+ * @retval records overwritten before they could be drained
+ */
+uint32_t Trace_Dropped(void)
+{
+    return dropped;
+}
@@ -0,0 +1,41 @@
+/* Trace drain over ITM stimulus port TRACE_ITM_PORT, for a debugger capturing */
+/* SWO. Each record goes out as three 32-bit writes: cycles, tick, then */
+/* event | phase << 8 | arg << 16. Nothing is sent unless the debugger */
+/* has enabled the port. */
+
+#include "trace.h"
+
+/* Records sent per call, so the main loop stays responsive */
+#define TRACE_DRAIN_BATCH               8U
+
+static bool port_ready(void)
+{
+  return ITM->PORT[TRACE_ITM_PORT].u32 != 0;
+}
+
+static void port_write(uint32_t word)
+{
+  while (!port_ready())
+  {
+  }
+  ITM->PORT[TRACE_ITM_PORT].u32 = word;
+}
+
+void Trace_Drain(void)
+{
+  if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & (1UL << TRACE_ITM_PORT)) == 0)
+    return;
+
+  TraceRecord r;
+  for (uint32_t n = 0; n < TRACE_DRAIN_BATCH && port_ready() && Trace_Next(&r); n++)
+  {
+    port_write(r.cycles);
+    port_write(r.tick);
+    port_write(r.event | (uint32_t)r.phase << 8 | (uint32_t)r.arg << 16);
+  }
+}
+
+uint32_t Trace_CyclesPerUs(void)
+{
+  return SystemCoreClock / 1000000U;
+}
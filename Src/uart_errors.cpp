@@ -0,0 +1,83 @@
+/* UART receive error counters. Written from the UART interrupt, read from */
+/* the main loop; each counter is a lock-free atomic so neither side blocks. */
+
+#include "main.h"
+#include "uart_errors.h"
+#include <atomic>
+
+static std::atomic<uint32_t> overrun_count(0);
+static std::atomic<uint32_t> framing_count(0);
+static std::atomic<uint32_t> noise_count(0);
+static std::atomic<uint32_t> parity_count(0);
+static std::atomic<uint32_t> rx_byte_count(0);
+static std::atomic<uint32_t> start_tick(0);
+/* Each link's handler runs at one priority, so only it writes its entry */
+static std::atomic<uint32_t> irq_count[UART_LINKS];
+static std::atomic<uint32_t> irq_cycles[UART_LINKS];
+static std::atomic<uint32_t> irq_max_cycles[UART_LINKS];
+
+/**
+ * @brief  Classify a HAL UART error code. Safe to call from interrupt context.
+ * @param  error_code: huart->ErrorCode, any combination of HAL_UART_ERROR_xxx
+ */
+void UART_Errors_Record(uint32_t error_code)
+{
+  if (error_code & HAL_UART_ERROR_ORE)
+    overrun_count.fetch_add(1, std::memory_order_relaxed);
+  if (error_code & HAL_UART_ERROR_FE)
+    framing_count.fetch_add(1, std::memory_order_relaxed);
+  if (error_code & HAL_UART_ERROR_NE)
+    noise_count.fetch_add(1, std::memory_order_relaxed);
+  if (error_code & HAL_UART_ERROR_PE)
+    parity_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UART_Errors_CountByte(void)
+{
+  rx_byte_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Account one interrupt of a link's handler, measured with the cycle
+ *         counter from entry to exit. Call from that handler only.
+ */
+void UART_Errors_CountIrq(UartLink link, uint32_t cycles)
+{
+  irq_count[link].store(irq_count[link].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  irq_cycles[link].store(irq_cycles[link].load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+  if (cycles > irq_max_cycles[link].load(std::memory_order_relaxed))
+    irq_max_cycles[link].store(cycles, std::memory_order_relaxed);
+}
+
+void UART_Errors_GetIrqCost(UartLink link, UartIrqCost *cost)
+{
+  cost->interrupts = irq_count[link].load(std::memory_order_relaxed);
+  cost->cycles = irq_cycles[link].load(std::memory_order_relaxed);
+  cost->max_cycles = irq_max_cycles[link].load(std::memory_order_relaxed);
+}
+
+void UART_Errors_Get(UartErrorCounts *counts)
+{
+  counts->overrun = overrun_count.load(std::memory_order_relaxed);
+  counts->framing = framing_count.load(std::memory_order_relaxed);
+  counts->noise = noise_count.load(std::memory_order_relaxed);
+  counts->parity = parity_count.load(std::memory_order_relaxed);
+  counts->rx_bytes = rx_byte_count.load(std::memory_order_relaxed);
+  counts->since_tick = start_tick.load(std::memory_order_relaxed);
+}
+
+void UART_Errors_Reset(void)
+{
+  overrun_count.store(0, std::memory_order_relaxed);
+  framing_count.store(0, std::memory_order_relaxed);
+  noise_count.store(0, std::memory_order_relaxed);
+  parity_count.store(0, std::memory_order_relaxed);
+  rx_byte_count.store(0, std::memory_order_relaxed);
+  for (int link = 0; link < UART_LINKS; link++)
+  {
+    irq_count[link].store(0, std::memory_order_relaxed);
+    irq_cycles[link].store(0, std::memory_order_relaxed);
+    irq_max_cycles[link].store(0, std::memory_order_relaxed);
+  }
+  start_tick.store(HAL_GetTick(), std::memory_order_relaxed);
+}
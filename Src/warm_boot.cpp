@@ -0,0 +1,117 @@
+#include "warm_boot.h"
+#include "crc32.h"
+#include <new>
+#include <stddef.h>
+
+/* Header, bank and the arena of its names as they sit in .noinit RAM */
+struct RetainedBank
+{
+    uint32_t magic;
+    uint32_t layout;        // sizeof(RetainedBank): another layout starts cold
+    uint32_t warm_boots;
+    uint32_t corrupt_boots;
+    uint32_t crc;           // CRC-32 of everything from names_used on
+    uint32_t names_used;    // bytes of names[] in use
+    alignas(ConsoleBank) uint8_t bank[sizeof(ConsoleBank)];
+    uint8_t names[CONSOLE_NAME_ARENA_SIZE];
+};
+#define RETAINED_CRC_START              offsetof(RetainedBank, names_used)
+
+/* BankAccount's atomics and ~Bank() rule out is_trivially_copyable; what */
+/* matters for adopting the bytes is that nothing points outside them */
+static_assert(!ConsoleBank::uses_heap(), "the retained bank must not own heap memory");
+
+static RetainedBank retained NOINIT;
+static RetainedBank *block = nullptr;
+static WarmBootStats stats;
+
+static ConsoleBank *retained_bank(void)
+{
+    return std::launder(reinterpret_cast<ConsoleBank *>(block->bank));
+}
+
+/* The host keeps the block in the BANK_NOINIT file, see hal_host.cpp */
+static RetainedBank *retained_block(void)
+{
+#ifdef HOST_BUILD
+    void *ram = HAL_Host_RetainedRam(sizeof(RetainedBank));
+    if (ram != nullptr)
+        return static_cast<RetainedBank *>(ram);
+#endif
+    return &retained;
+}
+
+static uint32_t retained_crc(void)
+{
+    return crc32_compute(reinterpret_cast<const uint8_t *>(block) + RETAINED_CRC_START,
+                         sizeof(RetainedBank) - RETAINED_CRC_START);
+}
+
+/* The arena holds this bank's names only, so the bank can compact it */
+static void compact_console_names(NameArena &arena)
+{
+    (void)arena;
+    retained_bank()->compact_names();
+}
+
+/**
+ * @brief  Find the bank left in RAM by the last run and adopt it if it is
+ *         intact, else build an empty one there. Either way Names() is bound
+ *         to the retained arena. Reads and clears the reset flags.
+ */
+ConsoleBank &WarmBoot_Attach(void)
+{
+    block = retained_block();
+    stats.reset_flags = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+    const bool power_on = (stats.reset_flags & (RCC_CSR_PORRSTF | RCC_CSR_BORRSTF)) != 0;
+    const bool intact = block->magic == WARM_BOOT_MAGIC && block->layout == sizeof(RetainedBank) &&
+                        block->crc == retained_crc() &&
+                        Names().bind(block->names, sizeof(block->names), block->names_used);
+    Names().set_compactor(compact_console_names);
+
+    if (!power_on && intact)
+    {
+        block->warm_boots++;
+        stats.kind = WARM_BOOT_WARM;
+        stats.accounts = retained_bank()->size();
+    }
+    else
+    {
+        if (power_on || block->magic != WARM_BOOT_MAGIC)
+        {
+            block->warm_boots = 0;
+            block->corrupt_boots = 0;
+        }
+        if (!power_on)
+            block->corrupt_boots++;
+        stats.kind = power_on ? WARM_BOOT_COLD : WARM_BOOT_CORRUPT;
+        stats.accounts = 0;
+        new (block->bank) ConsoleBank();
+        Names().bind(block->names, sizeof(block->names), 0);
+        block->magic = WARM_BOOT_MAGIC;
+        block->layout = sizeof(RetainedBank);
+        WarmBoot_Seal();
+    }
+    stats.warm_boots = block->warm_boots;
+    stats.corrupt_boots = block->corrupt_boots;
+    return *retained_bank();
+}
+
+void WarmBoot_Seal(void)
+{
+    if (block == nullptr)
+        return;
+    block->names_used = Names().get_used();
+    block->crc = retained_crc();
+}
+
+void WarmBoot_Ready(void)
+{
+    stats.ready_ms = HAL_GetTick();
+}
+
+void WarmBoot_GetStats(WarmBootStats *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,13 @@
+#ifndef EXT_MEM_HOST_H
+#define EXT_MEM_HOST_H
+
+#include <stdint.h>
+
+/* Timing of the modelled device. Defaults: EXT_MEM_I2C_SPEED and */
+/* EXT_MEM_WRITE_CYCLE_MS from main.h; use a cycle of 0 for FRAM. */
+void ExtMem_HostSetModel(uint32_t i2c_hz, uint32_t write_cycle_us);
+/* Back the device with a file, created if missing. Without one (and without */
+/* BANK_EXT_MEM in the environment) contents last until the process exits. */
+bool ExtMem_HostOpen(const char *path);
+
+#endif // EXT_MEM_HOST_H
@@ -0,0 +1,44 @@
+#ifndef SIM_HOST_H
+#define SIM_HOST_H
+
+#include "stm32f4xx_hal.h"
+
+/* Virtual-time simulation of the console. With BANK_SIM naming a scenario */
+/* file, HAL_GetTick(), HAL_Delay() and UART byte arrival run on a virtual */
+/* clock driven by the scenario instead of stdin and the wall clock, so */
+/* timeouts cost no real time and every run with the same seed is identical. */
+/*   BANK_SIM_SEED   first seed (default 1); it varies think time and byte gaps */
+/*   BANK_SIM_RUNS   runs, each in a fresh forked process with the next seed */
+/*   BANK_SIM_ECHO   set to copy the console output to stdout */
+/*   BANK_SIM_BAUD   line rate of the scripted input (default: the console's) */
+/*   BANK_SIM_THINK_MS  longest random pause before each send/type (default */
+/*                   SIM_THINK_MAX_MS); 0 streams the input back to back */
+/* Scenario lines, one step each, '#' starts a comment: */
+/*   send TEXT       type TEXT followed by Enter */
+/*   type TEXT       type TEXT without Enter */
+/*   wait MS         stay idle for MS milliseconds */
+/*   expect TEXT     once everything sent has arrived, the output must show */
+/*                   TEXT within SIM_EXPECT_LIMIT_MS; \r and \n are escapes */
+/*   capture TEXT    expect TEXT, then keep the word that follows it (up to */
+/*                   a space, '.', ',', ''' or line end); \c in later send */
+/*                   and type steps stands for it, e.g. a resume code */
+
+/* Called by HAL_Init(); returns false when BANK_SIM is not set. In the */
+/* parent it runs every simulation and exits with the result. */
+bool Sim_Init(void);
+bool Sim_Active(void);
+uint64_t Sim_Micros(void);
+void Sim_Delay(uint32_t ms);
+void Sim_Transmit(const uint8_t *data, uint16_t size);
+/* The console is USART1, read through huart if a HAL reception is armed */
+/* on it, else through the register model */
+void Sim_WaitForInterrupt(UART_HandleTypeDef *huart, USART_TypeDef *usart);
+
+/* hal_host.cpp: complete one byte of an armed reception */
+void HAL_Host_ReceiveByte(UART_HandleTypeDef *huart, uint8_t byte);
+/* hal_host.cpp: the register model of a USART */
+void HAL_Host_UsartReceive(USART_TypeDef *usart, uint8_t byte);
+bool HAL_Host_UsartReceiving(const USART_TypeDef *usart);
+uint32_t HAL_Host_UsartBaud(const USART_TypeDef *usart);
+
+#endif // SIM_HOST_H
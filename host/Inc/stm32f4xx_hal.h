@@ -0,0 +1,279 @@
+/* Host replacement for the STM32F4 HAL - just enough of the HAL API for the */
+/* firmware sources to build and run as a Linux process. */
+/* USART1 is mapped onto stdin/stdout, USART2 onto the BANK_REPL_FDS pipe */
+/* pair; ticks come from the monotonic clock. */
+/* Interrupts are delivered synchronously from __WFI(), which sleeps until a */
+/* byte arrives or the next millisecond tick. */
+/* Register blocks used by register-level drivers (see Inc/uart.h) sit at */
+/* the real bus addresses only in name: HAL_Host_Peripheral() maps a base */
+/* address onto the host's model of that peripheral. */
+
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum
+{
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY                   0xFFFFFFFFU
+
+/* Peripheral base addresses, as in the CMSIS device header */
+#define USART2_BASE                     0x40004400U
+#define USART1_BASE                     0x40011000U
+#define USART6_BASE                     0x40011400U
+#define GPIOA_BASE                      0x40020000U
+#define GPIOB_BASE                      0x40020400U
+#define GPIOC_BASE                      0x40020800U
+void *HAL_Host_Peripheral(uintptr_t base);
+
+/* GPIO -------------------------------------------------------------------- */
+typedef struct
+{
+    volatile uint32_t MODER;
+    volatile uint32_t OTYPER;
+    volatile uint32_t OSPEEDR;
+    volatile uint32_t PUPDR;
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+    volatile uint32_t LCKR;
+    volatile uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc;
+#define GPIOA                           (&host_gpioa)
+#define GPIOB                           (&host_gpiob)
+#define GPIOC                           (&host_gpioc)
+#define GPIO_PIN_9                      ((uint16_t)0x0200)
+#define GPIO_PIN_10                     ((uint16_t)0x0400)
+#define GPIO_PIN_13                     ((uint16_t)0x2000)
+#define GPIO_MODE_OUTPUT_PP             0x00000001U
+#define GPIO_MODE_AF_PP                 0x00000002U
+#define GPIO_PULLUP                     0x00000001U
+#define GPIO_SPEED_FAST                 0x00000002U
+#define GPIO_AF7_USART1                 ((uint8_t)0x07)
+
+/* UART -------------------------------------------------------------------- */
+/* Data register model: writing sends the byte down the line, reading takes */
+/* the received byte and clears RXNE and the error flags, as on the chip */
+struct HostUsartData
+{
+    uint8_t received;
+    void operator=(uint32_t value);
+    operator uint32_t();
+};
+
+typedef struct
+{
+    int fd_in;
+    int fd_out;
+    volatile uint32_t SR; // TXE and TC always set: the line takes bytes at once
+    HostUsartData DR;
+    volatile uint32_t BRR;
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t CR3;
+    volatile uint32_t GTPR;
+} USART_TypeDef;
+
+#define USART_SR_PE                     0x00000001U
+#define USART_SR_FE                     0x00000002U
+#define USART_SR_NE                     0x00000004U
+#define USART_SR_ORE                    0x00000008U
+#define USART_SR_RXNE                   0x00000020U
+#define USART_SR_TC                     0x00000040U
+#define USART_SR_TXE                    0x00000080U
+#define USART_CR1_RE                    0x00000004U
+#define USART_CR1_TE                    0x00000008U
+#define USART_CR1_RXNEIE                0x00000020U
+#define USART_CR1_UE                    0x00002000U
+
+typedef struct
+{
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef enum
+{
+    HAL_UART_STATE_RESET = 0x00U,
+    HAL_UART_STATE_READY = 0x20U,
+    HAL_UART_STATE_BUSY_TX = 0x21U,
+    HAL_UART_STATE_BUSY_RX = 0x22U
+} HAL_UART_StateTypeDef;
+
+typedef struct
+{
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    uint8_t *pRxBuffPtr;
+    uint16_t RxXferCount;
+    volatile HAL_UART_StateTypeDef gState;
+    volatile HAL_UART_StateTypeDef RxState;
+    volatile uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+extern USART_TypeDef host_usart1, host_usart2;
+#define USART1                          (&host_usart1)
+#define USART2                          (&host_usart2)
+#define UART_WORDLENGTH_8B              0x00000000U
+#define UART_STOPBITS_1                 0x00000000U
+#define UART_PARITY_NONE                0x00000000U
+#define UART_HWCONTROL_NONE             0x00000000U
+#define UART_MODE_TX_RX                 0x0000000CU
+#define UART_OVERSAMPLING_16            0x00000000U
+#define HAL_UART_ERROR_NONE             0x00000000U
+#define HAL_UART_ERROR_PE               0x00000001U
+#define HAL_UART_ERROR_NE               0x00000002U
+#define HAL_UART_ERROR_FE               0x00000004U
+#define HAL_UART_ERROR_ORE              0x00000008U
+
+/* RCC / PWR --------------------------------------------------------------- */
+typedef struct
+{
+    volatile uint32_t AHB1ENR;
+    volatile uint32_t APB1ENR;
+    volatile uint32_t APB2ENR;
+    volatile uint32_t CSR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef host_rcc;
+#define RCC                             (&host_rcc)
+#define RCC_APB1ENR_USART2EN            0x00020000U
+#define RCC_APB2ENR_USART1EN            0x00000010U
+#define RCC_APB2ENR_USART6EN            0x00000020U
+#define RCC_CSR_RMVF                    0x01000000U
+#define RCC_CSR_BORRSTF                 0x02000000U
+#define RCC_CSR_PINRSTF                 0x04000000U
+#define RCC_CSR_PORRSTF                 0x08000000U
+#define RCC_CSR_SFTRSTF                 0x10000000U
+#define RCC_CSR_IWDGRSTF                0x20000000U
+/* .noinit RAM that outlives the process: size bytes of the BANK_NOINIT */
+/* file, or nullptr without it. Sets the reset flags in RCC->CSR: power-on */
+/* when the file is new or BANK_RESET=power, else a software reset. */
+void *HAL_Host_RetainedRam(size_t size);
+
+typedef struct
+{
+    uint32_t PLLState;
+    uint32_t PLLSource;
+    uint32_t PLLM;
+    uint32_t PLLN;
+    uint32_t PLLP;
+    uint32_t PLLQ;
+} RCC_PLLInitTypeDef;
+
+typedef struct
+{
+    uint32_t OscillatorType;
+    uint32_t HSEState;
+    RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct
+{
+    uint32_t ClockType;
+    uint32_t SYSCLKSource;
+    uint32_t AHBCLKDivider;
+    uint32_t APB1CLKDivider;
+    uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+#define RCC_OSCILLATORTYPE_HSE          0x00000001U
+#define RCC_HSE_ON                      0x00000001U
+#define RCC_PLL_ON                      0x00000002U
+#define RCC_PLLSOURCE_HSE               0x00400000U
+#define RCC_PLLP_DIV2                   0x00000002U
+#define RCC_CLOCKTYPE_SYSCLK            0x00000001U
+#define RCC_CLOCKTYPE_HCLK              0x00000002U
+#define RCC_CLOCKTYPE_PCLK1             0x00000004U
+#define RCC_CLOCKTYPE_PCLK2             0x00000008U
+#define RCC_SYSCLKSOURCE_PLLCLK         0x00000002U
+#define RCC_SYSCLK_DIV1                 0x00000000U
+#define RCC_HCLK_DIV1                   0x00000000U
+#define RCC_HCLK_DIV2                   0x00001000U
+#define FLASH_LATENCY_3                 0x00000003U
+#define PWR_REGULATOR_VOLTAGE_SCALE1    0x0000C000U
+
+#define __HAL_RCC_PWR_CLK_ENABLE()      do { } while (0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()    do { } while (0)
+#define __HAL_PWR_VOLTAGESCALING_CONFIG(__REGULATOR__) do { (void)(__REGULATOR__); } while (0)
+
+/* HAL API ----------------------------------------------------------------- */
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+/* Microseconds since HAL_Init() on the same clock as HAL_GetTick(), for host models */
+uint64_t HAL_Host_GetMicros(void);
+
+/* Cortex-M intrinsics -------------------------------------------------------- */
+void HAL_Host_WaitForInterrupt(void);
+#define __WFI()                         HAL_Host_WaitForInterrupt()
+
+/* NVIC: interrupts are not masked or prioritised on the host; __WFI() */
+/* calls the handlers of the USART models directly */
+typedef enum
+{
+    USART1_IRQn = 37,
+    USART2_IRQn = 38,
+    USART6_IRQn = 71
+} IRQn_Type;
+
+#define NVIC_GetPriorityGrouping()      0U
+#define NVIC_EncodePriority(__GROUP__, __PREEMPT__, __SUB__) ((void)(__GROUP__), (void)(__PREEMPT__), (uint32_t)(__SUB__))
+#define NVIC_SetPriority(__IRQN__, __PRIORITY__) do { (void)(__IRQN__); (void)(__PRIORITY__); } while (0)
+#define NVIC_EnableIRQ(__IRQN__)        do { (void)(__IRQN__); } while (0)
+void USART1_IRQHandler(void);
+void USART2_IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_H */
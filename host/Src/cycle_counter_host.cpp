@@ -0,0 +1,19 @@
+/* Host cycle counter: the time stamp counter where there is one, else nanoseconds. */
+
+#include "cycle_counter.h"
+#include <time.h>
+
+void CycleCounter_Init(void)
+{
+}
+
+uint32_t CycleCounter_Read(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint32_t)__builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+#endif
+}
@@ -0,0 +1,78 @@
+/* Host model of the external I2C FRAM/EEPROM: a byte array, optionally backed */
+/* by a file, whose writes stay "busy" for as long as the real bus transfer and */
+/* page write cycle would take. */
+
+#include "main.h"
+#include "ext_mem.h"
+#include "ext_mem_host.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint8_t mem[EXT_MEM_SIZE];
+static int fd = -1;
+static uint32_t bus_hz = EXT_MEM_I2C_SPEED;
+static uint32_t cycle_us = EXT_MEM_WRITE_CYCLE_MS * 1000U;
+static uint64_t busy_until_us = 0;
+
+void ExtMem_HostSetModel(uint32_t i2c_hz, uint32_t write_cycle_us)
+{
+  bus_hz = i2c_hz;
+  cycle_us = write_cycle_us;
+}
+
+bool ExtMem_HostOpen(const char *path)
+{
+  if (fd >= 0)
+    close(fd);
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return false;
+  memset(mem, 0xFF, sizeof(mem)); // erased EEPROM
+  ssize_t got = pread(fd, mem, sizeof(mem), 0);
+  if (got < (ssize_t)sizeof(mem) && pwrite(fd, mem, sizeof(mem), 0) != (ssize_t)sizeof(mem))
+    return false;
+  return true;
+}
+
+void ExtMem_Init(void)
+{
+  memset(mem, 0xFF, sizeof(mem));
+  const char *path = getenv("BANK_EXT_MEM");
+  if (path != nullptr && !ExtMem_HostOpen(path))
+  {
+    perror(path);
+    exit(1);
+  }
+}
+
+bool ExtMem_Read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+  if (addr + len > EXT_MEM_SIZE)
+    return false;
+  memcpy(buf, mem + addr, len);
+  return true;
+}
+
+bool ExtMem_WriteStart(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+  if (HAL_Host_GetMicros() < busy_until_us)
+    return false;
+  if (len == 0 || addr + len > EXT_MEM_SIZE || addr / EXT_MEM_PAGE_SIZE != (addr + len - 1) / EXT_MEM_PAGE_SIZE)
+    return false;
+
+  memcpy(mem + addr, buf, len);
+  if (fd >= 0 && pwrite(fd, buf, len, addr) != (ssize_t)len)
+    return false;
+  /* Start, device address, two address bytes and the data, 9 clocks per byte */
+  uint64_t bus_us = (uint64_t)(len + 3) * 9U * 1000000U / bus_hz;
+  busy_until_us = HAL_Host_GetMicros() + bus_us + cycle_us;
+  return true;
+}
+
+ExtMemState ExtMem_Poll(void)
+{
+  return HAL_Host_GetMicros() < busy_until_us ? EXT_MEM_BUSY : EXT_MEM_IDLE;
+}
@@ -0,0 +1,419 @@
+/* Host implementation of the HAL subset declared in Inc/stm32f4xx_hal.h. */
+/* USART1 reads stdin and writes stdout, so the firmware can be driven */
+/* through pipes or a terminal exactly like the board's serial console. */
+/* USART2, the replication link, uses the descriptors in BANK_REPL_FDS */
+/* ("in,out", e.g. inherited pipe ends); without them HAL_UART_Init() fails */
+/* for it, as it would with nothing wired to the board. */
+/* UART reception is interrupt driven on target; here the "interrupt" runs */
+/* from __WFI() when the firmware goes idle. With BANK_SIM set, time and */
+/* input come from the virtual-time simulation in sim_host.cpp instead. */
+/* A USART is driven either through the HAL calls below or, once its CR1 */
+/* enables the receive interrupt, through the register model: received */
+/* bytes are latched in DR and the instance's IRQ handler is called. */
+/* BANK_NOINIT names a file that stands in for .noinit RAM: it is mapped */
+/* shared, so whatever the firmware left in it survives a kill and restart */
+/* like RAM survives a warm reset. */
+
+#include "main.h"
+#include "sim_host.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc;
+RCC_TypeDef host_rcc = {0, 0, 0, RCC_CSR_PORRSTF | RCC_CSR_BORRSTF | RCC_CSR_PINRSTF};
+USART_TypeDef host_usart1 = {STDIN_FILENO, STDOUT_FILENO, USART_SR_TXE | USART_SR_TC, {0}, 0, 0, 0, 0, 0};
+USART_TypeDef host_usart2 = {-1, -1, USART_SR_TXE | USART_SR_TC, {0}, 0, 0, 0, 0, 0};
+
+static uint64_t start_ms = 0;
+
+static uint64_t monotonic_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+  start_ms = monotonic_ms();
+  if (Sim_Init())
+    return HAL_OK; // no replication link in simulations
+
+  const char *fds = getenv("BANK_REPL_FDS");
+  int in = -1, out = -1;
+  if (fds != nullptr && sscanf(fds, "%d,%d", &in, &out) == 2 && in >= 0 && out >= 0)
+  {
+    /* A full link drops bytes like a line with nobody listening */
+    fcntl(out, F_SETFL, fcntl(out, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    host_usart2.fd_in = in;
+    host_usart2.fd_out = out;
+  }
+  return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  if (Sim_Active())
+    return (uint32_t)(Sim_Micros() / 1000U);
+  return (uint32_t)(monotonic_ms() - start_ms);
+}
+
+uint64_t HAL_Host_GetMicros(void)
+{
+  if (Sim_Active())
+    return Sim_Micros();
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  if (Sim_Active())
+  {
+    Sim_Delay(Delay);
+    return;
+  }
+  struct timespec ts = {(time_t)(Delay / 1000U), (long)(Delay % 1000U) * 1000000L};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+  {
+  }
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+  (void)RCC_OscInitStruct;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+  (void)RCC_ClkInitStruct;
+  (void)FLatency;
+  return HAL_OK;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+  (void)GPIOx;
+  (void)GPIO_Init;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+  if (PinState == GPIO_PIN_SET)
+    GPIOx->ODR |= GPIO_Pin;
+  else
+    GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+  GPIOx->ODR ^= GPIO_Pin;
+}
+
+void *HAL_Host_RetainedRam(size_t size)
+{
+  const char *path = getenv("BANK_NOINIT");
+  if (path == nullptr)
+    return nullptr;
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    perror(path);
+    exit(1);
+  }
+  off_t old_size = lseek(fd, 0, SEEK_END);
+  if (old_size != (off_t)size && ftruncate(fd, (off_t)size) != 0)
+  {
+    perror(path);
+    exit(1);
+  }
+  void *ram = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ram == MAP_FAILED)
+  {
+    perror(path);
+    exit(1);
+  }
+  const char *reset = getenv("BANK_RESET");
+  if (old_size == (off_t)size && (reset == nullptr || strcmp(reset, "power") != 0))
+    host_rcc.CSR = RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF;
+  return ram;
+}
+
+void *HAL_Host_Peripheral(uintptr_t base)
+{
+  switch (base)
+  {
+  case USART1_BASE:
+    return &host_usart1;
+  case USART2_BASE:
+    return &host_usart2;
+  case GPIOA_BASE:
+    return &host_gpioa;
+  case GPIOB_BASE:
+    return &host_gpiob;
+  case GPIOC_BASE:
+    return &host_gpioc;
+  default:
+    fprintf(stderr, "no host model of the peripheral at 0x%08lx\n", (unsigned long)base);
+    abort();
+  }
+}
+
+static USART_TypeDef *usart_of(const HostUsartData *data)
+{
+  return data == &host_usart1.DR ? &host_usart1 : &host_usart2;
+}
+
+static void usart_send(USART_TypeDef *usart, const uint8_t *data, size_t size)
+{
+  if (Sim_Active())
+  {
+    if (usart == USART1)
+      Sim_Transmit(data, (uint16_t)size);
+    return;
+  }
+  while (size > 0)
+  {
+    ssize_t n = write(usart->fd_out, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return; // the rest is lost on the line
+    data += n;
+    size -= (size_t)n;
+  }
+}
+
+void HostUsartData::operator=(uint32_t value)
+{
+  uint8_t byte = (uint8_t)value;
+  usart_send(usart_of(this), &byte, 1);
+}
+
+HostUsartData::operator uint32_t()
+{
+  usart_of(this)->SR &= ~(USART_SR_RXNE | USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE);
+  return received;
+}
+
+/**
+ * @brief  A byte arrives at a USART driven through its registers: latch it
+ *         (or flag an overrun if the last one was not read) and run the
+ *         instance's interrupt handler if the receive interrupt is enabled.
+ */
+void HAL_Host_UsartReceive(USART_TypeDef *usart, uint8_t byte)
+{
+  if (usart->SR & USART_SR_RXNE)
+    usart->SR |= USART_SR_ORE;
+  else
+  {
+    usart->DR.received = byte;
+    usart->SR |= USART_SR_RXNE;
+  }
+  if (usart->CR1 & USART_CR1_RXNEIE)
+  {
+    if (usart == USART1)
+      USART1_IRQHandler();
+    else
+      USART2_IRQHandler();
+  }
+}
+
+/* Line rate set in BRR, for the simulation's byte timing; 0 if not set up */
+uint32_t HAL_Host_UsartBaud(const USART_TypeDef *usart)
+{
+  if (usart->BRR == 0)
+    return 0;
+  return (usart == USART2 ? APB1_CLOCK_HZ : APB2_CLOCK_HZ) / usart->BRR;
+}
+
+/* Whether the register model takes bytes: enabled with the receive interrupt on */
+bool HAL_Host_UsartReceiving(const USART_TypeDef *usart)
+{
+  const uint32_t on = USART_CR1_UE | USART_CR1_RE | USART_CR1_RXNEIE;
+  return (usart->CR1 & on) == on;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+  if (huart->Instance->fd_in < 0)
+    return HAL_ERROR;
+  huart->ErrorCode = HAL_UART_ERROR_NONE;
+  huart->gState = HAL_UART_STATE_READY;
+  huart->RxState = HAL_UART_STATE_READY;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)Timeout;
+  usart_send(huart->Instance, pData, Size);
+  return HAL_OK;
+}
+
+/* Receptions armed by HAL_UART_Receive_IT() and finished transmissions */
+/* waiting for their callback, per instance */
+static UART_HandleTypeDef *rx_handles[2];
+static UART_HandleTypeDef *tx_done[2];
+
+static int uart_index(UART_HandleTypeDef *huart)
+{
+  return huart->Instance == USART1 ? 0 : 1;
+}
+
+/**
+ * @brief  The write happens at once; the completion callback runs from the
+ *         next __WFI(), as the interrupt would after the last byte.
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+  if (huart->gState != HAL_UART_STATE_READY)
+    return HAL_BUSY;
+  if (!Sim_Active())
+    usart_send(huart->Instance, pData, Size);
+  huart->gState = HAL_UART_STATE_BUSY_TX;
+  tx_done[uart_index(huart)] = huart;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (huart->RxState != HAL_UART_STATE_READY)
+    return HAL_BUSY;
+  huart->pRxBuffPtr = pData;
+  huart->RxXferCount = Size;
+  huart->ErrorCode = HAL_UART_ERROR_NONE;
+  huart->RxState = HAL_UART_STATE_BUSY_RX;
+  rx_handles[uart_index(huart)] = huart;
+  return HAL_OK;
+}
+
+/**
+ * @brief  Stand-in for WFI: finish pending transmissions, else sleep until
+ *         input is readable or the next 1 ms tick, then run the UART
+ *         "interrupt" for every line a byte came in on.
+ */
+void HAL_Host_WaitForInterrupt(void)
+{
+  bool completed = false;
+  for (UART_HandleTypeDef *&huart : tx_done)
+  {
+    if (huart != nullptr)
+    {
+      UART_HandleTypeDef *done = huart;
+      huart = nullptr;
+      done->gState = HAL_UART_STATE_READY;
+      HAL_UART_TxCpltCallback(done);
+      completed = true;
+    }
+  }
+  if (completed)
+    return;
+
+  if (Sim_Active())
+  {
+    Sim_WaitForInterrupt(rx_handles[0], USART1);
+    return;
+  }
+
+  /* Each line is read either for an armed HAL reception or for the */
+  /* register model */
+  struct pollfd pfds[2];
+  USART_TypeDef *polled[2];
+  UART_HandleTypeDef *handles[2];
+  nfds_t count = 0;
+  for (int i = 0; i < 2; i++)
+  {
+    USART_TypeDef *usart = i == 0 ? USART1 : USART2;
+    UART_HandleTypeDef *huart = rx_handles[i];
+    if (huart != nullptr && huart->RxState != HAL_UART_STATE_BUSY_RX)
+      huart = nullptr;
+    if (usart->fd_in < 0 || (huart == nullptr && !HAL_Host_UsartReceiving(usart)))
+      continue;
+    pfds[count] = {usart->fd_in, POLLIN, 0};
+    polled[count] = usart;
+    handles[count++] = huart;
+  }
+  if (count == 0)
+  {
+    HAL_Delay(1);
+    return;
+  }
+  if (poll(pfds, count, 1) <= 0)
+    return;
+
+  for (nfds_t i = 0; i < count; i++)
+  {
+    if ((pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+      continue;
+    USART_TypeDef *usart = polled[i];
+    uint8_t byte = 0;
+    ssize_t n = read(usart->fd_in, &byte, 1);
+    if (n == 0)
+    {
+      if (usart == USART1)
+        exit(0); // the other end of the console hung up
+      usart->fd_in = -1; // the other board is gone; the line stays quiet
+      continue;
+    }
+    if (n > 0 && handles[i] != nullptr)
+      HAL_Host_ReceiveByte(handles[i], byte);
+    else if (n > 0)
+      HAL_Host_UsartReceive(usart, byte);
+  }
+}
+
+void HAL_Host_ReceiveByte(UART_HandleTypeDef *huart, uint8_t byte)
+{
+  *huart->pRxBuffPtr++ = byte;
+  if (--huart->RxXferCount == 0)
+  {
+    huart->RxState = HAL_UART_STATE_READY;
+    HAL_UART_RxCpltCallback(huart);
+  }
+}
+
+/* Events reach the HAL callbacks straight from __WFI(), so there is */
+/* nothing left for the interrupt handler to do */
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+/* Default interrupt handlers, overridden by the firmware like the weak */
+/* aliases of the startup file */
+__attribute__((weak)) void USART1_IRQHandler(void)
+{
+}
+
+__attribute__((weak)) void USART2_IRQHandler(void)
+{
+}
+
+/* Default callbacks, overridden by the application as with the real HAL */
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
@@ -0,0 +1,53 @@
+/* Host profiler sampling: SIGPROF from ITIMER_PROF, taking the PC from the */
+/* signal context. The timer runs on process CPU time, so time blocked in */
+/* __WFI() is not sampled as it is on the board. The code range is the */
+/* executable's text as placed by the loader; the dump carries the address */
+/* of Profiler_Init() so tools/profile2sym.py can undo the relocation. */
+
+#include "profiler.h"
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+/* Provided by the GNU linker */
+extern "C" char __executable_start[];
+extern "C" char etext[];
+
+void Profiler_CodeRange(uintptr_t *start, uintptr_t *end)
+{
+  *start = (uintptr_t)__executable_start;
+  *end = (uintptr_t)etext;
+}
+
+static void on_sigprof(int sig, siginfo_t *info, void *context)
+{
+  (void)sig;
+  (void)info;
+  const mcontext_t &regs = static_cast<ucontext_t *>(context)->uc_mcontext;
+#if defined(__x86_64__)
+  Profiler_Sample((uintptr_t)regs.gregs[REG_RIP]);
+#elif defined(__i386__)
+  Profiler_Sample((uintptr_t)regs.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+  Profiler_Sample((uintptr_t)regs.pc);
+#else
+  (void)regs;
+#endif
+}
+
+void Profiler_StartTimer(uint32_t hz)
+{
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = on_sigprof;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, nullptr);
+
+  struct itimerval period;
+  period.it_interval.tv_sec = 0;
+  period.it_interval.tv_usec = 1000000 / hz;
+  period.it_value = period.it_interval;
+  setitimer(ITIMER_PROF, &period, nullptr);
+}
@@ -0,0 +1,302 @@
+/* Virtual-time console simulation, see sim_host.h. The firmware only sees */
+/* time pass in HAL_Delay() and in __WFI(), which advances the clock to the */
+/* next 1 ms tick or to the next scripted byte arrival, whichever is first - */
+/* the same wake-ups SysTick and the UART interrupt give it on the board. */
+
+#include "sim_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define SIM_EXPECT_LIMIT_MS             60000U  /* longer than TRANSACTION_WAIT */
+#define SIM_THINK_MAX_MS                200U    /* pause before each send/type */
+#define SIM_OUTPUT_TAIL                 400U    /* output shown on failure */
+#define SIM_CAPTURED                    '\x01'  /* \c in a step */
+
+typedef struct
+{
+  char kind; // 's'end, 't'ype, 'w'ait, 'e'xpect, 'c'apture
+  std::string text;
+  uint32_t ms;
+  int line;
+} SimStep;
+
+typedef struct
+{
+  uint64_t at_us;
+  uint8_t byte;
+} SimByte;
+
+static bool active = false;
+static const char *scenario = nullptr;
+static std::vector<SimStep> steps;
+static uint64_t seed = 1;
+static bool echo = false;
+static uint32_t sim_baud = 0;                 // 0: the console's baud rate
+static uint32_t think_ms = SIM_THINK_MAX_MS;
+
+/* State of one run */
+static uint64_t now_us = 0;
+static uint64_t rng_state = 0;
+static size_t step = 0;
+static std::vector<SimByte> pending; // scripted bytes not yet received, in arrival order
+static size_t pending_head = 0;
+static std::string output;
+static size_t matched = 0;            // output before this was consumed by an expect
+static std::string captured;          // by the last capture step
+static uint64_t step_deadline_us = 0; // wait end or expect limit; 0 until armed
+static uint32_t byte_us = 1042;       // one 10-bit frame at 9600 baud
+
+static uint64_t next_random(void)
+{
+  /* splitmix64, so a seed gives the same run on every platform */
+  uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static std::string unescape(const char *text)
+{
+  std::string out;
+  for (const char *p = text; *p; p++)
+  {
+    if (*p == '\\' && p[1] == 'r')
+      out += '\r', p++;
+    else if (*p == '\\' && p[1] == 'n')
+      out += '\n', p++;
+    else if (*p == '\\' && p[1] == '\\')
+      out += '\\', p++;
+    else if (*p == '\\' && p[1] == 'c')
+      out += SIM_CAPTURED, p++;
+    else
+      out += *p;
+  }
+  return out;
+}
+
+static bool load_scenario(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (f == nullptr)
+  {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  int number = 0;
+  while (fgets(line, sizeof(line), f) != nullptr)
+  {
+    number++;
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == '#' || line[0] == 0)
+      continue;
+    char *arg = strchr(line, ' ');
+    arg = arg ? arg + 1 : line + strlen(line);
+    SimStep s = {0, unescape(arg), 0, number};
+    if (strncmp(line, "send ", 5) == 0 || strcmp(line, "send") == 0)
+      s.kind = 's', s.text += '\r';
+    else if (strncmp(line, "type ", 5) == 0)
+      s.kind = 't';
+    else if (strncmp(line, "wait ", 5) == 0)
+      s.kind = 'w', s.ms = (uint32_t)strtoul(arg, nullptr, 10);
+    else if (strncmp(line, "expect ", 7) == 0)
+      s.kind = 'e';
+    else if (strncmp(line, "capture ", 8) == 0)
+      s.kind = 'c';
+    else
+    {
+      fprintf(stderr, "%s:%d: unknown step '%s'\n", path, number, line);
+      fclose(f);
+      return false;
+    }
+    steps.push_back(s);
+  }
+  fclose(f);
+  return true;
+}
+
+static void finish(int status)
+{
+  fflush(stdout);
+  fflush(stderr);
+  _exit(status); // not exit(): the atexit flushes would wait on a clock that no longer moves
+}
+
+static void fail(const char *what)
+{
+  const SimStep &s = steps[step];
+  fprintf(stderr, "FAIL %s:%d seed %llu at %llu ms: %s '%s'\n", scenario, s.line, (unsigned long long)seed,
+          (unsigned long long)(now_us / 1000U), what, s.text.c_str());
+  size_t from = output.size() > SIM_OUTPUT_TAIL ? output.size() - SIM_OUTPUT_TAIL : 0;
+  fprintf(stderr, "--- output since last match ---\n%s\n---\n", output.substr(from > matched ? from : matched).c_str());
+  finish(1);
+}
+
+/**
+ * @brief  Run scenario steps until one has to wait for the firmware or the clock
+ */
+static void advance_script(void)
+{
+  while (step < steps.size())
+  {
+    SimStep &s = steps[step];
+    if (s.kind == 's' || s.kind == 't')
+    {
+      uint64_t at = now_us;
+      if (pending_head < pending.size() && pending.back().at_us > at)
+        at = pending.back().at_us;
+      at += next_random() % (think_ms * 1000ULL + 1);
+      std::string text;
+      for (char c : s.text)
+        text += c == SIM_CAPTURED ? captured : std::string(1, c);
+      for (char c : text)
+      {
+        at += byte_us + (think_ms ? next_random() % (byte_us / 4 + 1) : 0);
+        pending.push_back({at, (uint8_t)c});
+      }
+    }
+    else if (s.kind == 'w')
+    {
+      if (step_deadline_us == 0)
+        step_deadline_us = now_us + s.ms * 1000ULL;
+      if (now_us < step_deadline_us)
+        return;
+    }
+    else
+    {
+      if (pending_head < pending.size())
+        return; // judge the output only once all input is in
+      size_t found = output.find(s.text, matched);
+      size_t end = found;
+      if (found != std::string::npos && s.kind == 'c')
+        end = output.find_first_of(" .,'\r\n", found + s.text.size());
+      if (end == std::string::npos) // or the captured word is still arriving
+      {
+        if (step_deadline_us == 0)
+          step_deadline_us = now_us + SIM_EXPECT_LIMIT_MS * 1000ULL;
+        if (now_us >= step_deadline_us)
+          fail("expected");
+        return;
+      }
+      matched = found + s.text.size();
+      if (s.kind == 'c')
+      {
+        captured = output.substr(matched, end - matched);
+        matched = end;
+      }
+    }
+    step++;
+    step_deadline_us = 0;
+  }
+  if (pending_head == pending.size())
+    finish(0);
+}
+
+static void run_once(void)
+{
+  rng_state = seed;
+  step = 0;
+  pending.clear();
+  pending_head = 0;
+  output.clear();
+  matched = 0;
+  captured.clear();
+  step_deadline_us = 0;
+  now_us = 0;
+}
+
+bool Sim_Init(void)
+{
+  scenario = getenv("BANK_SIM");
+  if (scenario == nullptr || *scenario == 0)
+    return false;
+  if (!load_scenario(scenario))
+    exit(2);
+  const char *env = getenv("BANK_SIM_SEED");
+  seed = env ? strtoull(env, nullptr, 10) : 1;
+  env = getenv("BANK_SIM_RUNS");
+  uint32_t runs = env ? (uint32_t)strtoul(env, nullptr, 10) : 1;
+  echo = getenv("BANK_SIM_ECHO") != nullptr;
+  env = getenv("BANK_SIM_BAUD");
+  sim_baud = env ? (uint32_t)strtoul(env, nullptr, 10) : 0;
+  env = getenv("BANK_SIM_THINK_MS");
+  think_ms = env ? (uint32_t)strtoul(env, nullptr, 10) : SIM_THINK_MAX_MS;
+  active = true;
+
+  uint32_t failed = 0;
+  for (uint32_t i = 0; i < runs; i++, seed++)
+  {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      perror("fork");
+      exit(2);
+    }
+    if (pid == 0)
+    {
+      run_once();
+      return true; // the child boots the firmware
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failed++;
+  }
+  printf("%s: %lu runs, %lu failed\n", scenario, (unsigned long)runs, (unsigned long)failed);
+  exit(failed ? 1 : 0);
+}
+
+bool Sim_Active(void)
+{
+  return active;
+}
+
+uint64_t Sim_Micros(void)
+{
+  return now_us;
+}
+
+void Sim_Delay(uint32_t ms)
+{
+  now_us += ms * 1000ULL;
+}
+
+void Sim_Transmit(const uint8_t *data, uint16_t size)
+{
+  output.append((const char *)data, size);
+  if (echo)
+    fwrite(data, 1, size, stdout);
+}
+
+void Sim_WaitForInterrupt(UART_HandleTypeDef *huart, USART_TypeDef *usart)
+{
+  if (huart != nullptr && huart->RxState != HAL_UART_STATE_BUSY_RX)
+    huart = nullptr;
+  uint32_t baud = sim_baud;
+  if (baud == 0)
+    baud = huart != nullptr ? huart->Init.BaudRate : HAL_Host_UsartBaud(usart);
+  if (baud != 0)
+    byte_us = 10000000U / baud;
+  advance_script();
+
+  uint64_t tick_us = (now_us / 1000U + 1) * 1000U;
+  bool receiving = huart != nullptr || HAL_Host_UsartReceiving(usart);
+  if (receiving && pending_head < pending.size() && pending[pending_head].at_us <= tick_us)
+  {
+    if (pending[pending_head].at_us > now_us)
+      now_us = pending[pending_head].at_us;
+    uint8_t byte = pending[pending_head++].byte;
+    if (huart != nullptr)
+      HAL_Host_ReceiveByte(huart, byte);
+    else
+      HAL_Host_UsartReceive(usart, byte);
+    return;
+  }
+  now_us = tick_us;
+}
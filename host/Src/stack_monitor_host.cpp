@@ -0,0 +1,39 @@
+/* Host stand-in for the stack monitor: the process stack is managed by the OS. */
+
+#include "stack_monitor.h"
+
+void Stack_Paint(void)
+{
+}
+
+uint32_t Stack_GetSize(void)
+{
+  return 0;
+}
+
+uint32_t Stack_GetReserved(void)
+{
+  return 0;
+}
+
+uint32_t Stack_GetHighWaterMark(void)
+{
+  return 0;
+}
+
+const FaultRecord *Fault_GetLastRecord(void)
+{
+  return nullptr;
+}
+
+void Fault_ClearRecord(void)
+{
+}
+
+void Fault_Capture(uint32_t *frame, uint32_t exc_return, uint32_t fault_type)
+{
+  (void)frame;
+  (void)exc_return;
+  (void)fault_type;
+  __builtin_trap();
+}
@@ -0,0 +1,81 @@
+/* Host trace drain: when BANK_TRACE names a file, every record is appended */
+/* to it as it is drained, after a header of "EBTR", format version and */
+/* counter cycles per microsecond. tools/trace2json.py converts the file. */
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_FILE_VERSION              1U
+
+static FILE *file = nullptr;
+static bool opened = false;
+static uint32_t cycles_per_us = 0;
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void drain_at_exit(void)
+{
+  Trace_Drain();
+  fclose(file);
+  file = nullptr;
+}
+
+static bool open_file(void)
+{
+  opened = true;
+  const char *path = getenv("BANK_TRACE");
+  if (path == nullptr || *path == 0)
+    return false;
+  file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    perror(path);
+    return false;
+  }
+  uint32_t header[3] = {0, TRACE_FILE_VERSION, Trace_CyclesPerUs()};
+  memcpy(header, "EBTR", 4);
+  fwrite(header, sizeof(header), 1, file);
+  atexit(drain_at_exit);
+  return true;
+}
+
+void Trace_Drain(void)
+{
+  if (!opened)
+    open_file();
+  if (file == nullptr)
+    return;
+
+  TraceRecord r;
+  while (Trace_Next(&r))
+    fwrite(&r, sizeof(r), 1, file);
+}
+
+/**
+ * @brief  Counter rate, measured once against the monotonic clock
+ */
+uint32_t Trace_CyclesPerUs(void)
+{
+  if (cycles_per_us == 0)
+  {
+    uint64_t start_ns = monotonic_ns();
+    uint32_t start = CycleCounter_Read();
+    while (monotonic_ns() - start_ns < 10000000U)
+    {
+    }
+    uint32_t cycles = CycleCounter_Read() - start;
+    uint64_t ns = monotonic_ns() - start_ns;
+    cycles_per_us = (uint32_t)((cycles * 1000ULL + ns / 2) / ns);
+    if (cycles_per_us == 0)
+      cycles_per_us = 1;
+  }
+  return cycles_per_us;
+}
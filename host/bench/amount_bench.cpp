@@ -0,0 +1,113 @@
+/* amount-bench: the console amount parser against atof()/strtod(). Shows what */
+/* each makes of malformed input, then times them on valid amounts. */
+/* Usage: amount-bench [amounts] */
+
+#include "amount_parser.h"
+#include "cycle_counter.h"
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct Case
+{
+    const char *text;
+    AmountError expected;
+    amount_t minor; // expected value when AMOUNT_OK
+};
+
+static const Case cases[] = {
+    {"25", AMOUNT_OK, 2500},
+    {"25.5", AMOUNT_OK, 2550},
+    {"25.05", AMOUNT_OK, 2505},
+    {"+0.01", AMOUNT_OK, 1},
+    {"21474836.47", AMOUNT_OK, INT32_MAX},
+    {"0.29", AMOUNT_OK, 29}, // 0.29 * 100 is 28.999... in binary floating point
+    {"10#7f3a", AMOUNT_OK, 1000},
+    {"", AMOUNT_EMPTY, 0},
+    {"-5", AMOUNT_NEGATIVE, 0},
+    {"12abc", AMOUNT_BAD_FORMAT, 0},
+    {"abc", AMOUNT_BAD_FORMAT, 0},
+    {" 7", AMOUNT_BAD_FORMAT, 0},
+    {"1e3", AMOUNT_BAD_FORMAT, 0},
+    {"0x10", AMOUNT_BAD_FORMAT, 0},
+    {".5", AMOUNT_BAD_FORMAT, 0},
+    {"5.", AMOUNT_BAD_FORMAT, 0},
+    {"1.2.3", AMOUNT_BAD_FORMAT, 0},
+    {"1.234", AMOUNT_TOO_MANY_DECIMALS, 0},
+    {"123456789", AMOUNT_TOO_MANY_DIGITS, 0},
+    {"21474836.48", AMOUNT_OUT_OF_RANGE, 0},
+    {"0", AMOUNT_OUT_OF_RANGE, 0},
+    {"0.00", AMOUNT_OUT_OF_RANGE, 0},
+    {"10#", AMOUNT_BAD_REQUEST_ID, 0},
+    {"10#xyz", AMOUNT_BAD_REQUEST_ID, 0},
+    {"10#123456789", AMOUNT_BAD_REQUEST_ID, 0},
+};
+
+/* What manage_account() used to do with the line */
+static amount_t atof_minor(const char *text)
+{
+    return (amount_t)(atof(text) * AMOUNT_SCALE);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    bool ok = true;
+
+    printf("%-14s %-26s %12s %12s\n", "input", "parse_amount", "minor units", "atof minor");
+    for (const Case &c : cases)
+    {
+        amount_t minor = 0;
+        AmountError error = parse_amount((const uint8_t *)c.text, strlen(c.text), &minor, nullptr);
+        bool pass = error == c.expected && (error != AMOUNT_OK || minor == c.minor);
+        ok = ok && pass;
+        char value[16] = "-";
+        if (error == AMOUNT_OK)
+            snprintf(value, sizeof(value), "%ld", (long)minor);
+        printf("%-14s %-26.26s %12s %12ld%s\n", c.text[0] ? c.text : "(empty)", amount_error_text(error), value,
+               (long)atof_minor(c.text), pass ? "" : "  MISMATCH");
+    }
+
+    std::mt19937 rng(3);
+    std::vector<std::string> inputs(count);
+    for (auto &text : inputs)
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%u.%02u", (unsigned)(rng() % 1000000), (unsigned)(rng() % 100));
+        text = buf;
+    }
+
+    int64_t sum_parser = 0, sum_atof = 0, sum_strtod = 0;
+    uint32_t start = CycleCounter_Read();
+    for (const auto &text : inputs)
+    {
+        amount_t minor = 0;
+        parse_amount((const uint8_t *)text.data(), text.size(), &minor, nullptr);
+        sum_parser += minor;
+    }
+    uint32_t parser_cycles = CycleCounter_Read() - start;
+
+    start = CycleCounter_Read();
+    for (const auto &text : inputs)
+        sum_atof += (amount_t)(atof(text.c_str()) * AMOUNT_SCALE + 0.5);
+    uint32_t atof_cycles = CycleCounter_Read() - start;
+
+    start = CycleCounter_Read();
+    for (const auto &text : inputs)
+        sum_strtod += (amount_t)(strtod(text.c_str(), nullptr) * AMOUNT_SCALE + 0.5);
+    uint32_t strtod_cycles = CycleCounter_Read() - start;
+
+    printf("\n%zu amounts          cycles/amount\n", count);
+    printf("parse_amount       %10.1f\n", (double)parser_cycles / count);
+    printf("atof               %10.1f\n", (double)atof_cycles / count);
+    printf("strtod             %10.1f\n", (double)strtod_cycles / count);
+    if (sum_parser != sum_atof || sum_parser != sum_strtod)
+    {
+        printf("sums differ: %lld %lld %lld\n", (long long)sum_parser, (long long)sum_atof, (long long)sum_strtod);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/* balance-bench: contention on a single account, lock-free CAS vs a mutex. */
+/* Every thread loops withdraw(1) / deposit(1) on the same account; the */
+/* balance must end where it started and withdraw() must never overdraw. */
+/* Usage: balance-bench [max threads] [seconds per point] */
+
+#include "bank_account.h"
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/* Baseline: the pre-atomic check-then-update under a lock */
+class LockedAccount
+{
+private:
+    std::mutex lock;
+    amount_t balance;
+
+public:
+    explicit LockedAccount(amount_t balance) : balance(balance) {}
+    void deposit(amount_t amount)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        balance += amount;
+    }
+    bool withdraw(amount_t amount)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (balance < amount)
+            return false;
+        balance -= amount;
+        return true;
+    }
+    amount_t get_account_balance()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return balance;
+    }
+};
+
+template <typename Account>
+static double run(Account &account, unsigned threads, double seconds, uint64_t &failed)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> ops(0), rejected(0);
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]() {
+            uint64_t done = 0, misses = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (account.withdraw(1))
+                {
+                    account.deposit(1);
+                    done += 2;
+                }
+                else
+                {
+                    misses++;
+                    done++;
+                }
+            }
+            ops += done;
+            rejected += misses;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : pool)
+        t.join();
+    failed = rejected;
+    return ops / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = argc > 1 ? (unsigned)atoi(argv[1]) : std::thread::hardware_concurrency();
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+    const uint8_t name[NAMESIZE] = "bench";
+    const uint8_t password[PASSWORDSIZE] = "bench";
+    int status = 0;
+
+    printf("%8s %14s %14s %10s %10s\n", "threads", "atomic ops/s", "mutex ops/s", "rejected", "balance");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+        /* Fewer units than threads, so withdrawals really race for the last cent */
+        const amount_t opening = threads > 1 ? threads / 2 : 1;
+        BankAccount account(name, password);
+        account.deposit(opening);
+        LockedAccount locked(opening);
+
+        uint64_t rejected = 0, locked_rejected = 0;
+        double atomic_rate = run(account, threads, seconds, rejected);
+        double mutex_rate = run(locked, threads, seconds, locked_rejected);
+
+        bool ok = account.get_account_balance() == opening && locked.get_account_balance() == opening;
+        printf("%8u %14.0f %14.0f %10llu %10s\n", threads, atomic_rate, mutex_rate,
+               (unsigned long long)rejected, ok ? "ok" : "CORRUPT");
+        if (!ok)
+            status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,146 @@
+/* bank-bench: the same Bank template built with different storage and index */
+/* strategies, from the 10-account console configuration up to a 1M-account */
+/* host bank, with short ids or customer names up to NAME_LEN_MAX. Reports */
+/* object size, bytes per account with names in the arena (the account and */
+/* its name entry) and with a fixed field of the bank's name size instead, */
+/* create rate and login (authenticate) rate. Then renames accounts to */
+/* fragment the name arena and times a compaction. */
+/* Usage: bank-bench [logins per configuration] */
+
+#include "bank.h"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const char *const first_names[] = {"Ana", "Bartholomew", "Chen", "Dmitri", "Eleanor", "Fatima", "Giovanni",
+                                          "Hiroshi", "Ingrid", "Jean-Baptiste", "Kwame", "Lakshmi", "Maximilian",
+                                          "Nkechi", "Olu", "Persephone"};
+static const char *const last_names[] = {"Li", "Okonkwo", "Van der Merwe", "Garcia Marquez", "Nguyen", "Abernathy",
+                                         "Rasmussen", "Ito", "Papadopoulos", "Khan", "O'Sullivan",
+                                         "Wojciechowska", "Silva", "Montgomery-Smythe", "Kim", "Haddad"};
+
+/* size bytes, 0-padded: "u<i>", or a customer name made unique by i */
+static void make_name(uint32_t i, uint8_t *name, size_t size, bool customer)
+{
+    memset(name, 0, size);
+    if (customer)
+        snprintf((char *)name, size, "%s %s %u", first_names[i % 16], last_names[i / 16 % 16], i / 256);
+    else
+        snprintf((char *)name, size, "u%u", i);
+}
+
+template <typename BankType>
+static bool run(const char *label, uint64_t logins, bool customer)
+{
+    NameArenaStats before, after;
+    Names().get_stats(&before);
+    std::unique_ptr<BankType> bank(new BankType);
+    uint8_t name[BankType::name_size()], password[PASSWORDSIZE] = {'p', 'w'};
+
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < BankType::capacity(); i++)
+    {
+        uint32_t id;
+        make_name(i, name, sizeof(name), customer);
+        if (bank->create(name, password, &id) != BankType::CreateStatus::Created || id != i)
+        {
+            printf("%s: create %u failed\n", label, i);
+            return false;
+        }
+    }
+    double create_s = std::chrono::duration<double>(Clock::now() - start).count();
+    uint32_t id;
+    if (bank->create(name, password, &id) != BankType::CreateStatus::NameTaken)
+    {
+        printf("%s: duplicate name accepted\n", label);
+        return false;
+    }
+    Names().get_stats(&after);
+
+    std::mt19937 rng(1);
+    uint64_t found = 0;
+    start = Clock::now();
+    for (uint64_t i = 0; i < logins; i++)
+    {
+        make_name(rng() % BankType::capacity(), name, sizeof(name), customer);
+        found += bank->authenticate(name, password) != nullptr;
+    }
+    double login_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double name_bytes = (double)(after.used - before.used) / BankType::capacity();
+    printf("%-34s %9zu %12zu %8.1f %8zu %14.0f %14.0f\n", label, BankType::capacity(), sizeof(BankType),
+           sizeof(BankAccount) + name_bytes, sizeof(BankAccount) - sizeof(NameHandle) + BankType::name_size(),
+           BankType::capacity() / create_s, logins / login_s);
+    bank.reset();
+    Names().compact([](auto) {}); // the bank held the only live names
+    return found == logins;
+}
+
+/* Rename every account of a bank a few times, as replicated records with */
+/* new names would, then compact and check that every name is still found */
+static bool churn()
+{
+    typedef Bank<1000, NAMESIZE, StaticStorage, LinearIndex> ChurnBank;
+    const uint32_t renames = 3;
+    std::unique_ptr<ChurnBank> bank(new ChurnBank);
+    uint8_t name[NAMESIZE], password[PASSWORDSIZE] = {'p', 'w'};
+    for (uint32_t i = 0; i < ChurnBank::capacity(); i++)
+    {
+        uint32_t id;
+        make_name(i, name, sizeof(name), false);
+        bank->create(name, password, &id);
+    }
+    AccountRecord record;
+    for (uint32_t round = 1; round <= renames; round++)
+    {
+        for (uint32_t i = 0; i < ChurnBank::capacity(); i++)
+        {
+            (*bank)[i].to_record(&record);
+            memset(record.name, 0, sizeof(record.name));
+            snprintf((char *)record.name, sizeof(record.name), "r%u.%u", round, i);
+            (*bank)[i].from_record(record);
+        }
+    }
+
+    NameArenaStats before, after;
+    Names().get_stats(&before);
+    auto start = Clock::now();
+    bank->compact_names();
+    double compact_s = std::chrono::duration<double>(Clock::now() - start).count();
+    Names().get_stats(&after);
+
+    bool ok = after.dead_bytes == 0 && after.names == ChurnBank::capacity();
+    for (uint32_t i = 0; i < ChurnBank::capacity() && ok; i++)
+    {
+        memset(name, 0, NAMESIZE);
+        snprintf((char *)name, NAMESIZE, "r%u.%u", renames, i);
+        ok = bank->find(name) == &(*bank)[i] && strcmp((const char *)(*bank)[i].get_account_name(), (char *)name) == 0;
+    }
+    printf("\ncompaction: %u names renamed %u times, %u of %u bytes released (%.0f%% fragmentation),\n"
+           "%u bytes reclaimed in %.1f us, %u bytes in use after; lookups %s\n",
+           after.names, renames, before.dead_bytes, before.used, 100.0 * before.dead_bytes / before.used,
+           after.reclaimed_bytes - before.reclaimed_bytes, compact_s * 1e6, after.used, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t logins = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    printf("%-34s %9s %12s %8s %8s %14s %14s\n", "configuration", "accounts", "sizeof(Bank)", "B/acct", "fixed",
+           "creates/s", "logins/s");
+    bool ok = true;
+    ok = run<ConsoleBank>("console: static, linear", logins, false) && ok;
+    ok = run<ConsoleBank>("console, customer names", logins, true) && ok;
+    ok = run<Bank<1000, NAMESIZE, StaticStorage, LinearIndex>>("static, linear", logins, false) && ok;
+    ok = run<Bank<1000, NAMESIZE, StaticStorage, HashIndex>>("static, hash", logins, false) && ok;
+    ok = run<Bank<1000, NAME_LEN_MAX, StaticStorage, LinearIndex>>("static, linear, customer names", logins, true) && ok;
+    ok = run<Bank<1000000, NAMESIZE, HeapStorage, HashIndex>>("heap, hash", logins, false) && ok;
+    ok = run<Bank<1000000, NAME_LEN_MAX, HeapStorage, HashIndex>>("heap, hash, customer names", logins, true) && ok;
+    ok = churn() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+/* column-bench: bulk ledger kernels over the balance column at 10K to 10M */
+/* accounts, per kernel (scalar, SSE4.1, AVX2) on one thread and on every */
+/* core, against the same jobs over an array of BankAccount objects. Every */
+/* vector kernel's results are checked against the scalar one, and a small */
+/* table is taken through load, find_inactive, apply_rate and store, mapped */
+/* and as objects. */
+/* Usage: column-bench [max accounts] [threads, 0 for one per core] */
+
+#include "balance_column.h"
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+using Kernel = BalanceColumn::Kernel;
+
+static const amount_t edges[] = {INT32_MIN, 0, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+static const size_t EDGE_COUNT = sizeof(edges) / sizeof(edges[0]);
+static const int32_t TODAY = 20000;
+
+static double seconds_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Results of one pass over the column, compared between kernels */
+struct Results
+{
+    int64_t sum;
+    std::vector<uint32_t> negative;
+    std::vector<uint32_t> dormant;
+    uint64_t histogram[EDGE_COUNT];
+    std::vector<amount_t> after_rate;
+};
+
+/* Best of a few runs, in ns per account */
+template <typename Fn>
+static double time_ns(size_t accounts, Fn fn)
+{
+    int runs = accounts >= 1000000 ? 3 : 20;
+    double best = 1e30;
+    for (int r = 0; r < runs; r++)
+    {
+        double start = seconds_now();
+        fn();
+        double t = seconds_now() - start;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / accounts;
+}
+
+static void fill(BalanceColumn &column, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    amount_t *b = column.balance_data();
+    int32_t *days = column.last_active_data();
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        /* Mostly small balances, a long tail, a few overdrawn */
+        uint32_t r = rng();
+        b[i] = (amount_t)(r % 100 == 0 ? -(int32_t)(rng() % 50000) : (int32_t)(rng() % (1U << (r % 28))));
+        days[i] = TODAY - (int32_t)(rng() % 3650);
+    }
+}
+
+static bool same(const Results &a, const Results &b)
+{
+    return a.sum == b.sum && a.negative == b.negative && a.dormant == b.dormant &&
+           memcmp(a.histogram, b.histogram, sizeof(a.histogram)) == 0 && a.after_rate == b.after_rate;
+}
+
+static bool run_size(size_t accounts, unsigned threads)
+{
+    BalanceColumn column(accounts);
+    if (column.size() != accounts)
+    {
+        printf("cannot allocate %zu accounts\n", accounts);
+        return false;
+    }
+    const int32_t rate = BalanceColumn::rate_from_percent(0.25);
+    std::vector<amount_t> original(accounts);
+    fill(column, (uint32_t)accounts);
+    memcpy(original.data(), column.balance_data(), accounts * sizeof(amount_t));
+
+    bool ok = true;
+    Results reference;
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Sse41, Kernel::Avx2})
+    {
+        if (!column.use(kernel))
+            continue;
+        for (unsigned t : {1U, threads})
+        {
+            column.set_threads(t);
+            if (t > 1 && column.size() < BalanceColumn::PARALLEL_MIN)
+                break; // would run on one thread anyway
+            Results res;
+            memcpy(column.balance_data(), original.data(), accounts * sizeof(amount_t));
+            double sum_ns = time_ns(accounts, [&]() { res.sum = column.sum(); });
+            double below_ns = time_ns(accounts, [&]() { column.find_below(0, res.negative); });
+            double dormant_ns = time_ns(accounts, [&]() { column.find_inactive(TODAY - 3000, res.dormant); });
+            double hist_ns = time_ns(accounts, [&]() { column.histogram(edges, EDGE_COUNT, res.histogram); });
+            column.apply_rate(rate);
+            res.after_rate.assign(column.balance_data(), column.balance_data() + accounts);
+            double rate_ns = time_ns(accounts, [&]() { column.apply_rate(rate); });
+
+            if (kernel == Kernel::Scalar && t == 1)
+                reference = res;
+            else if (!same(res, reference))
+            {
+                printf("%s on %u threads differs from scalar at %zu accounts\n", BalanceColumn::kernel_name(kernel),
+                       t, accounts);
+                ok = false;
+            }
+            printf("%10zu %-7s %3u %9.3f %9.3f %9.3f %9.3f %9.3f\n", accounts, BalanceColumn::kernel_name(kernel),
+                   column.size() >= BalanceColumn::PARALLEL_MIN ? t : 1, sum_ns, rate_ns, below_ns, dormant_ns,
+                   hist_ns);
+            if (threads == 1)
+                break;
+        }
+    }
+
+    /* Baseline: the same jobs over BankAccount objects, balance interleaved */
+    /* with id, name and password */
+    std::vector<BankAccount> table(accounts);
+    for (size_t i = 0; i < accounts; i++)
+        if (original[i] > 0)
+            table[i].deposit(original[i]);
+    volatile int64_t sink = 0;
+    double sum_ns = time_ns(accounts, [&]() { sink = BankAccount::total_balance(table.data(), table.size()); });
+    double rate_ns = time_ns(accounts, [&]() {
+        for (BankAccount &account : table)
+        {
+            amount_t b = account.get_account_balance();
+            amount_t delta = (amount_t)(((int64_t)b * rate + (1LL << (BalanceColumn::RATE_SHIFT - 1))) >>
+                                        BalanceColumn::RATE_SHIFT);
+            if (delta > 0)
+                account.deposit(delta);
+        }
+    });
+    std::vector<uint32_t> below;
+    double below_ns = time_ns(accounts, [&]() {
+        below.clear();
+        for (size_t i = 0; i < table.size(); i++)
+            if (table[i].get_account_balance() < 0)
+                below.push_back((uint32_t)i);
+    });
+    printf("%10zu %-7s %3u %9.3f %9.3f %9.3f %9s %9s\n", accounts, "objects", 1U, sum_ns, rate_ns, below_ns, "-", "-");
+    (void)sink;
+    return ok;
+}
+
+/* What apply_rate() makes of a balance well inside the amount_t range */
+static amount_t with_rate(amount_t balance, int32_t rate)
+{
+    return balance + (amount_t)(((int64_t)balance * rate + (1LL << (BalanceColumn::RATE_SHIFT - 1))) >>
+                                BalanceColumn::RATE_SHIFT);
+}
+
+/* Dormant accounts and interest, from a mapped table and BankAccount */
+/* objects into the column and back */
+static bool round_trip(size_t accounts)
+{
+    const int32_t rate = BalanceColumn::rate_from_percent(0.25);
+    const int32_t cutoff = TODAY - 3000;
+    char path[] = "/tmp/column-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        printf("round trip: cannot create a table file\n");
+        return false;
+    }
+    close(fd);
+
+    MappedAccountTable table;
+    std::vector<BankAccount> objects(accounts);
+    std::vector<amount_t> expected(accounts);
+    std::vector<uint32_t> dormant, expected_dormant;
+    std::mt19937 rng(7);
+    uint8_t name[NAMESIZE] = {0}, password[PASSWORDSIZE] = {'p', 'w'};
+    bool ok = table.create(path, accounts);
+    for (size_t i = 0; i < accounts && ok; i++)
+    {
+        snprintf((char *)name, sizeof(name), "c%zu", i % 100000000);
+        amount_t balance = (amount_t)(rng() % 1000000);
+        int32_t day = TODAY - (int32_t)(rng() % 3650);
+        ok = table.add(name, password) == (int64_t)i && table.deposit(i, balance) && objects[i].deposit(balance);
+        table.set_last_active(i, day);
+        if (day < cutoff)
+            expected_dormant.push_back((uint32_t)i);
+        expected[i] = with_rate(balance, rate);
+    }
+
+    BalanceColumn column(accounts);
+    column.load(table);
+    column.find_inactive(cutoff, dormant);
+    bool dormant_ok = ok && dormant == expected_dormant;
+    column.apply_rate(rate);
+    column.store(table);
+    table.close();
+    bool table_ok = ok && table.open(path);
+    for (size_t i = 0; i < accounts && table_ok; i++)
+        table_ok = table.balance(i) == expected[i];
+    table.close();
+    unlink(path);
+
+    column.load(objects.data(), accounts, TODAY);
+    column.find_inactive(cutoff, dormant);
+    bool objects_ok = ok && dormant.empty();
+    column.apply_rate(rate);
+    objects_ok = column.store(objects.data(), accounts) == 0 && objects_ok;
+    for (size_t i = 0; i < accounts && objects_ok; i++)
+        objects_ok = objects[i].get_account_balance() == expected[i];
+
+    printf("round trip of %zu accounts: %zu dormant %s, table store %s, objects %s\n\n", accounts,
+           expected_dormant.size(), dormant_ok ? "ok" : "FAILED", table_ok ? "ok" : "FAILED",
+           objects_ok ? "ok" : "FAILED");
+    return dormant_ok && table_ok && objects_ok;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_accounts = argc > 1 ? (size_t)atoll(argv[1]) : 10000000;
+    unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    if (threads == 0)
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    BalanceColumn probe(0);
+
+    bool ok = round_trip(10000);
+    printf("ns per account; best kernel here: %s, %u threads\n", BalanceColumn::kernel_name(probe.active_kernel()),
+           threads);
+    printf("%10s %-7s %3s %9s %9s %9s %9s %9s\n", "accounts", "kernel", "thr", "sum", "rate", "below", "dormant",
+           "histogram");
+    for (size_t accounts = 10000; accounts <= max_accounts; accounts *= 10)
+        ok = run_size(accounts, threads) && ok;
+    return ok ? 0 : 1;
+}
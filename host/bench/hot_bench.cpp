@@ -0,0 +1,125 @@
+/* hot-bench: deposit throughput on a single account from 1 to N threads, */
+/* with the account normal (every deposit a CAS on the one balance) and hot */
+/* (deposits spread over per-thread slices, see BankAccount::make_hot()). A */
+/* reader thread checks that the merged balance never goes backwards, and a */
+/* mixed run of deposits and withdrawals checks that withdraw() still never */
+/* overdraws and every cent is accounted for. */
+/* Usage: hot-bench [max threads] [seconds per point] */
+
+#include "bank_account.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+struct Result
+{
+    double rate;
+    uint64_t deposited;
+    uint64_t withdrawn;
+    uint64_t refused;
+    bool backwards;
+};
+
+/* Every thread deposits 1 in a loop; with withdraw_every, every n'th */
+/* operation is a withdrawal of 3 instead */
+static Result run(BankAccount &account, unsigned threads, double seconds, unsigned withdraw_every)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> deposited(0), withdrawn(0), refused(0);
+    std::atomic<bool> backwards(false);
+    std::vector<std::thread> pool;
+
+    std::thread reader([&]() {
+        amount_t last = account.get_account_balance();
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            amount_t now = account.get_account_balance();
+            if (withdraw_every == 0 && now < last)
+                backwards = true;
+            if (now < 0)
+                backwards = true;
+            last = now;
+        }
+    });
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]() {
+            uint64_t in = 0, out = 0, no = 0;
+            for (unsigned i = 1; !stop.load(std::memory_order_relaxed); i++)
+            {
+                if (withdraw_every != 0 && i % withdraw_every == 0)
+                {
+                    if (account.withdraw(3))
+                        out += 3;
+                    else
+                        no++;
+                }
+                else if (account.deposit(1))
+                    in++;
+                else
+                    no++;
+            }
+            deposited += in;
+            withdrawn += out;
+            refused += no;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : pool)
+        t.join();
+    reader.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {(deposited + withdrawn / 3 + refused) / elapsed, deposited, withdrawn, refused, backwards};
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = argc > 1 ? (unsigned)atoi(argv[1]) : std::thread::hardware_concurrency();
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+    const uint8_t name[NAMESIZE] = "bench";
+    const uint8_t password[PASSWORDSIZE] = "bench";
+    int status = 0;
+    if (max_threads == 0)
+        max_threads = 1;
+
+    printf("%u slices of at most %d\n", HOT_SLICES, HOT_SLICE_MAX);
+    printf("%8s %16s %16s %8s %10s\n", "threads", "normal dep/s", "hot dep/s", "speedup", "balance");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+        BankAccount normal(name, password);
+        BankAccount hot(name, password);
+        HotSlices slices;
+        hot.make_hot(&slices);
+
+        Result a = run(normal, threads, seconds, 0);
+        Result b = run(hot, threads, seconds, 0);
+        bool ok = !a.backwards && !b.backwards && a.refused == 0 && b.refused == 0 &&
+                  normal.get_account_balance() == (amount_t)a.deposited &&
+                  hot.get_account_balance() == (amount_t)b.deposited;
+        printf("%8u %16.0f %16.0f %7.2fx %10s\n", threads, a.rate, b.rate, b.rate / a.rate, ok ? "ok" : "CORRUPT");
+        if (!ok)
+            status = 1;
+    }
+
+    /* Withdrawals race the slices: they must never overdraw, and what was */
+    /* deposited minus what was withdrawn must be exactly what is left */
+    printf("\n%8s %16s %12s %12s %10s\n", "threads", "mixed ops/s", "withdrawn", "refused", "balance");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+        BankAccount hot(name, password);
+        HotSlices slices;
+        hot.make_hot(&slices);
+        Result r = run(hot, threads, seconds, 2);
+        bool ok = !r.backwards && hot.get_account_balance() >= 0 &&
+                  (uint64_t)hot.get_account_balance() == r.deposited - r.withdrawn;
+        printf("%8u %16.0f %12llu %12llu %10s\n", threads, r.rate, (unsigned long long)r.withdrawn,
+               (unsigned long long)r.refused, ok ? "ok" : "CORRUPT");
+        if (!ok)
+            status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,89 @@
+/* seqlock-stress: writers move money between random accounts with transfer(), */
+/* readers sum the whole table. Transfers conserve the total, so any reader that */
+/* sees a different total has observed a torn snapshot. */
+/* Usage: seqlock-stress [writers] [readers] [accounts] [seconds] */
+
+#include "bank_account.h"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    unsigned writers = argc > 1 ? (unsigned)atoi(argv[1]) : 4;
+    unsigned readers = argc > 2 ? (unsigned)atoi(argv[2]) : 2;
+    size_t count = argc > 3 ? (size_t)atoi(argv[3]) : 1000;
+    double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+    const amount_t opening = 1000;
+
+    std::vector<BankAccount> accounts;
+    accounts.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t name[24] = {0}; // "s" and any size_t; the account keeps NAMESIZE
+        snprintf((char *)name, sizeof(name), "s%zu", i);
+        accounts.emplace_back(name, name);
+        accounts.back().deposit(opening);
+    }
+    const int64_t expected = (int64_t)opening * (int64_t)count;
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> transfers(0), snapshots(0), torn(0), naive_torn(0);
+    std::vector<std::thread> threads;
+
+    for (unsigned w = 0; w < writers; w++)
+    {
+        threads.emplace_back([&, w]() {
+            std::mt19937 rng(w + 1);
+            std::uniform_int_distribution<size_t> pick(0, count - 1);
+            std::uniform_int_distribution<amount_t> amount(1, opening);
+            uint64_t done = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (BankAccount::transfer(accounts[pick(rng)], accounts[pick(rng)], amount(rng)))
+                    done++;
+            }
+            transfers += done;
+        });
+    }
+
+    for (unsigned r = 0; r < readers; r++)
+    {
+        threads.emplace_back([&]() {
+            uint64_t done = 0, bad = 0, naive_bad = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (BankAccount::total_balance(accounts.data(), count) != expected)
+                    bad++;
+
+                /* The same sum without the sequence lock, for comparison */
+                int64_t naive = 0;
+                for (size_t i = 0; i < count; i++)
+                    naive += accounts[i].get_account_balance();
+                if (naive != expected)
+                    naive_bad++;
+                done++;
+            }
+            snapshots += done;
+            torn += bad;
+            naive_torn += naive_bad;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+
+    int64_t final_total = BankAccount::total_balance(accounts.data(), count);
+    printf("%u writers, %u readers, %zu accounts, %.1f s\n", writers, readers, count, seconds);
+    printf("transfers/s:        %12.0f\n", transfers / seconds);
+    printf("snapshots/s:        %12.0f\n", snapshots / seconds);
+    printf("torn snapshots:     %12llu\n", (unsigned long long)torn.load());
+    printf("torn without lock:  %12llu\n", (unsigned long long)naive_torn.load());
+    printf("final total:        %12lld (expected %lld)\n", (long long)final_total, (long long)expected);
+    return torn == 0 && final_total == expected ? 0 : 1;
+}
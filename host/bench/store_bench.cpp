@@ -0,0 +1,113 @@
+/* store-bench: write-back of the account table to the modelled I2C EEPROM and */
+/* FRAM at several transaction rates. Reports page writes, bus bytes, the */
+/* worst time from a change to its page being durable and the mean and worst */
+/* time AccountStore_Service() holds the main loop, then checks that a reload */
+/* matches the live balances. */
+/* Usage: store-bench [seconds per run] [file] */
+
+#include "account_store.h"
+#include "ext_mem_host.h"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Model
+{
+    const char *name;
+    uint32_t i2c_hz;
+    uint32_t write_cycle_us;
+};
+
+static bool run(const Model &model, uint32_t rate, double seconds)
+{
+    ExtMem_HostSetModel(model.i2c_hz, model.write_cycle_us);
+    AccountStore_Init();
+
+    ConsoleBank accounts;
+    for (uint16_t i = 0; i < MAX_ACCOUNTS; i++)
+    {
+        uint8_t name[ConsoleBank::name_size()] = {0}, password[PASSWORDSIZE] = {0};
+        uint32_t id = 0;
+        snprintf((char *)name, sizeof(name), "acct%u", i);
+        accounts.create(name, password, &id);
+        accounts[id].deposit(100000);
+        AccountStore_Update(accounts[id]);
+    }
+
+    std::mt19937 rng(rate);
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    auto interval = rate ? std::chrono::duration<double>(1.0 / rate) : std::chrono::duration<double>(0);
+    auto next_tx = start;
+    double worst_stall_us = 0, total_stall_us = 0;
+    uint64_t services = 0;
+    uint64_t transactions = 0;
+    for (auto now = start; now < end; now = Clock::now())
+    {
+        if (now >= next_tx)
+        {
+            BankAccount &account = accounts[rng() % MAX_ACCOUNTS];
+            if (rng() & 1 ? account.deposit(rng() % 1000) : account.withdraw(rng() % 1000))
+                AccountStore_Update(account);
+            transactions++;
+            next_tx += std::chrono::duration_cast<Clock::duration>(interval);
+        }
+        auto t0 = Clock::now();
+        AccountStore_Service();
+        double stall = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        if (stall > worst_stall_us)
+            worst_stall_us = stall;
+        total_stall_us += stall;
+        services++;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    bool flushed = AccountStore_Flush(1000);
+
+    AccountStoreStats stats;
+    AccountStore_GetStats(&stats);
+    char rate_text[16];
+    snprintf(rate_text, sizeof(rate_text), rate ? "%lu" : "max", (unsigned long)rate);
+    printf("%-7s %8s %10.0f %10.0f %10.0f %10.0f %10lu %10.0f %10.1f\n", model.name, rate_text,
+           transactions / elapsed, (double)stats.updates / elapsed, stats.page_writes / elapsed,
+           stats.bytes_written / elapsed, (unsigned long)stats.max_latency_ms,
+           services ? total_stall_us * 1000 / services : 0.0, worst_stall_us);
+
+    ConsoleBank reloaded;
+    uint16_t restored = AccountStore_Load(reloaded);
+    bool match = flushed && restored == MAX_ACCOUNTS;
+    for (uint16_t i = 0; match && i < MAX_ACCOUNTS; i++)
+        match = reloaded[i].get_account_balance() == accounts[i].get_account_balance();
+    if (!match)
+        printf("reload does not match the live table (%u restored, flushed %d)\n", restored, flushed);
+    return match;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    if (argc > 2 && !ExtMem_HostOpen(argv[2]))
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    HAL_Init();
+
+    const Model models[] = {
+        {"eeprom", EXT_MEM_I2C_SPEED, EXT_MEM_WRITE_CYCLE_MS * 1000U},
+        {"fram", 1000000U, 0},
+    };
+    const uint32_t rates[] = {10, 100, 1000, 0};
+
+    printf("%u accounts, %u-byte records, %u-byte pages\n", MAX_ACCOUNTS, (unsigned)sizeof(AccountRecord),
+           EXT_MEM_PAGE_SIZE);
+    printf("%-7s %8s %10s %10s %10s %10s %10s %10s %10s\n", "device", "tx/s", "tx/s done", "updates/s",
+           "pages/s", "bytes/s", "worst ms", "svc ns", "max svc us");
+    bool ok = true;
+    for (const Model &model : models)
+        for (uint32_t rate : rates)
+            ok = run(model, rate, seconds) && ok;
+    return ok ? 0 : 1;
+}
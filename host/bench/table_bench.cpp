@@ -0,0 +1,184 @@
+/* table-bench: startup and random access of the memory-mapped account table */
+/* against rebuilding the table in memory from the same file. */
+/* Usage: table-bench [accounts] [random ops] [file] */
+
+#include "account_table.h"
+#include <chrono>
+#include <fcntl.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Record = MappedAccountTable::Record;
+
+static double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void account_name(uint64_t i, uint8_t *name)
+{
+    char text[24]; // "a" and any 64-bit number
+    snprintf(text, sizeof(text), "a%08llu", (unsigned long long)i);
+    memcpy(name, text, NAMESIZE - 1);
+    name[NAMESIZE - 1] = 0;
+}
+
+/* The alternative to mapping: read the whole file and build the table (and */
+/* optionally a name index, as ShardedBank keeps) before serving anything */
+static bool rebuild(const char *path, std::vector<Record> &table, std::unordered_map<std::string, uint64_t> *index)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    off_t size = lseek(fd, 0, SEEK_END);
+    table.assign((size - 4096) / sizeof(Record), Record());
+    bool ok = pread(fd, table.data(), table.size() * sizeof(Record), 4096) == (ssize_t)(table.size() * sizeof(Record));
+    close(fd);
+    if (ok && index != nullptr)
+    {
+        index->reserve(table.size());
+        for (uint64_t i = 0; i < table.size(); i++)
+            if (table[i].flags & MappedAccountTable::RECORD_IN_USE)
+                index->emplace(std::string((const char *)table[i].name, NAMESIZE), i);
+    }
+    return ok;
+}
+
+template <typename Deposit, typename Withdraw>
+static double random_ops(uint64_t accounts, uint64_t ops, Deposit deposit, Withdraw withdraw, int64_t &net)
+{
+    std::mt19937_64 rng(7);
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++)
+    {
+        uint64_t slot = rng() % accounts;
+        amount_t amount = (amount_t)(rng() % 1000);
+        if (i & 1)
+            net += deposit(slot, amount) ? amount : 0;
+        else
+            net -= withdraw(slot, amount) ? amount : 0;
+    }
+    return ops / seconds_since(start);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t accounts = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    uint64_t ops = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2000000;
+    const char *path = argc > 3 ? argv[3] : "/tmp/table-bench.tbl";
+    const amount_t opening = 100000;
+
+    MappedAccountTable table;
+    auto start = Clock::now();
+    if (!table.create(path, accounts))
+    {
+        fprintf(stderr, "%s\n", table.error().c_str());
+        return 1;
+    }
+    uint8_t name[NAMESIZE], password[PASSWORDSIZE] = {0};
+    for (uint64_t i = 0; i < accounts; i++)
+    {
+        account_name(i, name);
+        table.deposit(table.add(name, password), opening);
+    }
+    table.close();
+    printf("%llu accounts, %.1f MB file, populated in %.2f s\n", (unsigned long long)accounts,
+           (4096 + accounts * sizeof(Record)) / 1e6, seconds_since(start));
+
+    /* Startup */
+    double open_s = 1e9;
+    for (int i = 0; i < 5; i++)
+    {
+        start = Clock::now();
+        bool ok = table.open(path);
+        double t = seconds_since(start);
+        if (!ok)
+        {
+            fprintf(stderr, "%s\n", table.error().c_str());
+            return 1;
+        }
+        open_s = t < open_s ? t : open_s;
+        table.close();
+    }
+    std::vector<Record> memory;
+    start = Clock::now();
+    rebuild(path, memory, nullptr);
+    double read_s = seconds_since(start);
+    std::unordered_map<std::string, uint64_t> index;
+    std::vector<Record> indexed;
+    start = Clock::now();
+    rebuild(path, indexed, &index);
+    double index_s = seconds_since(start);
+    indexed.clear();
+
+    printf("\n%-28s %12s\n", "startup", "ms");
+    printf("%-28s %12.3f\n", "mmap open + validate", open_s * 1e3);
+    printf("%-28s %12.3f\n", "read into memory", read_s * 1e3);
+    printf("%-28s %12.3f\n", "read + name index", index_s * 1e3);
+
+    /* Random access straight after startup */
+    int64_t net_mapped = 0, net_memory = 0;
+    table.open(path);
+    table.start_flusher(100);
+    double mapped_rate = random_ops(
+        accounts, ops, [&](uint64_t s, amount_t a) { return table.deposit(s, a); },
+        [&](uint64_t s, amount_t a) { return table.withdraw(s, a); }, net_mapped);
+    MappedAccountTable::Stats stats = table.stats();
+    start = Clock::now();
+    table.close();
+    double close_s = seconds_since(start);
+
+    double memory_rate = random_ops(
+        accounts, ops,
+        [&](uint64_t s, amount_t a) {
+            amount_t *b = &memory[s].balance;
+            amount_t cur = __atomic_load_n(b, __ATOMIC_RELAXED);
+            do
+                if (cur > INT32_MAX - a)
+                    return false;
+            while (!__atomic_compare_exchange_n(b, &cur, cur + a, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+            return true;
+        },
+        [&](uint64_t s, amount_t a) {
+            amount_t *b = &memory[s].balance;
+            amount_t cur = __atomic_load_n(b, __ATOMIC_RELAXED);
+            do
+                if (cur < a)
+                    return false;
+            while (!__atomic_compare_exchange_n(b, &cur, cur - a, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+            return true;
+        },
+        net_memory);
+
+    printf("\n%-28s %12s\n", "random deposit/withdraw", "ops/s");
+    printf("%-28s %12.0f\n", "mmap table", mapped_rate);
+    printf("%-28s %12.0f\n", "in-memory table", memory_rate);
+    printf("flusher: %llu passes, %llu pages written, final flush and close %.1f ms\n",
+           (unsigned long long)stats.flush_passes, (unsigned long long)stats.pages_flushed, close_s * 1e3);
+
+    /* Everything written through the mapping must be in the file */
+    if (!table.open(path) || !table.was_clean())
+    {
+        fprintf(stderr, "reopen failed: %s\n", table.error().c_str());
+        return 1;
+    }
+    int64_t total = 0;
+    for (uint64_t i = 0; i < table.size(); i++)
+        total += table.balance(i);
+    table.close();
+    int64_t expected = (int64_t)accounts * opening + net_mapped;
+    if (total != expected)
+    {
+        fprintf(stderr, "total %lld after reopen, expected %lld\n", (long long)total, (long long)expected);
+        return 1;
+    }
+    unlink(path);
+    return 0;
+}
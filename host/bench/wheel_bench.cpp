@@ -0,0 +1,72 @@
+/* wheel-bench: per-tick cost of the timing wheel as the number of pending */
+/* periodic timers grows, against scanning every timer each tick. Also checks */
+/* that every timer fired exactly as often as its period allows. */
+/* Usage: wheel-bench [simulated seconds] */
+
+#include "timer_wheel.h"
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+static TimerWheel wheel;
+static std::vector<uint32_t> fired;
+
+static void count_fire(uint32_t arg)
+{
+    fired[arg]++;
+}
+
+static double seconds_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)atol(argv[1]) : 3600;
+    const uint32_t ticks = seconds * 1000U;
+    const uint32_t scan_ticks = 10000; // the scan is too slow to run as long
+    bool ok = true;
+
+    printf("%8s %14s %14s %12s\n", "timers", "wheel ns/tick", "scan ns/tick", "fired");
+    for (uint32_t count : {16U, 256U, 4096U, TIMER_WHEEL_SIZE})
+    {
+        std::mt19937 rng(count);
+        std::vector<uint32_t> periods(count);
+        for (auto &p : periods)
+            p = 1000 + rng() % 3600000; // 1 s to 1 h, like standing orders
+
+        wheel.clear(0);
+        fired.assign(count, 0);
+        for (uint32_t i = 0; i < count; i++)
+            wheel.schedule(periods[i], periods[i], count_fire, i);
+        double start = seconds_now();
+        uint64_t total = 0;
+        for (uint32_t now = 1; now <= ticks; now++)
+            total += wheel.advance(now);
+        double wheel_ns = (seconds_now() - start) * 1e9 / ticks;
+        for (uint32_t i = 0; i < count; i++)
+            if (fired[i] != ticks / periods[i])
+            {
+                printf("timer %u fired %u times, expected %u\n", i, fired[i], ticks / periods[i]);
+                ok = false;
+                break;
+            }
+
+        /* Baseline: one expiry per timer, all compared every tick */
+        std::vector<uint32_t> expires(periods);
+        start = seconds_now();
+        for (uint32_t now = 1; now <= scan_ticks; now++)
+            for (uint32_t i = 0; i < count; i++)
+                if (expires[i] == now)
+                    expires[i] += periods[i];
+        double scan_ns = (seconds_now() - start) * 1e9 / scan_ticks;
+
+        printf("%8u %14.1f %14.1f %12llu\n", count, wheel_ns, scan_ns, (unsigned long long)total);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+/* Memory-mapped account table. File layout: a TABLE_HEADER_SIZE header, then */
+/* capacity fixed-size records. Nothing is read at open beyond the header. */
+
+#include "account_table.h"
+#include "crc32.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TABLE_MAGIC                     0x314C42544B4E4245ULL // "EBNKTBL1"
+#define TABLE_HEADER_SIZE               4096U
+
+struct MappedAccountTable::Header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint32_t checksum; // CRC-32 of the fields above
+    uint32_t clean;    // set by an orderly close, cleared while open
+    uint64_t count;    // slots in use
+};
+
+static_assert(sizeof(MappedAccountTable::Record) == 32, "record layout is part of the file format");
+static_assert(TABLE_HEADER_SIZE % alignof(MappedAccountTable::Record) == 0, "records must stay aligned");
+
+uint32_t MappedAccountTable::header_checksum(const Header *header)
+{
+    return crc32_sw(header, offsetof(Header, checksum));
+}
+
+MappedAccountTable::MappedAccountTable()
+    : fd(-1), map(nullptr), map_size(0), header(nullptr), records(nullptr), page_size(0), page_count(0),
+      opened_clean(false), flusher_stop(false), pages_flushed(0), flush_passes(0)
+{
+}
+
+MappedAccountTable::~MappedAccountTable()
+{
+    close();
+}
+
+bool MappedAccountTable::fail(const std::string &what)
+{
+    last_error = what;
+    if (map != nullptr)
+        munmap(map, map_size);
+    if (fd >= 0)
+        ::close(fd);
+    map = nullptr;
+    fd = -1;
+    return false;
+}
+
+bool MappedAccountTable::map_file(const char *path, int flags, uint64_t capacity)
+{
+    fd = ::open(path, flags, 0644);
+    if (fd < 0)
+        return fail(std::string(path) + ": " + strerror(errno));
+    if ((flags & O_CREAT) && ftruncate(fd, TABLE_HEADER_SIZE + capacity * sizeof(Record)) != 0)
+        return fail(std::string("resize: ") + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return fail(std::string("stat: ") + strerror(errno));
+    if ((uint64_t)st.st_size < TABLE_HEADER_SIZE)
+        return fail("file too small for a table header");
+    map_size = st.st_size;
+    void *addr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        map = nullptr;
+        return fail(std::string("mmap: ") + strerror(errno));
+    }
+    map = (uint8_t *)addr;
+    header = (Header *)map;
+    records = (Record *)(map + TABLE_HEADER_SIZE);
+
+    page_size = sysconf(_SC_PAGESIZE);
+    page_count = (map_size + page_size - 1) / page_size;
+    dirty.reset(new std::atomic<uint64_t>[(page_count + 63) / 64]());
+    return true;
+}
+
+/**
+ * @brief  Create (or overwrite) a table file for capacity accounts. The file
+ *         is sparse, so only pages that are written take disk space.
+ */
+bool MappedAccountTable::create(const char *path, uint64_t capacity)
+{
+    close();
+    if (!map_file(path, O_RDWR | O_CREAT | O_TRUNC, capacity))
+        return false;
+    memset(header, 0, sizeof(*header));
+    header->magic = TABLE_MAGIC;
+    header->version = VERSION;
+    header->record_size = sizeof(Record);
+    header->capacity = capacity;
+    header->checksum = header_checksum(header);
+    opened_clean = true;
+    if (msync(map, page_size, MS_SYNC) != 0)
+        return fail(std::string("msync: ") + strerror(errno));
+    return true;
+}
+
+/**
+ * @brief  Map an existing table. Only the header is checked: magic, version,
+ *         record layout, checksum and that the file holds capacity records.
+ * @retval false with error() set if the file is not a usable table
+ */
+bool MappedAccountTable::open(const char *path)
+{
+    close();
+    if (!map_file(path, O_RDWR, 0))
+        return false;
+    if (header->magic != TABLE_MAGIC)
+        return fail("not an account table");
+    if (header->checksum != header_checksum(header))
+        return fail("header checksum mismatch");
+    if (header->version != VERSION)
+        return fail("unsupported table version " + std::to_string(header->version));
+    if (header->record_size != sizeof(Record))
+        return fail("record size " + std::to_string(header->record_size) + " does not match this build");
+    if (map_size != TABLE_HEADER_SIZE + header->capacity * sizeof(Record))
+        return fail("file size does not match the capacity in the header");
+    if (header->count > header->capacity)
+        return fail("account count exceeds capacity");
+
+    opened_clean = header->clean != 0;
+    header->clean = 0;
+    if (msync(map, page_size, MS_SYNC) != 0)
+        return fail(std::string("msync: ") + strerror(errno));
+    return true;
+}
+
+/**
+ * @brief  Stop the flusher, write back everything and mark the file clean.
+ */
+void MappedAccountTable::close()
+{
+    if (flusher.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(flusher_lock);
+            flusher_stop = true;
+        }
+        flusher_wake.notify_all();
+        flusher.join();
+        flusher_stop = false;
+    }
+    if (map == nullptr)
+        return;
+    flush();
+    header->clean = 1;
+    msync(map, page_size, MS_SYNC);
+    munmap(map, map_size);
+    ::close(fd);
+    map = nullptr;
+    fd = -1;
+}
+
+const std::string &MappedAccountTable::error() const
+{
+    return last_error;
+}
+
+/**
+ * @retval false if the previous user of the file did not close it, so the
+ *         last changes before a crash may be missing
+ */
+bool MappedAccountTable::was_clean() const
+{
+    return opened_clean;
+}
+
+uint64_t MappedAccountTable::capacity() const
+{
+    return header->capacity;
+}
+
+uint64_t MappedAccountTable::size() const
+{
+    return __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+}
+
+void MappedAccountTable::mark_dirty(const void *addr)
+{
+    size_t page = ((const uint8_t *)addr - map) / page_size;
+    uint64_t bit = 1ULL << (page % 64);
+    std::atomic<uint64_t> &word = dirty[page / 64];
+    if ((word.load(std::memory_order_relaxed) & bit) == 0)
+        word.fetch_or(bit, std::memory_order_relaxed);
+}
+
+/**
+ * @brief  Claim the next free slot. Safe from any thread.
+ * @retval the slot, or -1 if the table is full
+ */
+int64_t MappedAccountTable::add(const uint8_t *name, const uint8_t *password)
+{
+    uint64_t slot = __atomic_load_n(&header->count, __ATOMIC_RELAXED);
+    do
+    {
+        if (slot >= header->capacity)
+            return -1;
+    } while (!__atomic_compare_exchange_n(&header->count, &slot, slot + 1, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+
+    Record &record = records[slot];
+    memcpy(record.name, name, NAMESIZE);
+    memcpy(record.password, password, PASSWORDSIZE);
+    __atomic_store_n(&record.balance, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&record.last_active, day(), __ATOMIC_RELAXED);
+    __atomic_store_n(&record.flags, RECORD_IN_USE, __ATOMIC_RELEASE);
+    mark_dirty(&record);
+    mark_dirty(header);
+    return (int64_t)slot;
+}
+
+const MappedAccountTable::Record &MappedAccountTable::at(uint64_t slot) const
+{
+    return records[slot];
+}
+
+amount_t MappedAccountTable::balance(uint64_t slot) const
+{
+    return __atomic_load_n(&records[slot].balance, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief  Same rules as BankAccount::deposit(), on the mapped record.
+ */
+bool MappedAccountTable::deposit(uint64_t slot, amount_t amount)
+{
+    if (amount < 0 || slot >= size())
+        return false;
+    amount_t *balance = &records[slot].balance;
+    amount_t current = __atomic_load_n(balance, __ATOMIC_RELAXED);
+    do
+    {
+        if (current > INT32_MAX - amount)
+            return false;
+    } while (!__atomic_compare_exchange_n(balance, &current, current + amount, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    __atomic_store_n(&records[slot].last_active, day(), __ATOMIC_RELAXED);
+    mark_dirty(balance);
+    return true;
+}
+
+/**
+ * @brief  Same rules as BankAccount::withdraw(), on the mapped record.
+ */
+bool MappedAccountTable::withdraw(uint64_t slot, amount_t amount)
+{
+    if (amount < 0 || slot >= size())
+        return false;
+    amount_t *balance = &records[slot].balance;
+    amount_t current = __atomic_load_n(balance, __ATOMIC_RELAXED);
+    do
+    {
+        if (current < amount)
+            return false;
+    } while (!__atomic_compare_exchange_n(balance, &current, current - amount, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    __atomic_store_n(&records[slot].last_active, day(), __ATOMIC_RELAXED);
+    mark_dirty(balance);
+    return true;
+}
+
+void MappedAccountTable::set_balance(uint64_t slot, amount_t amount)
+{
+    __atomic_store_n(&records[slot].balance, amount, __ATOMIC_RELEASE);
+    mark_dirty(&records[slot]);
+}
+
+int32_t MappedAccountTable::last_active(uint64_t slot) const
+{
+    return __atomic_load_n(&records[slot].last_active, __ATOMIC_RELAXED);
+}
+
+void MappedAccountTable::set_last_active(uint64_t slot, int32_t day)
+{
+    __atomic_store_n(&records[slot].last_active, day, __ATOMIC_RELAXED);
+    mark_dirty(&records[slot]);
+}
+
+int32_t MappedAccountTable::day()
+{
+    return (int32_t)(time(nullptr) / 86400);
+}
+
+/* Write back runs of dirty pages. Bits are cleared first, so a page changed */
+/* during msync() is picked up again by the next pass. */
+void MappedAccountTable::flush_dirty(int flags)
+{
+    size_t words = (page_count + 63) / 64;
+    for (size_t w = 0; w < words; w++)
+    {
+        uint64_t bits = dirty[w].exchange(0, std::memory_order_acq_rel);
+        while (bits != 0)
+        {
+            unsigned first = __builtin_ctzll(bits);
+            uint64_t rest = bits >> first;
+            unsigned run = rest == ~0ULL ? 64 : __builtin_ctzll(~rest);
+            size_t page = w * 64 + first;
+            if (page + run > page_count)
+                run = page_count - page;
+            size_t len = run * page_size;
+            if (page * page_size + len > map_size)
+                len = map_size - page * page_size;
+            msync(map + page * page_size, len, flags);
+            pages_flushed.fetch_add(run, std::memory_order_relaxed);
+            bits = run + first >= 64 ? 0 : bits & ~(((1ULL << run) - 1) << first);
+        }
+    }
+}
+
+void MappedAccountTable::flusher_loop(unsigned interval_ms)
+{
+    std::unique_lock<std::mutex> guard(flusher_lock);
+    while (!flusher_stop)
+    {
+        flusher_wake.wait_for(guard, std::chrono::milliseconds(interval_ms));
+        guard.unlock();
+        flush_dirty(MS_SYNC);
+        flush_passes.fetch_add(1, std::memory_order_relaxed);
+        guard.lock();
+    }
+}
+
+/**
+ * @brief  Write back dirty pages every interval_ms on a background thread,
+ *         so updates never wait for the disk.
+ */
+void MappedAccountTable::start_flusher(unsigned interval_ms)
+{
+    if (map != nullptr && !flusher.joinable())
+        flusher = std::thread(&MappedAccountTable::flusher_loop, this, interval_ms);
+}
+
+/**
+ * @brief  Write back all dirty pages now and wait for the disk.
+ */
+void MappedAccountTable::flush()
+{
+    if (map != nullptr)
+        flush_dirty(MS_SYNC);
+}
+
+MappedAccountTable::Stats MappedAccountTable::stats() const
+{
+    Stats s;
+    s.pages_flushed = pages_flushed.load(std::memory_order_relaxed);
+    s.flush_passes = flush_passes.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,93 @@
+#ifndef ACCOUNT_TABLE_H
+#define ACCOUNT_TABLE_H
+
+#include "bank_account.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* Account table kept in a memory-mapped file, for host deployments with */
+/* millions of accounts. Opening only checks the header; records are used in */
+/* place and dirty pages are written back by a background thread. */
+class MappedAccountTable
+{
+public:
+    /* On-disk record, indexed by slot; the balance is updated with atomics */
+    struct Record
+    {
+        amount_t balance;
+        uint32_t flags;
+        uint8_t name[NAMESIZE];
+        uint8_t password[PASSWORDSIZE];
+        int32_t last_active; // day() of the creation or last deposit or withdrawal; 0 in older files
+    };
+    static const uint32_t RECORD_IN_USE = 1U;
+    static const uint32_t VERSION = 1U;
+
+    struct Stats
+    {
+        uint64_t pages_flushed;
+        uint64_t flush_passes;
+    };
+
+private:
+    struct Header;
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    Header *header;
+    Record *records;
+    size_t page_size;
+    size_t page_count;
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty; // one bit per page of the mapping
+    std::string last_error;
+    bool opened_clean;
+
+    std::thread flusher;
+    std::mutex flusher_lock;
+    std::condition_variable flusher_wake;
+    bool flusher_stop;
+    std::atomic<uint64_t> pages_flushed;
+    std::atomic<uint64_t> flush_passes;
+
+    static uint32_t header_checksum(const Header *header);
+    bool map_file(const char *path, int flags, uint64_t capacity);
+    bool fail(const std::string &what);
+    void mark_dirty(const void *addr);
+    void flush_dirty(int flags);
+    void flusher_loop(unsigned interval_ms);
+
+public:
+    MappedAccountTable();
+    ~MappedAccountTable();
+    bool create(const char *path, uint64_t capacity);
+    bool open(const char *path);
+    void close();
+    const std::string &error() const;
+    bool was_clean() const;
+
+    uint64_t capacity() const;
+    uint64_t size() const;
+    int64_t add(const uint8_t *name, const uint8_t *password);
+    const Record &at(uint64_t slot) const;
+    amount_t balance(uint64_t slot) const;
+    bool deposit(uint64_t slot, amount_t amount);
+    bool withdraw(uint64_t slot, amount_t amount);
+    /* For batch jobs on a table no one else changes meanwhile, see */
+    /* BalanceColumn::store(); not activity */
+    void set_balance(uint64_t slot, amount_t amount);
+    int32_t last_active(uint64_t slot) const;
+    /* For accounts imported with a history */
+    void set_last_active(uint64_t slot, int32_t day);
+    /* Days since 1970-01-01, UTC */
+    static int32_t day();
+
+    void start_flusher(unsigned interval_ms);
+    void flush();
+    Stats stats() const;
+};
+
+#endif // ACCOUNT_TABLE_H
@@ -0,0 +1,530 @@
+#include "balance_column.h"
+#include <algorithm>
+#include <array>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BALANCE_COLUMN_X86 1
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static const size_t COLUMN_ALIGN = 64;
+
+/* Scalar kernels, also the reference the vector ones must match ------------ */
+
+static inline amount_t rate_one(amount_t balance, int32_t rate)
+{
+    int64_t delta = ((int64_t)balance * rate + (1LL << (BalanceColumn::RATE_SHIFT - 1))) >> BalanceColumn::RATE_SHIFT;
+    int64_t result = (int64_t)balance + delta;
+    if (result > INT32_MAX)
+        return INT32_MAX;
+    if (result < INT32_MIN)
+        return INT32_MIN;
+    return (amount_t)result;
+}
+
+static void rate_scalar(amount_t *b, size_t n, int32_t rate)
+{
+    for (size_t i = 0; i < n; i++)
+        b[i] = rate_one(b[i], rate);
+}
+
+static int64_t sum_scalar(const amount_t *b, size_t n)
+{
+    int64_t total = 0;
+    for (size_t i = 0; i < n; i++)
+        total += b[i];
+    return total;
+}
+
+static void below_scalar(const int32_t *v, size_t n, int32_t threshold, uint32_t base, std::vector<uint32_t> &out)
+{
+    for (size_t i = 0; i < n; i++)
+        if (v[i] < threshold)
+            out.push_back(base + (uint32_t)i);
+}
+
+/* below[j] += accounts with balance < edges[j] */
+static void histogram_scalar(const amount_t *b, size_t n, const amount_t *edges, size_t edge_count, uint64_t *below)
+{
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < edge_count; j++)
+            below[j] += b[i] < edges[j];
+}
+
+#ifdef BALANCE_COLUMN_X86
+/* SSE4.1: four accounts per step ------------------------------------------- */
+
+TARGET_SSE41 static void rate_sse41(amount_t *b, size_t n, int32_t rate)
+{
+    const __m128i r = _mm_set1_epi32(rate);
+    const __m128i bias = _mm_set1_epi64x(1LL << (BalanceColumn::RATE_SHIFT - 1));
+    const __m128i max = _mm_set1_epi32(INT32_MAX);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+        /* 64-bit products of lanes 0, 2 and 1, 3; only the low 32 bits of */
+        /* each shifted product are kept, where logical and arithmetic */
+        /* shifts agree */
+        __m128i even = _mm_add_epi64(_mm_mul_epi32(v, r), bias);
+        __m128i odd = _mm_add_epi64(_mm_mul_epi32(_mm_srli_epi64(v, 32), r), bias);
+        even = _mm_srli_epi64(even, BalanceColumn::RATE_SHIFT);
+        odd = _mm_slli_epi64(odd, 32 - BalanceColumn::RATE_SHIFT);
+        __m128i delta = _mm_blend_epi16(even, odd, 0xCC);
+        __m128i sum = _mm_add_epi32(v, delta);
+        /* Signed overflow: both operands differ in sign from the sum */
+        __m128i overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(sum, v), _mm_xor_si128(sum, delta)), 31);
+        __m128i saturated = _mm_xor_si128(_mm_srai_epi32(v, 31), max);
+        _mm_storeu_si128((__m128i *)(b + i), _mm_blendv_epi8(sum, saturated, overflow));
+    }
+    rate_scalar(b + i, n - i, rate);
+}
+
+TARGET_SSE41 static int64_t sum_sse41(const amount_t *b, size_t n)
+{
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+        acc0 = _mm_add_epi64(acc0, _mm_cvtepi32_epi64(v));
+        acc1 = _mm_add_epi64(acc1, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + sum_scalar(b + i, n - i);
+}
+
+TARGET_SSE41 static void below_sse41(const int32_t *v, size_t n, int32_t threshold, uint32_t base,
+                                     std::vector<uint32_t> &out)
+{
+    const __m128i t = _mm_set1_epi32(threshold);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i lt = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i *)(v + i)), t);
+        unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(lt));
+        while (mask)
+        {
+            out.push_back(base + (uint32_t)(i + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+    below_scalar(v + i, n - i, threshold, base + (uint32_t)i, out);
+}
+
+TARGET_SSE41 static void histogram_sse41(const amount_t *b, size_t n, const amount_t *edges, size_t edge_count,
+                                         uint64_t *below)
+{
+    __m128i acc[BalanceColumn::HISTOGRAM_EDGES_MAX];
+    __m128i e[BalanceColumn::HISTOGRAM_EDGES_MAX];
+    for (size_t j = 0; j < edge_count; j++)
+    {
+        acc[j] = _mm_setzero_si128();
+        e[j] = _mm_set1_epi32(edges[j]);
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(b + i));
+        for (size_t j = 0; j < edge_count; j++)
+            acc[j] = _mm_sub_epi32(acc[j], _mm_cmplt_epi32(v, e[j])); // true is -1
+    }
+    for (size_t j = 0; j < edge_count; j++)
+    {
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc[j]);
+        below[j] += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    histogram_scalar(b + i, n - i, edges, edge_count, below);
+}
+
+/* AVX2: eight accounts per step --------------------------------------------- */
+
+TARGET_AVX2 static void rate_avx2(amount_t *b, size_t n, int32_t rate)
+{
+    const __m256i r = _mm256_set1_epi32(rate);
+    const __m256i bias = _mm256_set1_epi64x(1LL << (BalanceColumn::RATE_SHIFT - 1));
+    const __m256i max = _mm256_set1_epi32(INT32_MAX);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i even = _mm256_add_epi64(_mm256_mul_epi32(v, r), bias);
+        __m256i odd = _mm256_add_epi64(_mm256_mul_epi32(_mm256_srli_epi64(v, 32), r), bias);
+        even = _mm256_srli_epi64(even, BalanceColumn::RATE_SHIFT);
+        odd = _mm256_slli_epi64(odd, 32 - BalanceColumn::RATE_SHIFT);
+        __m256i delta = _mm256_blend_epi32(even, odd, 0xAA);
+        __m256i sum = _mm256_add_epi32(v, delta);
+        __m256i overflow =
+            _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(sum, v), _mm256_xor_si256(sum, delta)), 31);
+        __m256i saturated = _mm256_xor_si256(_mm256_srai_epi32(v, 31), max);
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_blendv_epi8(sum, saturated, overflow));
+    }
+    rate_scalar(b + i, n - i, rate);
+}
+
+TARGET_AVX2 static int64_t sum_avx2(const amount_t *b, size_t n)
+{
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(b + i))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(b + i + 4))));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar(b + i, n - i);
+}
+
+TARGET_AVX2 static void below_avx2(const int32_t *v, size_t n, int32_t threshold, uint32_t base,
+                                   std::vector<uint32_t> &out)
+{
+    const __m256i t = _mm256_set1_epi32(threshold);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i lt = _mm256_cmpgt_epi32(t, _mm256_loadu_si256((const __m256i *)(v + i)));
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lt));
+        while (mask)
+        {
+            out.push_back(base + (uint32_t)(i + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+    below_scalar(v + i, n - i, threshold, base + (uint32_t)i, out);
+}
+
+TARGET_AVX2 static void histogram_avx2(const amount_t *b, size_t n, const amount_t *edges, size_t edge_count,
+                                       uint64_t *below)
+{
+    __m256i acc[BalanceColumn::HISTOGRAM_EDGES_MAX];
+    __m256i e[BalanceColumn::HISTOGRAM_EDGES_MAX];
+    for (size_t j = 0; j < edge_count; j++)
+    {
+        acc[j] = _mm256_setzero_si256();
+        e[j] = _mm256_set1_epi32(edges[j]);
+    }
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(b + i));
+        for (size_t j = 0; j < edge_count; j++)
+            acc[j] = _mm256_sub_epi32(acc[j], _mm256_cmpgt_epi32(e[j], v));
+    }
+    for (size_t j = 0; j < edge_count; j++)
+    {
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc[j]);
+        uint64_t total = 0;
+        for (uint32_t lane : lanes)
+            total += lane;
+        below[j] += total;
+    }
+    histogram_scalar(b + i, n - i, edges, edge_count, below);
+}
+#endif // BALANCE_COLUMN_X86
+
+/* BalanceColumn ------------------------------------------------------------ */
+
+static void *column_alloc(size_t count)
+{
+    size_t bytes = (count * sizeof(int32_t) + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+    void *p = aligned_alloc(COLUMN_ALIGN, bytes ? bytes : COLUMN_ALIGN);
+    if (p != nullptr)
+        memset(p, 0, bytes);
+    return p;
+}
+
+BalanceColumn::BalanceColumn(size_t count)
+    : balances((amount_t *)column_alloc(count)), last_active((int32_t *)column_alloc(count)),
+      count(balances && last_active ? count : 0), kernel(Kernel::Scalar), threads(0)
+{
+    use(Kernel::Auto);
+    set_threads(0);
+}
+
+BalanceColumn::~BalanceColumn()
+{
+    free(balances);
+    free(last_active);
+}
+
+int32_t BalanceColumn::rate_from_percent(double percent)
+{
+    double rate = nearbyint(percent / 100.0 * RATE_MAX);
+    return (int32_t)std::min<double>(std::max<double>(rate, -RATE_MAX + 1), RATE_MAX);
+}
+
+bool BalanceColumn::supported(Kernel kernel)
+{
+#ifdef BALANCE_COLUMN_X86
+    if (kernel == Kernel::Sse41)
+        return __builtin_cpu_supports("sse4.1");
+    if (kernel == Kernel::Avx2)
+        return __builtin_cpu_supports("avx2");
+#else
+    if (kernel == Kernel::Sse41 || kernel == Kernel::Avx2)
+        return false;
+#endif
+    return true;
+}
+
+const char *BalanceColumn::kernel_name(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:
+        return "scalar";
+    case Kernel::Sse41:
+        return "sse4.1";
+    case Kernel::Avx2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+
+bool BalanceColumn::use(Kernel wanted)
+{
+    if (wanted == Kernel::Auto)
+        wanted = supported(Kernel::Avx2) ? Kernel::Avx2 : supported(Kernel::Sse41) ? Kernel::Sse41 : Kernel::Scalar;
+    if (!supported(wanted))
+        return false;
+    kernel = wanted;
+    return true;
+}
+
+BalanceColumn::Kernel BalanceColumn::active_kernel() const
+{
+    return kernel;
+}
+
+void BalanceColumn::set_threads(unsigned wanted)
+{
+    threads = wanted ? wanted : std::max(1U, std::thread::hardware_concurrency());
+}
+
+size_t BalanceColumn::size() const
+{
+    return count;
+}
+
+amount_t *BalanceColumn::balance_data()
+{
+    return balances;
+}
+
+int32_t *BalanceColumn::last_active_data()
+{
+    return last_active;
+}
+
+const amount_t *BalanceColumn::balance_data() const
+{
+    return balances;
+}
+
+const int32_t *BalanceColumn::last_active_data() const
+{
+    return last_active;
+}
+
+void BalanceColumn::load(const MappedAccountTable &table)
+{
+    size_t n = std::min<size_t>(count, table.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        balances[i] = table.balance(i);
+        last_active[i] = table.last_active(i);
+    }
+    memset(balances + n, 0, (count - n) * sizeof(amount_t));
+    memset(last_active + n, 0, (count - n) * sizeof(int32_t));
+}
+
+void BalanceColumn::load(const BankAccount *accounts, size_t n, int32_t day)
+{
+    n = std::min(count, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        balances[i] = accounts[i].get_account_balance();
+        last_active[i] = day;
+    }
+    memset(balances + n, 0, (count - n) * sizeof(amount_t));
+    memset(last_active + n, 0, (count - n) * sizeof(int32_t));
+}
+
+void BalanceColumn::store(MappedAccountTable &table) const
+{
+    size_t n = std::min<size_t>(count, table.size());
+    for (size_t i = 0; i < n; i++)
+        if (balances[i] != table.balance(i))
+            table.set_balance(i, balances[i]);
+}
+
+/**
+ * @brief  Move each account to its column balance with a deposit or a
+ *         withdrawal, so hot slices and the ledger seqlock stay consistent.
+ *         A balance the account rules refuse (above INT32_MAX or below
+ *         zero) is left as it was.
+ * @retval accounts not changed that way
+ */
+size_t BalanceColumn::store(BankAccount *accounts, size_t n) const
+{
+    size_t refused = 0;
+    n = std::min(count, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        amount_t current = accounts[i].get_account_balance();
+        if (balances[i] > current)
+            refused += !accounts[i].deposit(balances[i] - current);
+        else if (balances[i] < current)
+            refused += balances[i] < 0 || !accounts[i].withdraw(current - balances[i]);
+    }
+    return refused;
+}
+
+/**
+ * @brief  Run fn(part, begin, end) over the column, on one thread per part.
+ *         Parts start on cache-line boundaries and are never smaller than
+ *         half of PARALLEL_MIN, so small tables stay on the calling thread.
+ */
+template <typename Fn>
+void BalanceColumn::for_chunks(Fn fn) const
+{
+    size_t parts = std::min<size_t>(threads, std::max<size_t>(1, count / (PARALLEL_MIN / 2)));
+    if (count < PARALLEL_MIN || parts <= 1)
+    {
+        fn(0, 0, count);
+        return;
+    }
+    const size_t line = COLUMN_ALIGN / sizeof(int32_t);
+    size_t step = ((count + parts - 1) / parts + line - 1) / line * line;
+    std::vector<std::thread> pool;
+    for (size_t part = 1; part < parts && part * step < count; part++)
+        pool.emplace_back(fn, part, part * step, std::min(count, (part + 1) * step));
+    fn(0, 0, std::min(count, step));
+    for (std::thread &t : pool)
+        t.join();
+}
+
+void BalanceColumn::apply_rate(int32_t rate)
+{
+    rate = std::min(std::max(rate, -RATE_MAX + 1), RATE_MAX);
+    Kernel k = kernel;
+    for_chunks([this, rate, k](size_t, size_t begin, size_t end) {
+        amount_t *b = balances + begin;
+        size_t n = end - begin;
+#ifdef BALANCE_COLUMN_X86
+        if (k == Kernel::Avx2)
+            return rate_avx2(b, n, rate);
+        if (k == Kernel::Sse41)
+            return rate_sse41(b, n, rate);
+#endif
+        rate_scalar(b, n, rate);
+    });
+}
+
+int64_t BalanceColumn::sum() const
+{
+    std::vector<int64_t> partial(threads, 0);
+    Kernel k = kernel;
+    for_chunks([this, k, &partial](size_t part, size_t begin, size_t end) {
+        const amount_t *b = balances + begin;
+        size_t n = end - begin;
+#ifdef BALANCE_COLUMN_X86
+        if (k == Kernel::Avx2)
+        {
+            partial[part] = sum_avx2(b, n);
+            return;
+        }
+        if (k == Kernel::Sse41)
+        {
+            partial[part] = sum_sse41(b, n);
+            return;
+        }
+#endif
+        partial[part] = sum_scalar(b, n);
+    });
+    int64_t total = 0;
+    for (int64_t p : partial)
+        total += p;
+    return total;
+}
+
+size_t BalanceColumn::select_below(const int32_t *column, int32_t threshold, std::vector<uint32_t> &out) const
+{
+    std::vector<std::vector<uint32_t>> parts(threads);
+    Kernel k = kernel;
+    for_chunks([column, threshold, k, &parts](size_t part, size_t begin, size_t end) {
+        const int32_t *v = column + begin;
+        size_t n = end - begin;
+#ifdef BALANCE_COLUMN_X86
+        if (k == Kernel::Avx2)
+            return below_avx2(v, n, threshold, (uint32_t)begin, parts[part]);
+        if (k == Kernel::Sse41)
+            return below_sse41(v, n, threshold, (uint32_t)begin, parts[part]);
+#endif
+        below_scalar(v, n, threshold, (uint32_t)begin, parts[part]);
+    });
+    out.clear();
+    for (const std::vector<uint32_t> &p : parts)
+        out.insert(out.end(), p.begin(), p.end());
+    return out.size();
+}
+
+size_t BalanceColumn::find_below(amount_t threshold, std::vector<uint32_t> &out) const
+{
+    return select_below(balances, threshold, out);
+}
+
+size_t BalanceColumn::find_inactive(int32_t day, std::vector<uint32_t> &out) const
+{
+    return select_below(last_active, day, out);
+}
+
+void BalanceColumn::histogram(const amount_t *edges, size_t edge_count, uint64_t *counts) const
+{
+    edge_count = std::min(edge_count, HISTOGRAM_EDGES_MAX);
+    if (edge_count == 0)
+        return;
+    /* Count accounts below each edge but the first; bucket counts are the */
+    /* differences */
+    std::vector<std::array<uint64_t, HISTOGRAM_EDGES_MAX>> below(threads);
+    for (auto &b : below)
+        b.fill(0);
+    const amount_t *upper = edges + 1;
+    size_t upper_count = edge_count - 1;
+    Kernel k = kernel;
+    for_chunks([this, upper, upper_count, k, &below](size_t part, size_t begin, size_t end) {
+        const amount_t *b = balances + begin;
+        size_t n = end - begin;
+        uint64_t *out = below[part].data();
+#ifdef BALANCE_COLUMN_X86
+        if (k == Kernel::Avx2)
+            return histogram_avx2(b, n, upper, upper_count, out);
+        if (k == Kernel::Sse41)
+            return histogram_sse41(b, n, upper, upper_count, out);
+#endif
+        histogram_scalar(b, n, upper, upper_count, out);
+    });
+
+    uint64_t total_below[HISTOGRAM_EDGES_MAX] = {0};
+    for (const auto &b : below)
+        for (size_t j = 0; j < upper_count; j++)
+            total_below[j] += b[j];
+    uint64_t previous = 0;
+    for (size_t j = 0; j < upper_count; j++)
+    {
+        counts[j] = total_below[j] - previous;
+        previous = total_below[j];
+    }
+    counts[edge_count - 1] = count - previous;
+}
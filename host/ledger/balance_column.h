@@ -0,0 +1,85 @@
+#ifndef BALANCE_COLUMN_H
+#define BALANCE_COLUMN_H
+
+#include "account_table.h"
+#include "bank_account.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Balances (and the day of each account's last activity) of a large table */
+/* as plain contiguous columns, for batch jobs that touch every account: */
+/* interest and fees, total liabilities, negative or dormant accounts and */
+/* balance histograms. The kernels exist as scalar, SSE4.1 and AVX2 code */
+/* with identical results; the best one the CPU supports is picked at run */
+/* time. Tables of PARALLEL_MIN or more accounts are split across threads. */
+class BalanceColumn
+{
+public:
+    enum class Kernel
+    {
+        Auto,
+        Scalar,
+        Sse41,
+        Avx2
+    };
+    /* Rates are fixed point: rate * 2^RATE_SHIFT, e.g. 1.5% is */
+    /* rate_from_percent(1.5). The change is (balance * rate) >> RATE_SHIFT */
+    /* rounded half up, and results saturate at the amount_t range. */
+    static constexpr int RATE_SHIFT = 24;
+    static constexpr int32_t RATE_MAX = 1 << RATE_SHIFT; // +-100%
+    static constexpr size_t PARALLEL_MIN = 1U << 16;
+    static constexpr size_t HISTOGRAM_EDGES_MAX = 16;
+
+private:
+    amount_t *balances;
+    int32_t *last_active; // day number
+    size_t count;
+    Kernel kernel;
+    unsigned threads;
+
+    template <typename Fn>
+    void for_chunks(Fn fn) const;
+    size_t select_below(const int32_t *column, int32_t threshold, std::vector<uint32_t> &out) const;
+
+public:
+    explicit BalanceColumn(size_t count);
+    ~BalanceColumn();
+    BalanceColumn(const BalanceColumn &) = delete;
+    BalanceColumn &operator=(const BalanceColumn &) = delete;
+
+    static int32_t rate_from_percent(double percent);
+    static bool supported(Kernel kernel);
+    static const char *kernel_name(Kernel kernel);
+    /* Kernel::Auto picks the best supported one; false if not supported */
+    bool use(Kernel kernel);
+    Kernel active_kernel() const;
+    /* 0 for one thread per core */
+    void set_threads(unsigned threads);
+
+    size_t size() const;
+    amount_t *balance_data();
+    int32_t *last_active_data();
+    const amount_t *balance_data() const;
+    const int32_t *last_active_data() const;
+    void load(const MappedAccountTable &table);
+    /* BankAccount keeps no activity day: each counts as last active on day */
+    void load(const BankAccount *accounts, size_t count, int32_t day);
+    /* Write the balances back, e.g. after apply_rate(); for a table or */
+    /* accounts that no one else changes between load() and store() */
+    void store(MappedAccountTable &table) const;
+    size_t store(BankAccount *accounts, size_t count) const;
+
+    void apply_rate(int32_t rate);
+    int64_t sum() const;
+    /* Indices of accounts with balance < threshold, in order */
+    size_t find_below(amount_t threshold, std::vector<uint32_t> &out) const;
+    /* Indices of accounts last active before day */
+    size_t find_inactive(int32_t day, std::vector<uint32_t> &out) const;
+    /* counts[i] = accounts with edges[i] <= balance < edges[i + 1]; counts[0] */
+    /* also takes everything below edges[0] and the last bucket everything */
+    /* from edges[edge_count - 1]. Edges ascending, at most HISTOGRAM_EDGES_MAX. */
+    void histogram(const amount_t *edges, size_t edge_count, uint64_t *counts) const;
+};
+
+#endif // BALANCE_COLUMN_H
@@ -0,0 +1,513 @@
+/* Multi-threaded ledger service: the BankAccount engine behind a Unix socket. */
+
+#include "ledger.h"
+#include "amount_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_set>
+
+static std::string name_key(const uint8_t *name)
+{
+    return std::string((const char *)name, strnlen((const char *)name, NAME_LEN_MAX));
+}
+
+/* Copy a line into a fixed-size field the way UART_ReadChars() fills its buffer */
+static void copy_field(uint8_t *buf, uint32_t buf_size, const std::string &line)
+{
+    memset(buf, 0, buf_size);
+    memcpy(buf, line.data(), line.size() < buf_size - 1 ? line.size() : buf_size - 1);
+}
+
+ShardedBank::ShardedBank(size_t shard_count)
+{
+    for (size_t i = 0; i < shard_count; i++)
+        shards.emplace_back(new Shard);
+}
+
+ShardedBank::Shard &ShardedBank::shard_for(const uint8_t *name)
+{
+    uint32_t length = strnlen((const char *)name, NAME_LEN_MAX);
+    return *shards[NameArena::hash(name, length) % shards.size()];
+}
+
+/**
+ * @brief  Open a new account with a zero balance, hot if asked to.
+ */
+ShardedBank::CreateStatus ShardedBank::create(const uint8_t *name, const uint8_t *password, bool hot)
+{
+    Shard &shard = shard_for(name);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    std::string key = name_key(name);
+    if (key.empty())
+        return CreateStatus::BadName;
+    if (shard.index.count(key) != 0)
+        return CreateStatus::NameTaken;
+    shard.accounts.emplace_back(name, password);
+    if (shard.accounts.back().get_account_name_length() != key.size())
+    {
+        shard.accounts.pop_back(); // Names() is full
+        return CreateStatus::NoNameSpace;
+    }
+    if (hot)
+    {
+        shard.slices.emplace_back();
+        shard.accounts.back().make_hot(&shard.slices.back());
+    }
+    shard.index.emplace(key, &shard.accounts.back());
+    return CreateStatus::Created;
+}
+
+BankAccount *ShardedBank::find(const uint8_t *name, const uint8_t *password)
+{
+    Shard &shard = shard_for(name);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.index.find(name_key(name));
+    if (it == shard.index.end() || !it->second->verify_password(password))
+        return nullptr;
+    return it->second;
+}
+
+size_t ShardedBank::size()
+{
+    size_t count = 0;
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        count += shard->accounts.size();
+    }
+    return count;
+}
+
+LedgerSession::LedgerSession(ShardedBank &bank)
+    : bank(bank), state(State::Welcome), create_hot(false), account(nullptr)
+{
+    memset(account_name, 0, sizeof(account_name));
+    memset(password, 0, PASSWORDSIZE);
+}
+
+void LedgerSession::welcome(std::string &out)
+{
+    out += "\r\n*****************************************************\r\n"
+           "------------- Welcome to Embedded Bank! -------------\r\n"
+           "*****************************************************"
+           "\r\nNew account (N), New hot account (H) or Existing account (E). \r\nPlease enter: ";
+    state = State::Welcome;
+}
+
+void LedgerSession::menu(std::string &out)
+{
+    out += "\r\nBalance (B), Deposit (D), Withdraw (W) or Quit (Q). \r\nPlease enter: ";
+    state = State::Menu;
+}
+
+/**
+ * @brief  Keep line as the account name, unless it is longer than
+ *         NAME_LEN_MAX: that is reported, never cut short.
+ * @retval false if the name was refused
+ */
+bool LedgerSession::take_name(const std::string &line, std::string &out)
+{
+    char msg[64] = {0};
+    if (line.size() > NAME_LEN_MAX)
+    {
+        snprintf(msg, sizeof(msg), "\r\nAccount names have at most %u characters.", (unsigned)NAME_LEN_MAX);
+        out += msg;
+        return false;
+    }
+    copy_field(account_name, sizeof(account_name), line);
+    return true;
+}
+
+void LedgerSession::start(std::string &out)
+{
+    welcome(out);
+}
+
+void LedgerSession::on_line(const std::string &line, std::string &out)
+{
+    char msg[100] = {0};
+    char text[16] = {0};
+    uint8_t confirm_password[PASSWORDSIZE] = {0};
+    amount_t amount = 0;
+    AmountError error = AMOUNT_OK;
+    ShardedBank::CreateStatus status = ShardedBank::CreateStatus::Created;
+
+    switch (state)
+    {
+    case State::Welcome:
+        if (line[0] == 'N' || line[0] == 'H')
+        {
+            create_hot = line[0] == 'H';
+            out += "\r\nEnter account name: ";
+            state = State::CreateName;
+        }
+        else if (line[0] == 'E')
+        {
+            out += "\r\nEnter account name: ";
+            state = State::LoginName;
+        }
+        else
+        {
+            out += "\r\nInvalid option.";
+            welcome(out);
+        }
+        break;
+
+    case State::CreateName:
+        if (!take_name(line, out))
+        {
+            out += "\r\nEnter account name: ";
+            break;
+        }
+        out += "\r\nEnter password: ";
+        state = State::CreatePassword;
+        break;
+
+    case State::CreatePassword:
+        copy_field(password, PASSWORDSIZE, line);
+        out += "\r\nConfirm password: ";
+        state = State::CreateConfirm;
+        break;
+
+    case State::CreateConfirm:
+        copy_field(confirm_password, PASSWORDSIZE, line);
+        if (memcmp(password, confirm_password, PASSWORDSIZE) != 0)
+        {
+            out += "\r\nPassword and confirm password do not match.\n\r\nEnter password: ";
+            state = State::CreatePassword;
+        }
+        else if ((status = bank.create(account_name, password, create_hot)) == ShardedBank::CreateStatus::NameTaken)
+        {
+            snprintf(msg, sizeof(msg), "\r\nAccount name '%s' is not available!", (char *)account_name);
+            out += msg;
+            out += "\r\nEnter account name: ";
+            state = State::CreateName;
+        }
+        else if (status == ShardedBank::CreateStatus::BadName)
+        {
+            out += "\r\nThe account name must not be empty.\r\nEnter account name: ";
+            state = State::CreateName;
+        }
+        else if (status == ShardedBank::CreateStatus::NoNameSpace)
+        {
+            out += "\r\nThere is no room left for account names. Your account cannot be created.";
+            welcome(out);
+        }
+        else
+        {
+            account = bank.find(account_name, password);
+            snprintf(msg, sizeof(msg), "\r\nNew %saccount '%s' created.", create_hot ? "hot " : "",
+                     (char *)account_name);
+            out += msg;
+            menu(out);
+        }
+        break;
+
+    case State::LoginName:
+        if (!take_name(line, out))
+        {
+            welcome(out);
+            break;
+        }
+        out += "\r\nEnter password: ";
+        state = State::LoginPassword;
+        break;
+
+    case State::LoginPassword:
+        copy_field(password, PASSWORDSIZE, line);
+        account = bank.find(account_name, password);
+        if (account == nullptr)
+        {
+            out += "\r\nInvalid account name or password.";
+            welcome(out);
+            break;
+        }
+        snprintf(msg, sizeof(msg), "\r\nWelcome back user '%s'!", (char *)account_name);
+        out += msg;
+        menu(out);
+        break;
+
+    case State::Menu:
+        if (line[0] == 'B')
+        {
+            format_amount(text, sizeof(text), account->get_account_balance());
+            snprintf(msg, sizeof(msg), "\r\nBalance: %s", text);
+            out += msg;
+            menu(out);
+        }
+        else if (line[0] == 'D')
+        {
+            out += "\r\nEnter deposit amount: ";
+            state = State::DepositAmount;
+        }
+        else if (line[0] == 'W')
+        {
+            out += "\r\nEnter withdrawal amount: ";
+            state = State::WithdrawAmount;
+        }
+        else if (line[0] == 'Q')
+        {
+            account = nullptr;
+            welcome(out);
+        }
+        else
+        {
+            if (line[0] != 0)
+                out += "\r\nInvalid option.";
+            menu(out);
+        }
+        break;
+
+    /* Balance updates are lock-free; the shard lock only guards the index */
+    case State::DepositAmount:
+        error = parse_amount((const uint8_t *)line.data(), line.size(), &amount, nullptr);
+        if (error != AMOUNT_OK)
+        {
+            snprintf(msg, sizeof(msg), "\r\nInvalid amount: %s.", amount_error_text(error));
+            out += msg;
+        }
+        else if (account->deposit(amount))
+        {
+            format_amount(text, sizeof(text), amount);
+            snprintf(msg, sizeof(msg), "\r\nDeposit of %s successful.", text);
+            out += msg;
+        }
+        else
+            out += "\r\nDeposit rejected.";
+        menu(out);
+        break;
+
+    case State::WithdrawAmount:
+        error = parse_amount((const uint8_t *)line.data(), line.size(), &amount, nullptr);
+        if (error != AMOUNT_OK)
+        {
+            snprintf(msg, sizeof(msg), "\r\nInvalid amount: %s.", amount_error_text(error));
+            out += msg;
+        }
+        else if (account->withdraw(amount))
+        {
+            format_amount(text, sizeof(text), amount);
+            snprintf(msg, sizeof(msg), "\r\nWithdrawal of %s successful.", text);
+            out += msg;
+        }
+        else
+            out += "\r\nInsufficient balance for withdrawal.";
+        menu(out);
+        break;
+    }
+}
+
+struct LedgerServer::Connection
+{
+    int fd;
+    bool last_cr;
+    bool want_out;
+    std::string in;
+    std::string out;
+    LedgerSession session;
+
+    Connection(int fd, ShardedBank &bank) : fd(fd), last_cr(false), want_out(true), session(bank) {}
+};
+
+struct LedgerServer::Worker
+{
+    int epoll_fd;
+    int wake_fd;
+    std::thread thread;
+    std::mutex lock; // guards conns against the acceptor
+    std::unordered_set<Connection *> conns;
+};
+
+LedgerServer::LedgerServer(ShardedBank &bank, const std::string &socket_path)
+    : bank(bank), socket_path(socket_path), listen_fd(-1), running(false)
+{
+}
+
+LedgerServer::~LedgerServer()
+{
+    stop();
+}
+
+bool LedgerServer::start(unsigned worker_count)
+{
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        return false;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 128) != 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    running = true;
+    for (unsigned i = 0; i < worker_count; i++)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->epoll_fd = epoll_create1(0);
+        worker->wake_fd = eventfd(0, 0);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wake_fd, &ev);
+        Worker &ref = *worker;
+        worker->thread = std::thread([this, &ref]() { worker_loop(ref); });
+        workers.push_back(std::move(worker));
+    }
+    return true;
+}
+
+/**
+ * @brief  Accept connections and hand them to the workers round-robin until stop().
+ */
+void LedgerServer::serve()
+{
+    size_t next = 0;
+    while (running)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        Worker &worker = *workers[next++ % workers.size()];
+        Connection *conn = new Connection(fd, bank);
+        conn->session.start(conn->out);
+        {
+            std::lock_guard<std::mutex> guard(worker.lock);
+            worker.conns.insert(conn);
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.ptr = conn;
+        epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/**
+ * @brief  Make serve() return. Async-signal-safe.
+ */
+void LedgerServer::interrupt()
+{
+    running = false;
+    if (listen_fd >= 0)
+        shutdown(listen_fd, SHUT_RDWR);
+}
+
+void LedgerServer::stop()
+{
+    if (listen_fd < 0)
+        return;
+    interrupt();
+    for (auto &worker : workers)
+    {
+        uint64_t one = 1;
+        if (write(worker->wake_fd, &one, sizeof(one)) < 0)
+            perror("eventfd");
+        worker->thread.join();
+        for (Connection *conn : worker->conns)
+        {
+            close(conn->fd);
+            delete conn;
+        }
+        close(worker->wake_fd);
+        close(worker->epoll_fd);
+    }
+    workers.clear();
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+}
+
+void LedgerServer::close_connection(Worker &worker, Connection *conn)
+{
+    epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.conns.erase(conn);
+    }
+    delete conn;
+}
+
+void LedgerServer::worker_loop(Worker &worker)
+{
+    struct epoll_event events[64];
+    char buf[4096];
+
+    while (running)
+    {
+        int n = epoll_wait(worker.epoll_fd, events, 64, -1);
+        for (int i = 0; i < n; i++)
+        {
+            Connection *conn = (Connection *)events[i].data.ptr;
+            if (conn == nullptr)
+                return; // woken by stop()
+
+            bool closed = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+            if (!closed && (events[i].events & EPOLLIN))
+            {
+                ssize_t len = read(conn->fd, buf, sizeof(buf));
+                if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+                    closed = true;
+                for (ssize_t k = 0; k < len; k++)
+                {
+                    char c = buf[k];
+                    if (c == '\r' || c == '\n')
+                    {
+                        if (!(c == '\n' && conn->last_cr))
+                        {
+                            conn->session.on_line(conn->in, conn->out);
+                            conn->in.clear();
+                        }
+                        conn->last_cr = (c == '\r');
+                        continue;
+                    }
+                    conn->last_cr = false;
+                    conn->in.push_back(c);
+                }
+            }
+
+            if (!closed && !conn->out.empty())
+            {
+                ssize_t len = write(conn->fd, conn->out.data(), conn->out.size());
+                if (len > 0)
+                    conn->out.erase(0, (size_t)len);
+                else if (len < 0 && errno != EAGAIN && errno != EINTR)
+                    closed = true;
+            }
+
+            if (closed)
+            {
+                close_connection(worker, conn);
+                continue;
+            }
+
+            /* Only ask for writability while output is pending */
+            if (conn->want_out != !conn->out.empty())
+            {
+                conn->want_out = !conn->out.empty();
+                struct epoll_event ev;
+                ev.events = EPOLLIN | (conn->want_out ? (uint32_t)EPOLLOUT : 0U);
+                ev.data.ptr = conn;
+                epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include "bank_account.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Account table split into independently locked shards by name hash, */
+/* so sessions on different accounts never contend for the same lock. */
+/* A hot account, e.g. a shop that many sessions pay into at once, takes */
+/* deposits into per-thread slices (BankAccount::make_hot()); it is made */
+/* hot before it is indexed, so no other session can be using it yet. */
+/* Names are passed in buffers of NAME_LEN_MAX bytes, 0-terminated if shorter. */
+class ShardedBank
+{
+private:
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<std::string, BankAccount *> index;
+        std::deque<BankAccount> accounts; // push_back keeps references stable
+        std::deque<HotSlices> slices;     // of the hot accounts, as stable
+    };
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    Shard &shard_for(const uint8_t *name);
+
+public:
+    enum class CreateStatus
+    {
+        Created,
+        NameTaken,
+        BadName, // empty
+        NoNameSpace // Names() is full
+    };
+
+    explicit ShardedBank(size_t shard_count);
+    CreateStatus create(const uint8_t *name, const uint8_t *password, bool hot = false);
+    BankAccount *find(const uint8_t *name, const uint8_t *password);
+    size_t size();
+};
+
+/* One console session: the welcome / account menu dialog of main.cpp, */
+/* driven a line at a time instead of by blocking UART reads. */
+class LedgerSession
+{
+private:
+    enum class State
+    {
+        Welcome,
+        CreateName,
+        CreatePassword,
+        CreateConfirm,
+        LoginName,
+        LoginPassword,
+        Menu,
+        DepositAmount,
+        WithdrawAmount
+    };
+    ShardedBank &bank;
+    State state;
+    uint8_t account_name[NAME_LEN_MAX + 1];
+    uint8_t password[PASSWORDSIZE];
+    bool create_hot; // the account being created is a hot one
+    BankAccount *account;
+
+    void welcome(std::string &out);
+    void menu(std::string &out);
+    bool take_name(const std::string &line, std::string &out);
+
+public:
+    explicit LedgerSession(ShardedBank &bank);
+    void start(std::string &out);
+    void on_line(const std::string &line, std::string &out);
+};
+
+/* Unix socket front end: one acceptor, a pool of epoll workers. */
+class LedgerServer
+{
+private:
+    struct Connection;
+    struct Worker;
+    ShardedBank &bank;
+    std::string socket_path;
+    int listen_fd;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> running;
+
+    void worker_loop(Worker &worker);
+    static void close_connection(Worker &worker, Connection *conn);
+
+public:
+    LedgerServer(ShardedBank &bank, const std::string &socket_path);
+    ~LedgerServer();
+    bool start(unsigned worker_count);
+    void serve();
+    void interrupt();
+    void stop();
+};
+
+#endif // LEDGER_H
@@ -0,0 +1,200 @@
+/* ledger-bench: loopback load test of the ledger server across 1..N worker threads. */
+/* Each client owns one account and loops deposit / withdraw / balance. Then all */
+/* clients share one account, created normal (N) and hot (H), on N workers, and */
+/* its final balance is checked against the deposits and withdrawals made. */
+/* Usage: ledger-bench [max workers] [clients] [seconds per point] */
+
+#include "ledger.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char *const prompt = "Please enter: ";
+
+/* Blocking line client for one session */
+class BenchClient
+{
+private:
+    int fd;
+    std::string buf;
+
+public:
+    std::string reply; // up to the last marker expected
+    BenchClient() : fd(-1) {}
+    ~BenchClient()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool connect_to(const char *path)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        return connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && expect(prompt);
+    }
+
+    bool expect(const char *marker)
+    {
+        char chunk[512];
+        while (true)
+        {
+            size_t pos = buf.find(marker);
+            if (pos != std::string::npos)
+            {
+                reply.assign(buf, 0, pos);
+                buf.erase(0, pos + strlen(marker));
+                return true;
+            }
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0)
+                return false;
+            buf.append(chunk, (size_t)n);
+        }
+    }
+
+    bool send_line(const char *line, const char *marker)
+    {
+        std::string msg = std::string(line) + "\r";
+        return write(fd, msg.data(), msg.size()) == (ssize_t)msg.size() && expect(marker);
+    }
+};
+
+static const char *const shared_name = "shop";
+
+enum class Shared
+{
+    None,   // an account per client
+    Normal, // all clients on shared_name
+    Hot     // the same, created with H
+};
+
+static bool login(BenchClient &client, const char *name)
+{
+    return client.send_line("E", ": ") && client.send_line(name, ": ") && client.send_line("pw", prompt);
+}
+
+/* net: cents the client's successful deposits and withdrawals added */
+static void run_client(const char *path, unsigned id, Shared shared, std::atomic<bool> &stop,
+                       std::atomic<uint64_t> &ops, std::atomic<int64_t> &net)
+{
+    BenchClient client;
+    char name[NAME_LEN_MAX + 1];
+    snprintf(name, sizeof(name), "b%u", id);
+    if (!client.connect_to(path))
+        return;
+    if (shared != Shared::None ? !login(client, shared_name)
+                               : !client.send_line("N", ": ") || !client.send_line(name, ": ") ||
+                                     !client.send_line("pw", ": ") || !client.send_line("pw", prompt))
+        return;
+
+    uint64_t done = 0;
+    int64_t cents = 0;
+    while (!stop)
+    {
+        if (!client.send_line("D", ": ") || !client.send_line("2", prompt))
+            break;
+        cents += client.reply.find("successful") != std::string::npos ? 200 : 0;
+        if (!client.send_line("W", ": ") || !client.send_line("1", prompt))
+            break;
+        cents -= client.reply.find("successful") != std::string::npos ? 100 : 0;
+        if (!client.send_line("B", prompt))
+            break;
+        done += 3;
+    }
+    ops += done;
+    net += cents;
+}
+
+/* Balance of an account in cents, -1 if it cannot be read */
+static int64_t read_balance(const char *path, const char *name)
+{
+    BenchClient client;
+    if (!client.connect_to(path) || !login(client, name) || !client.send_line("B", prompt))
+        return -1;
+    size_t at = client.reply.find("Balance: ");
+    return at == std::string::npos ? -1 : llround(atof(client.reply.c_str() + at + 9) * 100);
+}
+
+/* One measurement; with a shared account, ok tells whether its balance */
+/* matches what the clients saw succeed */
+static double run_point(const char *path, unsigned workers, unsigned clients, double seconds, Shared shared,
+                        bool *ok)
+{
+    ShardedBank bank(64);
+    LedgerServer server(bank, path);
+    if (!server.start(workers))
+    {
+        perror(path);
+        exit(1);
+    }
+    std::thread acceptor([&server]() { server.serve(); });
+
+    *ok = true;
+    if (shared != Shared::None)
+    {
+        BenchClient owner;
+        *ok = owner.connect_to(path) && owner.send_line(shared == Shared::Hot ? "H" : "N", ": ") &&
+              owner.send_line(shared_name, ": ") && owner.send_line("pw", ": ") && owner.send_line("pw", prompt) &&
+              owner.reply.find("created") != std::string::npos;
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> ops(0);
+    std::atomic<int64_t> net(0);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < clients; i++)
+        threads.emplace_back(run_client, path, i, shared, std::ref(stop), std::ref(ops), std::ref(net));
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (shared != Shared::None)
+        *ok = *ok && read_balance(path, shared_name) == net;
+
+    server.stop();
+    acceptor.join();
+    return ops / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_workers = argc > 1 ? (unsigned)atoi(argv[1]) : std::thread::hardware_concurrency();
+    unsigned clients = argc > 2 ? (unsigned)atoi(argv[2]) : 4 * max_workers;
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    const char *path = "/tmp/embedded-bank-bench.sock";
+
+    printf("%8s %8s %12s %8s\n", "workers", "clients", "tx/s", "scaling");
+    double base = 0;
+    bool ok = true;
+    for (unsigned workers = 1; workers <= max_workers; workers *= 2)
+    {
+        double rate = run_point(path, workers, clients, seconds, Shared::None, &ok);
+        if (base == 0)
+            base = rate;
+        printf("%8u %8u %12.0f %7.2fx\n", workers, clients, rate, rate / base);
+        if (workers < max_workers && workers * 2 > max_workers)
+            workers = max_workers / 2; // always finish on max_workers
+    }
+
+    printf("\none account for all clients:\n%8s %8s %12s %8s\n", "account", "workers", "tx/s", "balance");
+    bool all_ok = true;
+    for (Shared shared : {Shared::Normal, Shared::Hot})
+    {
+        double rate = run_point(path, max_workers, clients, seconds, shared, &ok);
+        printf("%8s %8u %12.0f %8s\n", shared == Shared::Hot ? "hot" : "normal", max_workers, rate,
+               ok ? "ok" : "WRONG");
+        all_ok = all_ok && ok;
+    }
+    return all_ok ? 0 : 1;
+}
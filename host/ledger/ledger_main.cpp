@@ -0,0 +1,38 @@
+/* ledger-server: BankAccount engine on a Unix socket, same dialog as the UART console. */
+/* Usage: ledger-server [socket path] [workers] [shards] */
+
+#include "ledger.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static LedgerServer *server = nullptr;
+
+static void on_signal(int)
+{
+    if (server != nullptr)
+        server->interrupt();
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/embedded-bank.sock";
+    unsigned workers = argc > 2 ? (unsigned)atoi(argv[2]) : std::thread::hardware_concurrency();
+    size_t shards = argc > 3 ? (size_t)atoi(argv[3]) : 64;
+
+    ShardedBank bank(shards);
+    LedgerServer ledger(bank, path);
+    if (!ledger.start(workers ? workers : 1))
+    {
+        perror(path);
+        return 1;
+    }
+    server = &ledger;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Embedded Bank ledger on %s: %u workers, %zu shards\n", path, workers, shards);
+    fflush(stdout);
+    ledger.serve();
+    ledger.stop();
+    return 0;
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Batch deposit throughput at each console baud rate, on the simulator.
+
+Creates MAX_ACCOUNTS accounts, then streams a batch of --records
+"name,amount" lines through welcome menu B back to back at each baud rate
+(BANK_SIM_BAUD, BANK_SIM_THINK_MS=0, see host/Inc/sim_host.h). Every
+--fail-every'th record is broken on purpose. The firmware's batch summary,
+failure list and total balance are checked against what was sent, and the
+records per second it measured on the virtual clock are tabulated.
+
+  tools/batch_bench.py --exec host/build/stm32-oop-host
+"""
+
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+ACCOUNTS = 10       # MAX_ACCOUNTS
+FAILURES_MAX = 16   # BATCH_FAILURES_MAX
+PASSWORD = "payroll"
+BAUDS = (9600, 19200, 38400, 57600, 115200, 230400, 460800)
+
+
+def make_batch(records, fail_every, rng):
+    """[(line, cents or None, reason)] with one broken record every fail_every."""
+    batch = []
+    broken = ("F", "A", "N")
+    for i in range(1, records + 1):
+        name = "b%d" % rng.randrange(ACCOUNTS)
+        cents = rng.randint(1, 50000)
+        amount = "%d.%02d" % (cents // 100, cents % 100)
+        kind = broken[(i // fail_every) % len(broken)] if fail_every and i % fail_every == 0 else None
+        if kind == "F":
+            batch.append((name + amount, None, "F"))
+        elif kind == "A":
+            batch.append(("%s,%s.5" % (name, amount), None, "A"))
+        elif kind == "N":
+            batch.append(("nobody,%s" % amount, None, "N"))
+        else:
+            batch.append(("%s,%s" % (name, amount), cents, None))
+    return batch
+
+
+def write_scenario(path, batch):
+    with open(path, "w") as f:
+        for i in range(ACCOUNTS):
+            f.write("send N\nsend b%d\nsend pw\nsend pw\nexpect created\nsend Q\n" % i)
+        f.write("send B\nsend %s\nexpect own line.\n" % PASSWORD)
+        for line, _, _ in batch:
+            f.write("send %s\n" % line)
+        f.write("send .\nexpect records/s)\nsend S\nsend T\nexpect Total balance\nsend Q\n")
+
+
+def run(args, scenario, baud):
+    env = dict(os.environ, BANK_SIM=scenario, BANK_SIM_RUNS="1", BANK_SIM_SEED=str(args.seed),
+               BANK_SIM_ECHO="1", BANK_SIM_BAUD=str(baud), BANK_SIM_THINK_MS="0")
+    result = subprocess.run([args.exec], env=env, stdin=subprocess.DEVNULL, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        return None
+    return result.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, help="host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--records", type=int, default=500, help="records per batch (default: 500)")
+    parser.add_argument("--fail-every", type=int, default=50, help="break every n'th record, 0 for none")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    batch = make_batch(args.records, args.fail_every, random.Random(args.seed))
+    posted = [cents for _, cents, _ in batch if cents is not None]
+    failures = ["%d%s" % (i, reason) for i, (_, _, reason) in enumerate(batch, 1) if reason]
+    total = sum(posted)
+    expected_summary = "Batch complete: %d records, %d posted (%d.%02d), %d failed" % (
+        len(batch), len(posted), total // 100, total % 100, len(failures))
+    expected_failed = " ".join(failures[:FAILURES_MAX])
+    if len(failures) > FAILURES_MAX:
+        expected_failed += " +%d more" % (len(failures) - FAILURES_MAX)
+
+    fd, scenario = tempfile.mkstemp(suffix=".txt")
+    os.close(fd)
+    ok = True
+    try:
+        write_scenario(scenario, batch)
+        print("%d records, %d broken on purpose" % (len(batch), len(failures)))
+        print("%8s %10s %10s" % ("baud", "ms", "records/s"))
+        for baud in BAUDS:
+            output = run(args, scenario, baud)
+            summary = re.search(r"(Batch complete: .*) in (\d+) ms \((\d+) records/s\)", output or "")
+            failed = re.search(r"Failed: (.*)", output or "")
+            balance = re.search(r"Total balance: (\S+)", output or "")
+            problems = []
+            if summary is None:
+                problems.append("no summary")
+            else:
+                if summary.group(1) != expected_summary:
+                    problems.append("summary '%s', expected '%s'" % (summary.group(1), expected_summary))
+                if failures and (failed is None or failed.group(1).strip() != expected_failed):
+                    problems.append("failure list '%s'" % (failed.group(1).strip() if failed else ""))
+                if balance is None or balance.group(1) != "%d.%02d" % (total // 100, total % 100):
+                    problems.append("total balance %s" % (balance.group(1) if balance else "missing"))
+            if problems:
+                ok = False
+                print("%8d FAILED: %s" % (baud, "; ".join(problems)))
+            else:
+                print("%8d %10s %10s" % (baud, summary.group(2), summary.group(3)))
+    finally:
+        os.unlink(scenario)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Failover test for primary-backup replication on the host build.
+
+Starts two firmware processes joined by a pair of pipes standing in for the
+USART2 crossover cable, one of them strapped as backup (BANK_ROLE=backup).
+Creates accounts and runs deposits and withdrawals on the primary, waits
+until the primary reports no replication lag, then kills the primary with
+SIGKILL, promotes the backup and checks that every balance survived.
+With --restart-primary the primary is killed once before that and started
+again with an empty table; the accounts are created afresh on it and get a
+few operations, so the backup has to follow a primary whose sequence started
+over.
+
+  tools/failover.py --exec host/build/stm32-oop-host --accounts 10 --ops 200
+"""
+
+import argparse
+import os
+import random
+import re
+import signal
+import sys
+import time
+
+from loadgen import MENU_PROMPT, NAME_MAX, LinkTimeout, ProcessLink
+
+RESTART_OPS = 10  # operations after --restart-primary
+
+
+def step(link, inputs, timeout):
+    """Send inputs, each answered by a prompt, and return the reply up to the next menu prompt."""
+    reply = ""
+    for text in inputs:
+        link.send_line(text)
+        reply = link.expect(": ", timeout)
+    if not reply.endswith(MENU_PROMPT):
+        reply += link.expect(MENU_PROMPT, timeout)
+    return reply
+
+
+def start(command, role, fd_in, fd_out, timeout):
+    env = dict(os.environ, BANK_REPL_FDS="%d,%d" % (fd_in, fd_out), BANK_ROLE=role)
+    for name in ("BANK_SIM", "BANK_EXT_MEM", "BANK_TRACE"):
+        env.pop(name, None)
+    link = ProcessLink(command, env=env, pass_fds=(fd_in, fd_out))
+    link.expect(MENU_PROMPT, timeout)
+    return link
+
+
+def replication_report(link, timeout):
+    step(link, ["S"], timeout)
+    report = step(link, ["L"], timeout)
+    step(link, ["Q"], timeout)
+    return report
+
+
+def report_lines(report):
+    """The report itself, without the echoed option and the menu that follows it."""
+    text = report.replace("\r", "")
+    return text[text.find("Replication:"):text.find("\nStack (K)")]
+
+
+def balances(link, accounts, timeout):
+    result = {}
+    for name, password in accounts:
+        reply = step(link, ["E", name, password], timeout)
+        if "Welcome back" not in reply:
+            result[name] = None
+            continue
+        match = re.search(r"Balance: (\S+)", step(link, ["B"], timeout))
+        result[name] = match.group(1) if match else None
+        step(link, ["Q"], timeout)
+    return result
+
+
+def workload(primary, args, ops, rng):
+    """Create the accounts and run the deposits and withdrawals; returns the (name, password) pairs."""
+    accounts = []
+    start_time = time.monotonic()
+    for i in range(args.accounts):
+        name, password = "fo%d" % i, "pw%d" % i
+        if i == 0:
+            name = name.ljust(NAME_MAX, "x")  # replicated at full length
+        if "created" not in step(primary, ["N", name, password, password], args.timeout):
+            raise SystemExit("could not create account %s" % name)
+        step(primary, ["Q"], args.timeout)
+        accounts.append((name, password))
+
+    for _ in range(ops):
+        name, password = rng.choice(accounts)
+        step(primary, ["E", name, password], args.timeout)
+        op = rng.choice(["D", "D", "W"])
+        step(primary, [op, "%d.%02d" % (rng.randint(1, 500), rng.randint(0, 99))], args.timeout)
+        step(primary, ["Q"], args.timeout)
+    elapsed = time.monotonic() - start_time
+    print("%d accounts, %d operations on the primary in %.2f s" % (args.accounts, ops, elapsed))
+    return accounts
+
+
+def wait_for_backup(primary, timeout):
+    """Poll the primary until it reports no replication lag; returns its report, None on a timeout."""
+    deadline = time.monotonic() + timeout
+    while True:
+        report = replication_report(primary, timeout)
+        lag = re.search(r"lag (\d+) records", report)
+        if lag and lag.group(1) == "0":
+            return report
+        if time.monotonic() > deadline:
+            print("primary still lagging:\n" + report_lines(report))
+            return None
+        time.sleep(0.05)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, help="host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--accounts", type=int, default=8, help="accounts to create (default: 8)")
+    parser.add_argument("--ops", type=int, default=100, help="deposits and withdrawals (default: 100)")
+    parser.add_argument("--late-backup", action="store_true",
+                        help="start the backup only after the workload, so it has to catch up by snapshot")
+    parser.add_argument("--restart-primary", action="store_true",
+                        help="kill and restart the primary once, then run the workload again on it")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for a prompt")
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+
+    to_backup = os.pipe()
+    to_primary = os.pipe()
+    primary = start(args.exec, "primary", to_primary[0], to_backup[1], args.timeout)
+    backup = None
+    if not args.late_backup:
+        backup = start(args.exec, "backup", to_backup[0], to_primary[1], args.timeout)
+
+    accounts = workload(primary, args, args.ops, rng)
+    if backup is None:
+        backup = start(args.exec, "backup", to_backup[0], to_primary[1], args.timeout)
+    if args.restart_primary:
+        if wait_for_backup(primary, args.timeout) is None:
+            return 1
+        primary.proc.send_signal(signal.SIGKILL)
+        primary.proc.wait()
+        primary = start(args.exec, "primary", to_primary[0], to_backup[1], args.timeout)
+        print("primary restarted")
+        # fewer records than REPL_LOG_SIZE, so no log overflow forces a resync
+        accounts = workload(primary, args, RESTART_OPS, rng)
+    for fd in to_backup + to_primary:
+        os.close(fd)  # the children hold their ends; EOF then means the peer died
+
+    report = wait_for_backup(primary, args.timeout)
+    if report is None:
+        return 1
+    print(report_lines(report))
+    expected = balances(primary, accounts, args.timeout)
+
+    primary.proc.send_signal(signal.SIGKILL)
+    primary.proc.wait()
+    print(report_lines(replication_report(backup, args.timeout)))
+    if "Promoted" not in step(backup, ["P"], args.timeout):
+        print("backup refused promotion")
+        return 1
+    actual = balances(backup, accounts, args.timeout)
+    backup.close()
+
+    bad = [name for name in expected if expected[name] is None or expected[name] != actual.get(name)]
+    for name in bad:
+        print("%s: primary %s, backup %s" % (name, expected[name], actual.get(name)))
+    print("failover %s: %d of %d balances match" % ("passed" if not bad else "FAILED", len(expected) - len(bad),
+                                                   len(expected)))
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except LinkTimeout as e:
+        print("timed out waiting for %r" % str(e))
+        sys.exit(1)
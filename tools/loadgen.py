@@ -0,0 +1,361 @@
+#!/usr/bin/env python3
+"""Load generator and session replay tool for the Embedded Bank UART console.
+
+Drives either a real serial port (--serial) or the Linux build of the
+firmware (--exec, see host/) and reports transactions per second,
+per-operation p50/p99 latency, and error and timeout counts.
+
+  run     N virtual clients doing create/login/deposit/withdraw/balance
+          sequences in configurable ratios
+  replay  replay recorded session transcripts as fast as the target allows
+"""
+
+import argparse
+import os
+import random
+import re
+import selectors
+import shlex
+import subprocess
+import sys
+import threading
+import time
+from collections import defaultdict
+
+MENU_PROMPT = "Please enter: "
+NAME_MAX = 40      # NAME_LEN_MAX
+PASSWORD_MAX = 9   # PASSWORDSIZE - 1
+DEFAULT_MIX = "create=1,login=4,deposit=5,withdraw=3,balance=2"
+ERROR_MARKERS = ("Invalid", "aborted", "not available", "capacity is full", "do not match")
+
+
+class LinkTimeout(Exception):
+    pass
+
+
+class Link:
+    """Byte stream to one firmware instance with prompt matching."""
+
+    def __init__(self):
+        self.buf = ""
+        self.lock = threading.Lock()
+
+    def send_line(self, text):
+        self.write((text + "\r").encode())
+
+    def expect(self, marker, timeout):
+        """Wait until marker appears; return everything received up to and including it."""
+        deadline = time.monotonic() + timeout
+        while True:
+            idx = self.buf.find(marker)
+            if idx >= 0:
+                end = idx + len(marker)
+                out, self.buf = self.buf[:end], self.buf[end:]
+                return out
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise LinkTimeout(marker)
+            data = self.read(remaining)
+            if data:
+                self.buf += data.decode(errors="replace")
+
+    def resync(self, timeout):
+        """Get back to a known prompt after a timeout or unexpected output."""
+        self.buf = ""
+        self.send_line("")
+        try:
+            return self.expect(MENU_PROMPT, timeout)
+        except LinkTimeout:
+            return ""
+
+
+class ProcessLink(Link):
+    """Firmware built for Linux, talking over its stdin/stdout."""
+
+    def __init__(self, command, env=None, pass_fds=()):
+        super().__init__()
+        self.proc = subprocess.Popen(shlex.split(command), stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0,
+                                     env=env, pass_fds=pass_fds)
+        os.set_blocking(self.proc.stdout.fileno(), False)
+        self.sel = selectors.DefaultSelector()
+        self.sel.register(self.proc.stdout, selectors.EVENT_READ)
+
+    def write(self, data):
+        self.proc.stdin.write(data)
+
+    def read(self, timeout):
+        if not self.sel.select(timeout):
+            return b""
+        data = self.proc.stdout.read(4096)
+        if data == b"":
+            raise LinkTimeout("target exited")
+        return data or b""
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait()
+
+
+class SerialLink(Link):
+    """The board's serial console."""
+
+    def __init__(self, device, baud):
+        super().__init__()
+        import serial  # pyserial, only needed for real hardware
+
+        self.port = serial.Serial(device, baud, timeout=0)
+
+    def write(self, data):
+        self.port.write(data)
+
+    def read(self, timeout):
+        self.port.timeout = min(timeout, 0.05)
+        return self.port.read(self.port.in_waiting or 1)
+
+    def close(self):
+        self.port.close()
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latency = defaultdict(list)
+        self.errors = defaultdict(int)
+        self.rejected = defaultdict(int)
+        self.timeouts = defaultdict(int)
+
+    def record(self, op, seconds):
+        with self.lock:
+            self.latency[op].append(seconds)
+
+    def count(self, table, op):
+        with self.lock:
+            table[op] += 1
+
+    def report(self, elapsed, out=sys.stdout):
+        total = sum(len(v) for v in self.latency.values())
+        out.write("%d transactions in %.2f s: %.1f tx/s\n" % (total, elapsed, total / elapsed if elapsed else 0))
+        out.write("  %-20s %8s %10s %10s %8s %8s %8s\n" % ("op", "count", "p50 ms", "p99 ms", "errors", "rejected", "timeouts"))
+        for op in sorted(set(self.latency) | set(self.errors) | set(self.timeouts) | set(self.rejected)):
+            samples = sorted(self.latency[op])
+            out.write("  %-20s %8d %10.2f %10.2f %8d %8d %8d\n" % (
+                op, len(samples), percentile(samples, 50) * 1e3, percentile(samples, 99) * 1e3,
+                self.errors[op], self.rejected[op], self.timeouts[op]))
+
+
+def percentile(samples, pct):
+    if not samples:
+        return 0.0
+    idx = min(len(samples) - 1, int(round(pct / 100.0 * (len(samples) - 1))))
+    return samples[idx]
+
+
+class Target:
+    """One firmware instance and the accounts created on it."""
+
+    def __init__(self, link, capacity):
+        self.link = link
+        self.capacity = capacity
+        self.accounts = []
+
+
+class Client(threading.Thread):
+    def __init__(self, cid, targets, mix, args, stats, stop):
+        super().__init__(daemon=True)
+        self.cid = cid
+        self.targets = targets
+        self.mix = mix
+        self.args = args
+        self.stats = stats
+        self.stop = stop
+        self.rng = random.Random(args.seed * 1000003 + cid)
+        self.created = 0
+
+    def step(self, link, op, inputs, expect_ok):
+        """Send inputs (each answered by a prompt) and time until the next menu prompt."""
+        start = time.monotonic()
+        try:
+            reply = ""
+            for text in inputs:
+                link.send_line(text)
+                reply = link.expect(": ", self.args.timeout)
+            if not reply.endswith(MENU_PROMPT):
+                reply += link.expect(MENU_PROMPT, self.args.timeout)
+        except LinkTimeout:
+            self.stats.count(self.stats.timeouts, op)
+            link.resync(self.args.timeout)
+            return False
+        self.stats.record(op, time.monotonic() - start)
+        if "Insufficient" in reply:
+            self.stats.count(self.stats.rejected, op)
+            return True
+        if any(marker in reply for marker in ERROR_MARKERS) or (expect_ok and expect_ok not in reply):
+            self.stats.count(self.stats.errors, op)
+            return False
+        return True
+
+    def open_session(self, target):
+        weights = {k: self.mix.get(k, 0) for k in ("create", "login")}
+        if not target.accounts:
+            weights["login"] = 0
+        if len(target.accounts) >= target.capacity:
+            weights["create"] = 0
+        if not any(weights.values()):
+            return None
+        op = self.rng.choices(list(weights), list(weights.values()))[0]
+        if op == "create":
+            name = ("c%da%d" % (self.cid, self.created))[:NAME_MAX]
+            password = ("p%d" % self.rng.randrange(10 ** 6))[:PASSWORD_MAX]
+            self.created += 1
+            if self.step(target.link, op, ["N", name, password, password], "created"):
+                target.accounts.append((name, password))
+                return name
+            return None
+        name, password = self.rng.choice(target.accounts)
+        return name if self.step(target.link, op, ["E", name, password], "Welcome back") else None
+
+    def run_op(self, link):
+        ops = {k: self.mix.get(k, 0) for k in ("deposit", "withdraw", "balance")}
+        op = self.rng.choices(list(ops), list(ops.values()))[0]
+        amount = "%d" % self.rng.randint(1, self.args.max_amount)
+        if op == "deposit":
+            return self.step(link, op, ["D", amount], "successful")
+        if op == "withdraw":
+            return self.step(link, op, ["W", amount], None)
+        return self.step(link, op, ["B"], "Balance")
+
+    def run(self):
+        sessions = 0
+        while not self.stop.is_set() and (self.args.sessions == 0 or sessions < self.args.sessions):
+            target = self.targets[self.cid % len(self.targets)]
+            # A target serves one console session at a time
+            with target.link.lock:
+                if self.open_session(target) is not None:
+                    for _ in range(self.args.ops_per_session):
+                        if self.stop.is_set() or not self.run_op(target.link):
+                            break
+                    self.step(target.link, "quit", ["Q"], None)
+            sessions += 1
+
+
+def parse_mix(text):
+    mix = {}
+    for item in text.split(","):
+        key, _, value = item.partition("=")
+        mix[key.strip()] = float(value)
+    return mix
+
+
+def open_links(args, count):
+    if args.serial:
+        return [SerialLink(args.serial, args.baud)]
+    return [ProcessLink(args.exec) for _ in range(count)]
+
+
+def cmd_run(args):
+    stats = Stats()
+    stop = threading.Event()
+    links = open_links(args, args.clients)
+    targets = []
+    for link in links:
+        link.expect(MENU_PROMPT, args.timeout)
+        targets.append(Target(link, args.capacity))
+    clients = [Client(i, targets, parse_mix(args.mix), args, stats, stop) for i in range(args.clients)]
+
+    start = time.monotonic()
+    for client in clients:
+        client.start()
+    deadline = start + args.duration if args.duration else None
+    for client in clients:
+        while client.is_alive():
+            client.join(0.1)
+            if deadline and time.monotonic() >= deadline:
+                stop.set()
+    elapsed = time.monotonic() - start
+    stats.report(elapsed)
+    for link in links:
+        link.close()
+    return 0
+
+
+# "Enter deposit amount: 1000" - prompt text, then what the user typed
+TRANSCRIPT_RE = re.compile(r"^(.*(?:Please enter|Enter [a-z ]+|Confirm password)): ?(.*)$")
+
+
+def load_transcript(path):
+    """Parse a terminal capture into (prompt, input) steps."""
+    steps = []
+    with open(path) as f:
+        for line in f:
+            m = TRANSCRIPT_RE.match(line.rstrip("\r\n"))
+            if m and m.group(2):
+                steps.append((m.group(1).strip() + ": ", m.group(2)))
+    return steps
+
+
+def cmd_replay(args):
+    stats = Stats()
+    transcripts = [(path, load_transcript(path)) for path in args.transcripts]
+    link = open_links(args, 1)[0] if args.serial else None
+
+    start = time.monotonic()
+    for _ in range(args.repeat):
+        for path, steps in transcripts:
+            # Each replay gets a fresh host instance so recorded names stay available
+            run_link = link or ProcessLink(args.exec)
+            op = os.path.basename(path)
+            t0 = time.monotonic()
+            try:
+                for prompt, text in steps:
+                    run_link.expect(prompt, args.timeout)
+                    run_link.send_line(text)
+                run_link.expect(MENU_PROMPT, args.timeout)
+                if any(marker in run_link.buf for marker in ERROR_MARKERS):
+                    stats.count(stats.errors, op)
+                stats.record(op, time.monotonic() - t0)
+            except LinkTimeout:
+                stats.count(stats.timeouts, op)
+                run_link.resync(args.timeout)
+            if link is None:
+                run_link.close()
+    elapsed = time.monotonic() - start
+    stats.report(elapsed)
+    steps = sum(len(s) for _p, s in transcripts) * args.repeat
+    print("%d inputs replayed: %.1f inputs/s" % (steps, steps / elapsed if elapsed else 0))
+    if link:
+        link.close()
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    target = parser.add_mutually_exclusive_group(required=True)
+    target.add_argument("--serial", help="serial device of the board, e.g. /dev/ttyUSB0")
+    target.add_argument("--exec", help="command line of the host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--timeout", type=float, default=25.0, help="seconds to wait for each prompt")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    run = sub.add_parser("run", help="scripted virtual clients")
+    run.add_argument("--clients", type=int, default=1,
+                     help="virtual clients; with --exec each client gets its own instance")
+    run.add_argument("--mix", default=DEFAULT_MIX, help="operation weights (default: %s)" % DEFAULT_MIX)
+    run.add_argument("--ops-per-session", type=int, default=5)
+    run.add_argument("--sessions", type=int, default=0, help="sessions per client, 0 for no limit")
+    run.add_argument("--duration", type=float, default=10.0, help="seconds, 0 for no limit")
+    run.add_argument("--capacity", type=int, default=10, help="accounts per target (MAX_ACCOUNTS)")
+    run.add_argument("--max-amount", type=int, default=500)
+    run.add_argument("--seed", type=int, default=1)
+    run.set_defaults(func=cmd_run)
+
+    replay = sub.add_parser("replay", help="replay recorded sessions")
+    replay.add_argument("transcripts", nargs="+", help="terminal captures, see tools/sessions/")
+    replay.add_argument("--repeat", type=int, default=1)
+    replay.set_defaults(func=cmd_replay)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Map an Embedded Bank PC-sampling profile to function names.
+
+The input is a terminal capture containing the "Profile (H)" output of the
+Status menu, between "profile v1 ..." and "end profile"; the last complete
+dump is used. Symbols come from the ELF the dump was taken with, read with
+nm, so a build of the stm32-oop-f4 target needs arm-none-eabi-nm and a host
+build plain nm:
+
+  tools/profile2sym.py capture.txt --elf build/stm32-oop-f4
+  tools/profile2sym.py capture.txt --elf host/build/stm32-oop-host --nm nm
+
+A bucket that spans several functions is shared between them by the bytes
+each covers. Besides the functions, samples are summed into groups (UART
+driver, memory and string routines, printf, soft-float double arithmetic,
+waiting for input) given by name patterns below.
+"""
+
+import argparse
+import bisect
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+# First match wins; names are demangled
+GROUPS = [
+    ("waiting for input", re.compile(r"^(UART_GetChar|HAL_Host_WaitForInterrupt|Sim_WaitForInterrupt)\b")),
+    ("HAL UART", re.compile(r"^(HAL_UART_|UART_(Receive|Transmit|End|Wait|DMA|SetConfig|Start))")),
+    ("console UART driver", re.compile(r"^(Uart<|UartPins<|UART_|USART\w*_IRQHandler)")),
+    ("memcmp/memcpy/strings", re.compile(r"^(mem(cmp|cpy|set|move|chr)|str(len|cmp|ncmp|cpy|ncpy|chr))\b")),
+    ("printf", re.compile(r"printf|^_?_?s?print|^__ssputs|^_dtoa|^__sfputs|^_svfprintf|^__sprint")),
+    ("double emulation", re.compile(r"^__aeabi_(d|l2d|ul2d|i2d|ui2d|f2d)|^__(add|sub|mul|div|cmp|eq|ne|lt|le|gt|ge|unord)df\d"
+                                    r"|^__(float|fix|extend|trunc)\w*df")),
+    ("other HAL", re.compile(r"^HAL_")),
+    ("interrupt handlers", re.compile(r"_(IRQ)?Handler$")),
+]
+
+
+def read_dump(text):
+    """(header fields, {bucket: count}) of the last complete dump in a capture."""
+    dumps = re.findall(r"profile v1 ([0-9a-f ]+)\r?\n(.*?)end profile", text, re.S)
+    if not dumps:
+        raise ValueError("no 'profile v1' dump found")
+    header, body = dumps[-1]
+    fields = header.split()
+    if len(fields) != 8:
+        raise ValueError("malformed profile header: " + header)
+    hz, base, shift, buckets, anchor, samples, outside, halvings = fields
+    info = {"hz": int(hz), "base": int(base, 16), "shift": int(shift), "buckets": int(buckets),
+            "anchor": int(anchor, 16), "samples": int(samples), "outside": int(outside), "halvings": int(halvings)}
+    counts = {}
+    for line in body.splitlines():
+        parts = line.split()
+        if len(parts) == 2:
+            counts[int(parts[0], 16)] = int(parts[1])
+    return info, counts
+
+
+def read_symbols(nm, elf):
+    """Sorted [(address, end, name)] of the code symbols in the ELF."""
+    out = subprocess.run([nm, "--defined-only", "-n", "-S", "-C", elf], check=True, capture_output=True,
+                         text=True).stdout
+    raw = []
+    for line in out.splitlines():
+        m = re.match(r"^([0-9a-f]+) (?:([0-9a-f]+) )?([tTwW]) (.+)$", line)
+        if m:
+            raw.append((int(m.group(1), 16), int(m.group(2), 16) if m.group(2) else None, m.group(4)))
+    symbols = []
+    for i, (address, size, name) in enumerate(raw):
+        if size is None:
+            following = [a for a, _, _ in raw[i + 1:i + 8] if a > address]
+            size = following[0] - address if following else 4
+        if size > 0:
+            symbols.append((address, address + size, name))
+    return symbols
+
+
+def attribute(info, counts, symbols, bias):
+    """{function: samples} with each bucket shared by the bytes each symbol covers."""
+    starts = [s[0] for s in symbols]
+    width = 1 << info["shift"]
+    result = defaultdict(float)
+    for bucket, count in counts.items():
+        lo = info["base"] + bucket * width - bias
+        hi = lo + width
+        covered = 0
+        i = max(bisect.bisect_right(starts, lo) - 1, 0)
+        shares = []
+        while i < len(symbols) and symbols[i][0] < hi:
+            start, end, name = symbols[i]
+            overlap = min(end, hi) - max(start, lo)
+            if overlap > 0:
+                shares.append((name, overlap))
+                covered += overlap
+            i += 1
+        for name, overlap in shares:
+            result[name] += count * overlap / width
+        if covered < width:
+            result["(no symbol)"] += count * (width - covered) / width
+    return result
+
+
+def group_of(name):
+    for group, pattern in GROUPS:
+        if pattern.search(name):
+            return group
+    return "other"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="terminal capture with a profile dump ('-' for stdin)")
+    parser.add_argument("--elf", required=True, help="the firmware the dump was taken from")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm for the ELF (default: arm-none-eabi-nm)")
+    parser.add_argument("--top", type=int, default=25, help="number of functions to list (default: 25)")
+    args = parser.parse_args()
+
+    text = sys.stdin.read() if args.input == "-" else open(args.input, errors="replace").read()
+    info, counts = read_dump(text)
+    symbols = read_symbols(args.nm, args.elf)
+    anchors = [start for start, _, name in symbols if name.split("(")[0] == "Profiler_Init"]
+    if not anchors:
+        raise ValueError("Profiler_Init not found in %s" % args.elf)
+    bias = (info["anchor"] & ~1) - anchors[0]  # Thumb function pointers have bit 0 set
+
+    functions = attribute(info, counts, symbols, bias)
+    total = sum(counts.values())
+    print("%d samples at %d Hz (%.1f s), %d outside the code, %d in the histogram" %
+          (info["samples"], info["hz"], info["samples"] / max(info["hz"], 1), info["outside"], total))
+    if info["halvings"]:
+        print("histogram halved %d times: counts are relative" % info["halvings"])
+    if total == 0:
+        return 0
+
+    print("\n%10s %7s  %s" % ("samples", "share", "function"))
+    for name, count in sorted(functions.items(), key=lambda item: -item[1])[:args.top]:
+        print("%10.1f %6.1f%%  %s" % (count, 100.0 * count / total, name))
+
+    groups = defaultdict(float)
+    for name, count in functions.items():
+        groups[group_of(name)] += count
+    print("\n%10s %7s  %s" % ("samples", "share", "group"))
+    for name, count in sorted(groups.items(), key=lambda item: -item[1]):
+        print("%10.1f %6.1f%%  %s" % (count, 100.0 * count / total, name))
+    return 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except (ValueError, OSError, subprocess.CalledProcessError) as e:
+        print(e)
+        sys.exit(1)
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""Static RAM footprint report for the stm32-oop-f4 firmware.
+
+Combines the linker map file (.data/.bss/.noinit placement) with the
+-fstack-usage output (.su files) into per-function and per-subsystem tables.
+With --check it only verifies that .noinit is the NOLOAD output section of
+stm32_noinit.ld, in RAM above .bss, and holds every .noinit input section;
+the firmware build runs that after each link.
+"""
+
+import argparse
+import os
+import re
+import sys
+from collections import defaultdict
+
+RAM_SECTIONS = (".data", ".bss", ".noinit", "COMMON")
+
+# Input section line, possibly split over two lines when the name is long:
+#  .bss.accounts  0x20000010  0x1e0 CMakeFiles/stm32-oop-f4.dir/Src/main.cpp.obj
+SECTION_RE = re.compile(r"^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+SECTION_NAME_RE = re.compile(r"^ (\S+)$")
+SECTION_TAIL_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$")
+# Output section line, at column 0:
+# .noinit         0x20000a28      0x5f0
+# .data           0x20000000       0x10 load address 0x08004a10
+OUTPUT_RE = re.compile(r"^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(\s+load address 0x[0-9a-f]+)?$")
+# Symbol set by the linker script, e.g. "  0x20000a28  _snoinit = ."
+ASSIGNMENT_RE = re.compile(r"^\s+0x[0-9a-f]+\s+(\w+) = ")
+NOINIT_MARKER = "_snoinit"  # defined only by stm32_noinit.ld
+
+
+def subsystem(path):
+    name = os.path.basename(path)
+    if "libc" in name or "libm" in name or "libgcc" in name or "libstdc++" in name or "libnosys" in name:
+        return "libc"
+    if name.startswith("stm32f4xx_hal") or name.startswith("stm32f4xx_ll"):
+        return "HAL"
+    if name.startswith("startup_") or name.startswith("system_stm32"):
+        return "CMSIS"
+    if "etl" in path:
+        return "etl"
+    return "app"
+
+
+def parse_map(path):
+    """Return a list of (section, symbol, size, object) for RAM input sections."""
+    entries = []
+    pending = None
+    in_memory_map = False
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            m = SECTION_RE.match(line)
+            if m is None and pending is not None:
+                t = SECTION_TAIL_RE.match(line)
+                if t:
+                    m = (pending, t.group(1), t.group(2), t.group(3))
+                pending = None
+            elif m is not None:
+                m = m.groups()
+            else:
+                n = SECTION_NAME_RE.match(line)
+                pending = n.group(1) if n else None
+                continue
+            if m is None:
+                continue
+            name, _addr, size, obj = m
+            size = int(size, 16)
+            if size == 0 or not name.startswith(RAM_SECTIONS):
+                continue
+            section = next(s for s in RAM_SECTIONS if name.startswith(s))
+            symbol = name[len(section) + 1:] if len(name) > len(section) else ""
+            entries.append((section, symbol, size, obj))
+    return entries
+
+
+def check_noinit(path, ram_start, ram_size):
+    """Return what is wrong with the placement of .noinit; [] if nothing."""
+    outputs = {}
+    inputs = []
+    marker = None
+    output = None
+    pending = None
+    in_memory_map = False
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            o = OUTPUT_RE.match(line)
+            if o:
+                output = o.group(1)
+                outputs[output] = (int(o.group(2), 16), int(o.group(3), 16), o.group(4) is not None)
+                pending = None
+                continue
+            a = ASSIGNMENT_RE.match(line)
+            if a and a.group(1) == NOINIT_MARKER:
+                marker = output
+            m = SECTION_RE.match(line)
+            if m is None and pending is not None:
+                t = SECTION_TAIL_RE.match(line)
+                m = (pending,) + t.groups() if t else None
+            elif m is not None:
+                m = m.groups()
+            n = SECTION_NAME_RE.match(line)
+            pending = n.group(1) if n and m is None else None
+            if m is not None and m[0].startswith(".noinit") and int(m[2], 16) > 0:
+                inputs.append((m[0], int(m[1], 16), int(m[2], 16), m[3], output))
+
+    problems = []
+    if ".noinit" not in outputs:
+        return ["no .noinit output section"] if inputs else []
+    start, size, has_load_address = outputs[".noinit"]
+    if marker != ".noinit":
+        problems.append(".noinit is not the section of stm32_noinit.ld (an orphan?)")
+    if has_load_address:
+        problems.append(".noinit has a load address: it is not NOLOAD")
+    if start < ram_start or start + size > ram_start + ram_size:
+        problems.append(".noinit at 0x%x..0x%x is outside RAM" % (start, start + size))
+    if ".bss" in outputs and start < outputs[".bss"][0] + outputs[".bss"][1]:
+        problems.append(".noinit at 0x%x overlaps or precedes .bss" % start)
+    for name, addr, length, obj, owner in inputs:
+        if owner != ".noinit" or addr < start or addr + length > start + size:
+            problems.append("%s of %s is in %s, not in .noinit" % (name, os.path.basename(obj), owner))
+    return problems
+
+
+# file:line:column:function, where C++ functions contain "::" of their own
+SU_LOCATION = re.compile(r"^(.*?):\d+:\d+:(.*)$")
+
+
+def parse_stack_usage(su_dir):
+    """Return a list of (function, bytes, qualifier, source file) from .su files."""
+    funcs = []
+    for root, _dirs, files in os.walk(su_dir):
+        for name in files:
+            if not name.endswith(".su"):
+                continue
+            with open(os.path.join(root, name)) as f:
+                for line in f:
+                    parts = line.rstrip("\n").split("\t")
+                    if len(parts) != 3:
+                        continue
+                    location, size, qualifier = parts
+                    m = SU_LOCATION.match(location)
+                    if not m:
+                        continue
+                    source, func = m.groups()
+                    funcs.append((func, int(size), qualifier, source))
+    return funcs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--map", required=True, help="linker map file")
+    parser.add_argument("--su-dir", help="directory searched for .su files")
+    parser.add_argument("--top", type=int, default=20, help="number of functions/symbols to list")
+    parser.add_argument("--check", action="store_true", help="only check the placement of .noinit")
+    parser.add_argument("--ram-start", type=lambda v: int(v, 0), default=0x20000000)
+    parser.add_argument("--ram-size", type=lambda v: int(v, 0), default=128 * 1024, help="default: STM32F411CE")
+    args = parser.parse_args()
+
+    problems = check_noinit(args.map, args.ram_start, args.ram_size)
+    for problem in problems:
+        print("%s: %s" % (args.map, problem))
+    if args.check:
+        return 1 if problems else 0
+    if args.su_dir is None:
+        parser.error("--su-dir is required for the report")
+
+    ram = parse_map(args.map)
+    stack = parse_stack_usage(args.su_dir)
+
+    print("Static RAM by subsystem")
+    by_subsystem = defaultdict(lambda: defaultdict(int))
+    for section, _symbol, size, obj in ram:
+        by_subsystem[subsystem(obj)][section] += size
+    print("  %-8s %8s %8s %8s %8s" % ("", ".data", ".bss", ".noinit", "total"))
+    for name, sections in sorted(by_subsystem.items(), key=lambda kv: -sum(kv[1].values())):
+        bss = sections[".bss"] + sections["COMMON"]
+        print("  %-8s %8d %8d %8d %8d" % (name, sections[".data"], bss, sections[".noinit"], sum(sections.values())))
+    print("  %-8s %35d" % ("total", sum(size for _s, _n, size, _o in ram)))
+
+    print("\nLargest static RAM symbols")
+    for section, symbol, size, obj in sorted(ram, key=lambda e: -e[2])[: args.top]:
+        print("  %6d  %-8s %-40s %s" % (size, section, symbol or "(unnamed)", os.path.basename(obj)))
+
+    print("\nStack frame by subsystem (largest frame)")
+    by_subsystem = defaultdict(int)
+    for _func, size, _qualifier, source in stack:
+        by_subsystem[subsystem(source)] = max(by_subsystem[subsystem(source)], size)
+    for name, size in sorted(by_subsystem.items(), key=lambda kv: -kv[1]):
+        print("  %-8s %8d" % (name, size))
+
+    print("\nLargest stack frames")
+    for func, size, qualifier, source in sorted(stack, key=lambda e: -e[1])[: args.top]:
+        print("  %6d  %-9s %-40s %s" % (size, qualifier, func, os.path.basename(source)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
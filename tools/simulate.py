@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Run console scenarios against the host build on a virtual clock.
+
+Each scenario in tools/scenarios/ (format: see host/Inc/sim_host.h) is run
+--runs times with consecutive seeds, every run in a fresh firmware process.
+Timeouts cost no real time, so scenarios that wait out TRANSACTION_WAIT
+still run about a thousand times per second. A failing run prints the
+scenario line, seed and the console output; rerun one seed with
+
+  BANK_SIM=tools/scenarios/x.txt BANK_SIM_SEED=n BANK_SIM_ECHO=1 host/build/stm32-oop-host
+"""
+
+import argparse
+import glob
+import os
+import subprocess
+import sys
+import time
+
+SCENARIO_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "scenarios")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, help="host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--runs", type=int, default=100, help="runs per scenario (default: 100)")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the first run")
+    parser.add_argument("scenarios", nargs="*", help="scenario files (default: all in tools/scenarios/)")
+    args = parser.parse_args()
+
+    scenarios = args.scenarios or sorted(glob.glob(os.path.join(SCENARIO_DIR, "*.txt")))
+    failed = []
+    start = time.monotonic()
+    for path in scenarios:
+        env = dict(os.environ, BANK_SIM=path, BANK_SIM_RUNS=str(args.runs), BANK_SIM_SEED=str(args.seed))
+        env.pop("BANK_SIM_ECHO", None)
+        result = subprocess.run([args.exec], env=env, stdin=subprocess.DEVNULL)
+        if result.returncode != 0:
+            failed.append(os.path.basename(path))
+    elapsed = time.monotonic() - start
+
+    runs = len(scenarios) * args.runs
+    print("%d scenarios, %d runs in %.2f s (%.0f runs/s), %d failed%s" % (
+        len(scenarios), runs, elapsed, runs / elapsed if elapsed else 0, len(failed),
+        ": " + ", ".join(failed) if failed else ""))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
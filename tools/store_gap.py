@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Restore test for an account table with a damaged record on the host build.
+
+Creates accounts with the external memory in the file named by BANK_EXT_MEM,
+waits until every page is written back and stops the firmware. Then breaks
+the magic of the first account's record and starts again cold (no
+BANK_NOINIT), so the table is restored with a free slot below the others.
+Checks that only the intact accounts come back, that the free slot cannot
+be logged into with an empty name and password, that an empty name cannot
+be created and that a new account still gets a slot of its own.
+
+  tools/store_gap.py --exec host/build/stm32-oop-host
+"""
+
+import argparse
+import os
+import re
+import sys
+import tempfile
+import time
+
+from failover import balances, step
+from loadgen import MENU_PROMPT, NAME_MAX, LinkTimeout, ProcessLink
+from warm_reboot import kill
+
+
+def boot(command, ext_mem, timeout):
+    env = dict(os.environ, BANK_EXT_MEM=ext_mem)
+    for name in ("BANK_SIM", "BANK_NOINIT", "BANK_TRACE", "BANK_REPL_FDS", "BANK_ROLE", "BANK_RESET"):
+        env.pop(name, None)
+    link = ProcessLink(command, env=env)
+    link.expect(MENU_PROMPT, timeout)
+    return link
+
+
+def storage_report(link, timeout):
+    """(restored, pages pending) from diagnostics P."""
+    step(link, ["S"], timeout)
+    report = step(link, ["P"], timeout)
+    step(link, ["Q"], timeout)
+    match = re.search(r"Storage: (\d+) restored, \d+ updates, (\d+) pages pending", report)
+    return (int(match.group(1)), int(match.group(2))) if match else (None, None)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, help="host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--accounts", type=int, default=3, help="accounts to create (default: 3)")
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for a prompt")
+    args = parser.parse_args()
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmp:
+        ext_mem = os.path.join(tmp, "ext_mem.bin")
+        link = boot(args.exec, ext_mem, args.timeout)
+        accounts = []
+        for i in range(args.accounts):
+            name, password = "gap%d" % i, "pw%d" % i
+            if i == args.accounts - 1:
+                name = name.ljust(NAME_MAX, "x")  # a record name without terminator
+            if "created" not in step(link, ["N", name, password, password], args.timeout):
+                print("could not create account %s" % name)
+                return 1
+            step(link, ["D", "%d.00" % (10 * (i + 1))], args.timeout)
+            step(link, ["Q"], args.timeout)
+            accounts.append((name, password))
+        deadline = time.monotonic() + args.timeout
+        while storage_report(link, args.timeout)[1] != 0:
+            if time.monotonic() > deadline:
+                print("write-back did not finish")
+                return 1
+            time.sleep(0.05)
+        expected = balances(link, accounts, args.timeout)
+        kill(link)
+
+        with open(ext_mem, "r+b") as f:
+            f.write(b"\x00\x00")  # magic of record 0
+
+        link = boot(args.exec, ext_mem, args.timeout)
+        restored = storage_report(link, args.timeout)[0]
+        actual = balances(link, accounts, args.timeout)
+        print("restored %s of %d accounts" % (restored, len(accounts)))
+        if restored != len(accounts) - 1:
+            failures.append("%s accounts restored, expected %d" % (restored, len(accounts) - 1))
+        if actual[accounts[0][0]] is not None:
+            failures.append("%s came back from a damaged record" % accounts[0][0])
+        for name, _ in accounts[1:]:
+            if actual[name] != expected[name]:
+                failures.append("%s: %s, expected %s" % (name, actual[name], expected[name]))
+
+        reply = step(link, ["E", "", ""], args.timeout)
+        print("empty name and password: %s" % ("refused" if "Invalid account" in reply else "ACCEPTED"))
+        if "Invalid account" not in reply:
+            failures.append("logged into the free slot with an empty name")
+            step(link, ["Q"], args.timeout)
+
+        link.send_line("N")
+        link.expect(": ", args.timeout)
+        link.send_line("")
+        reply = link.expect("Enter account name: ", args.timeout)
+        print("empty new name: %s" % ("refused" if "must not be empty" in reply else "ACCEPTED"))
+        if "must not be empty" not in reply:
+            failures.append("created an account with an empty name")
+        reply = step(link, ["late", "pw", "pw"], args.timeout)
+        step(link, ["Q"], args.timeout)
+        if "created" not in reply or balances(link, [("late", "pw")], args.timeout)["late"] is None:
+            failures.append("no account could be created after the restore")
+        else:
+            print("new account after the gap: created")
+        link.close()
+
+    for failure in failures:
+        print(failure)
+    print("store gap %s" % ("passed" if not failures else "FAILED"))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except LinkTimeout as e:
+        print("timed out waiting for %r" % str(e))
+        sys.exit(1)
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Convert Embedded Bank event traces to Chrome trace JSON.
+
+The output opens in chrome://tracing and in Perfetto (ui.perfetto.dev).
+Three inputs are understood:
+
+  host file   written by the Linux build when BANK_TRACE is set (see host/)
+  text dump   a terminal capture containing the "Event trace (E)" output of
+              the Status menu, between "trace v1 ..." and "end trace"
+  SWO stream  raw ITM bytes captured from the board's SWO pin (--swo), e.g.
+              with openocd's "itm port 1 on" and "tpiu config ... output file"
+
+Event names and tracks are read from Inc/trace.h, so the list there is the
+only one to maintain.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+TRACE_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Inc", "trace.h")
+HOST_MAGIC = b"EBTR"
+RECORD = struct.Struct("<IIBBH")  # TraceRecord: cycles, tick, event, phase, arg
+TRACK_NAMES = {0: "main loop", 1: "interrupts"}
+DEFAULT_ITM_PORT = 1              # TRACE_ITM_PORT
+
+
+def load_events(path):
+    """[(name, track)] in TraceEvent order, from the TRACE_EVENTS list."""
+    with open(path) as f:
+        text = f.read()
+    start = text.index("#define TRACE_EVENTS(X)")
+    end = text.index("\n\n", start)
+    return [(name, int(track)) for name, track in re.findall(r"X\((\w+),\s*(\d+)\)", text[start:end])]
+
+
+def read_host_file(data):
+    magic, version, cycles_per_us = struct.unpack_from("<4sII", data)
+    if magic != HOST_MAGIC or version != 1:
+        raise ValueError("not a version 1 host trace file")
+    body = data[12:len(data) - (len(data) - 12) % RECORD.size]
+    return cycles_per_us, [RECORD.unpack_from(body, i) for i in range(0, len(body), RECORD.size)]
+
+
+def read_text_dump(text):
+    """The last complete dump in a terminal capture."""
+    dumps = re.findall(r"trace v1 (\d+) \d+\r?\n(.*?)end trace", text, re.S)
+    if not dumps:
+        raise ValueError("no 'trace v1' dump found")
+    cycles_per_us, body = dumps[-1]
+    records = []
+    for line in body.splitlines():
+        fields = line.split()
+        if len(fields) == 5:
+            records.append((int(fields[0], 16), int(fields[1], 16), int(fields[2]), ord(fields[3]), int(fields[4])))
+    return int(cycles_per_us), records
+
+
+def itm_words(data, port):
+    """32-bit payloads written to one ITM stimulus port."""
+    i = 0
+    while i < len(data):
+        header = data[i]
+        i += 1
+        if header & 0x03:  # source packet
+            size = (1, 2, 4)[(header & 0x03) - 1]
+            payload = data[i:i + size]
+            i += size
+            if not header & 0x04 and header >> 3 == port and size == 4 and len(payload) == 4:
+                yield struct.unpack("<I", payload)[0]
+        elif header & 0x80 and header & 0x0F == 0:  # timestamp with continuation bytes
+            while i < len(data) and data[i] & 0x80:
+                i += 1
+            i += 1
+        # sync (0x00), overflow (0x70) and short timestamps carry no payload
+
+
+def read_swo(data, port):
+    words = list(itm_words(data, port))
+    records = []
+    for i in range(0, len(words) - 2, 3):
+        packed = words[i + 2]
+        records.append((words[i], words[i + 1], packed & 0xFF, (packed >> 8) & 0xFF, packed >> 16))
+    return records
+
+
+def unwrap(records, cycles_per_us):
+    """Microsecond timestamps. The 32-bit cycle counter wraps (every 43 s at
+    100 MHz, under 2 s for a host TSC); the millisecond tick in each record
+    says how many wraps lie between two records."""
+    times = []
+    total = 0
+    prev = None
+    for cycles, tick, _event, _phase, _arg in records:
+        if prev is not None:
+            expected = ((tick - prev[1]) & 0xFFFFFFFF) * 1000 * cycles_per_us
+            delta = (cycles - prev[0]) & 0xFFFFFFFF
+            delta += round((expected - delta) / 2 ** 32) * 2 ** 32
+            total += delta
+        prev = (cycles, tick)
+        times.append(total / cycles_per_us)
+    return times
+
+
+def to_chrome(records, cycles_per_us, events):
+    out = []
+    for track, name in TRACK_NAMES.items():
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": track, "args": {"name": name}})
+    for ts, (_cycles, tick, event, phase, arg) in zip(unwrap(records, cycles_per_us), records):
+        name, track = events[event] if event < len(events) else ("event_%d" % event, 0)
+        entry = {"name": name, "ph": chr(phase), "ts": round(ts, 3), "pid": 0, "tid": track}
+        if chr(phase) == "i":
+            entry["s"] = "t"
+            entry["args"] = {"arg": arg, "tick": tick}
+        out.append(entry)
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="host trace file, terminal capture or SWO capture")
+    parser.add_argument("-o", "--output", help="JSON file to write (default: stdout)")
+    parser.add_argument("--swo", action="store_true", help="input is a raw ITM/SWO byte stream")
+    parser.add_argument("--itm-port", type=int, default=DEFAULT_ITM_PORT)
+    parser.add_argument("--cpu-mhz", type=int, default=100, help="core clock for --swo input (default: 100)")
+    parser.add_argument("--header", default=TRACE_HEADER, help="trace.h with the event list")
+    args = parser.parse_args()
+
+    events = load_events(args.header)
+    with open(args.input, "rb") as f:
+        data = f.read()
+    if args.swo:
+        cycles_per_us, records = args.cpu_mhz, read_swo(data, args.itm_port)
+    elif data.startswith(HOST_MAGIC):
+        cycles_per_us, records = read_host_file(data)
+    else:
+        cycles_per_us, records = read_text_dump(data.decode(errors="replace"))
+
+    trace = to_chrome(records, cycles_per_us, events)
+    out = open(args.output, "w") if args.output else sys.stdout
+    json.dump(trace, out, indent=None, separators=(",", ":"))
+    out.write("\n")
+    sys.stderr.write("%d records, %d events\n" % (len(records), len(events)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
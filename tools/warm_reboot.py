@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Warm-reboot test for the account table kept in .noinit RAM on the host build.
+
+The host stands in for .noinit RAM with the file named by BANK_NOINIT and for
+a software reset with SIGKILL and a restart. No BANK_EXT_MEM is given, so the
+external memory starts blank every run and any balance that survives a restart
+came from the retained table. Runs a workload, restarts the firmware a number
+of times and checks that every restart is warm and loses nothing, then damages
+one byte of the table (the restart must be reported as corrupt and start
+empty) and finally simulates a power cycle (BANK_RESET=power, reported cold).
+
+  tools/warm_reboot.py --exec host/build/stm32-oop-host --accounts 5 --ops 50
+"""
+
+import argparse
+import os
+import random
+import re
+import signal
+import sys
+import tempfile
+
+from failover import balances, step
+from loadgen import MENU_PROMPT, NAME_MAX, LinkTimeout, ProcessLink
+
+
+def boot(command, noinit, timeout, reset=None):
+    env = dict(os.environ, BANK_NOINIT=noinit)
+    for name in ("BANK_SIM", "BANK_EXT_MEM", "BANK_TRACE", "BANK_REPL_FDS", "BANK_ROLE", "BANK_RESET"):
+        env.pop(name, None)
+    if reset is not None:
+        env["BANK_RESET"] = reset
+    link = ProcessLink(command, env=env)
+    link.expect(MENU_PROMPT, timeout)
+    return link
+
+
+def boot_report(link, timeout):
+    """(kind, accounts adopted, ms to the first prompt) from diagnostics P."""
+    step(link, ["S"], timeout)
+    report = step(link, ["P"], timeout)
+    step(link, ["Q"], timeout)
+    match = re.search(r"Boot: (\w+), (\d+) accounts adopted, ready in (\d+) ms", report)
+    if not match:
+        return (None, 0, 0)
+    return (match.group(1), int(match.group(2)), int(match.group(3)))
+
+
+def kill(link):
+    link.proc.send_signal(signal.SIGKILL)
+    link.proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, help="host firmware build, e.g. host/build/stm32-oop-host")
+    parser.add_argument("--accounts", type=int, default=5, help="accounts to create (default: 5)")
+    parser.add_argument("--ops", type=int, default=50, help="deposits and withdrawals per run (default: 50)")
+    parser.add_argument("--restarts", type=int, default=3, help="warm restarts (default: 3)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for a prompt")
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    failures = []
+
+    with tempfile.TemporaryDirectory() as tmp:
+        noinit = os.path.join(tmp, "noinit.bin")
+        link = boot(args.exec, noinit, args.timeout)
+        kind = boot_report(link, args.timeout)[0]
+        print("first boot: %s" % kind)
+        if kind != "cold":
+            failures.append("first boot was %s, not cold" % kind)
+
+        accounts = []
+        for i in range(args.accounts):
+            name, password = "wb%d" % i, "pw%d" % i
+            if i == 0:
+                name = name.ljust(NAME_MAX, "x")  # kept in the name arena at full length
+            if "created" not in step(link, ["N", name, password, password], args.timeout):
+                print("could not create account %s" % name)
+                return 1
+            step(link, ["Q"], args.timeout)
+            accounts.append((name, password))
+
+        for run in range(args.restarts):
+            for _ in range(args.ops):
+                name, password = rng.choice(accounts)
+                step(link, ["E", name, password], args.timeout)
+                op = rng.choice(["D", "D", "W"])
+                step(link, [op, "%d.%02d" % (rng.randint(1, 500), rng.randint(0, 99))], args.timeout)
+                step(link, ["Q"], args.timeout)
+            expected = balances(link, accounts, args.timeout)
+            kill(link)
+
+            link = boot(args.exec, noinit, args.timeout)
+            kind, adopted, ready = boot_report(link, args.timeout)
+            actual = balances(link, accounts, args.timeout)
+            lost = [name for name in expected if expected[name] is None or expected[name] != actual.get(name)]
+            print("restart %d: %s, %d accounts adopted, ready in %d ms, %d of %d balances match" %
+                  (run + 1, kind, adopted, ready, len(expected) - len(lost), len(expected)))
+            if kind != "warm" or adopted != len(accounts) or lost:
+                failures.append("restart %d: %s, lost %s" % (run + 1, kind, ", ".join(lost) or "nothing"))
+        kill(link)
+
+        # One flipped bit in the middle of the table must not be adopted
+        with open(noinit, "r+b") as f:
+            f.seek(os.path.getsize(noinit) // 2)
+            byte = f.read(1)
+            f.seek(-1, os.SEEK_CUR)
+            f.write(bytes([byte[0] ^ 0x01]))
+        link = boot(args.exec, noinit, args.timeout)
+        kind, adopted, _ = boot_report(link, args.timeout)
+        left = [name for name, balance in balances(link, accounts, args.timeout).items() if balance is not None]
+        print("damaged table: %s, %d accounts adopted, %d accounts left" % (kind, adopted, len(left)))
+        if kind != "corrupt" or adopted != 0 or left:
+            failures.append("damaged table: %s with %d accounts" % (kind, len(left)))
+        kill(link)
+
+        link = boot(args.exec, noinit, args.timeout, reset="power")
+        kind = boot_report(link, args.timeout)[0]
+        print("power cycle: %s" % kind)
+        if kind != "cold":
+            failures.append("power cycle was %s, not cold" % kind)
+        link.close()
+
+    for failure in failures:
+        print(failure)
+    print("warm reboot %s" % ("passed" if not failures else "FAILED"))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except LinkTimeout as e:
+        print("timed out waiting for %r" % str(e))
+        sys.exit(1)